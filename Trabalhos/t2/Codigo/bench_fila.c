@@ -0,0 +1,182 @@
+// bench_fila.c
+// medida do custo da fila de prontos em trocas de contexto
+// simulador de computador
+// so24b
+
+// simula trocas de contexto como as do escalonador round-robin (retira o
+//   processo corrente, recoloca na fila e pega o primeiro) e bloqueios
+//   seguidos de desbloqueio, com a fila intrusiva de fila.h e com a fila
+//   anterior, que alocava um nó a cada inserção
+// conta as chamadas a malloc (o programa é ligado com --wrap=malloc) e
+//   mede o tempo por troca
+// uso: make bench_fila && ./bench_fila [n_trocas]
+
+#include "fila.h"
+#include "processo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N_PROCS 4
+
+static long n_alocacoes = 0;
+
+void *__real_malloc(size_t tam);
+
+void *__wrap_malloc(size_t tam)
+{
+  n_alocacoes++;
+  return __real_malloc(tam);
+}
+
+// fila anterior {{{1
+// cópia da implementação que ficava em so.c, com um nó alocado por inserção
+//   e remoção por busca linear
+
+typedef struct no {
+  processo_t *processo;
+  struct no *proximo;
+  struct no *anterior;
+} no_t;
+
+typedef struct {
+  no_t *inicio;
+  no_t *fim;
+} fila_alocada_t;
+
+static void alocada_insere(fila_alocada_t *self, processo_t *proc)
+{
+  no_t *no = malloc(sizeof(*no));
+  no->processo = proc;
+  no->anterior = NULL;
+  no->proximo = NULL;
+  if (self->inicio == NULL) {
+    self->inicio = self->fim = no;
+    return;
+  }
+  no_t *atual = self->inicio;
+  while (atual != NULL && atual->processo->prioridade >= proc->prioridade) {
+    atual = atual->proximo;
+  }
+  if (atual == NULL) {
+    no->anterior = self->fim;
+    self->fim->proximo = no;
+    self->fim = no;
+  } else if (atual == self->inicio) {
+    no->proximo = self->inicio;
+    self->inicio->anterior = no;
+    self->inicio = no;
+  } else {
+    no->proximo = atual;
+    no->anterior = atual->anterior;
+    atual->anterior->proximo = no;
+    atual->anterior = no;
+  }
+}
+
+static void alocada_remove(fila_alocada_t *self, processo_t *proc)
+{
+  for (no_t *no = self->inicio; no != NULL; no = no->proximo) {
+    if (no->processo != proc) continue;
+    if (no->anterior != NULL) {
+      no->anterior->proximo = no->proximo;
+    } else {
+      self->inicio = no->proximo;
+    }
+    if (no->proximo != NULL) {
+      no->proximo->anterior = no->anterior;
+    } else {
+      self->fim = no->anterior;
+    }
+    free(no);
+    break;
+  }
+}
+
+// medidas {{{1
+
+static double agora_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void relata(char *nome, long n_trocas, long alocacoes, double ns)
+{
+  printf("%-10s %10ld trocas %10ld mallocs %6.2f mallocs/troca %8.1f ns/troca\n",
+         nome, n_trocas, alocacoes, (double)alocacoes / n_trocas, ns / n_trocas);
+}
+
+// a cada troca o processo corrente volta para a fila e o primeiro é
+//   escolhido; a cada 3 trocas o escolhido bloqueia e outro desbloqueia
+static void mede_intrusiva(processo_t *procs, long n_trocas)
+{
+  fila_t fila;
+  fila_inicializa(&fila);
+  for (int i = 0; i < N_PROCS; i++) fila_insere(&fila, &procs[i]);
+  processo_t *corrente = fila_primeiro(&fila);
+  processo_t *bloqueado = NULL;
+
+  long aloc0 = n_alocacoes;
+  double t0 = agora_ns();
+  for (long t = 0; t < n_trocas; t++) {
+    fila_remove(&fila, corrente);
+    fila_insere(&fila, corrente);
+    corrente = fila_primeiro(&fila);
+    if (t % 3 == 0) {
+      if (bloqueado != NULL) fila_insere(&fila, bloqueado);
+      bloqueado = corrente;
+      fila_remove(&fila, bloqueado);
+      corrente = fila_primeiro(&fila);
+    }
+  }
+  double t1 = agora_ns();
+  relata("intrusiva", n_trocas, n_alocacoes - aloc0, t1 - t0);
+}
+
+static void mede_alocada(processo_t *procs, long n_trocas)
+{
+  fila_alocada_t fila = { NULL, NULL };
+  for (int i = 0; i < N_PROCS; i++) alocada_insere(&fila, &procs[i]);
+  processo_t *corrente = fila.inicio->processo;
+  processo_t *bloqueado = NULL;
+
+  long aloc0 = n_alocacoes;
+  double t0 = agora_ns();
+  for (long t = 0; t < n_trocas; t++) {
+    alocada_remove(&fila, corrente);
+    alocada_insere(&fila, corrente);
+    corrente = fila.inicio->processo;
+    if (t % 3 == 0) {
+      if (bloqueado != NULL) alocada_insere(&fila, bloqueado);
+      bloqueado = corrente;
+      alocada_remove(&fila, bloqueado);
+      corrente = fila.inicio->processo;
+    }
+  }
+  double t1 = agora_ns();
+  relata("alocada", n_trocas, n_alocacoes - aloc0, t1 - t0);
+  while (fila.inicio != NULL) alocada_remove(&fila, fila.inicio->processo);
+}
+
+int main(int argc, char *argv[])
+{
+  long n_trocas = 1000000;
+  if (argc > 1) n_trocas = atol(argv[1]);
+  if (n_trocas <= 0) {
+    fprintf(stderr, "uso: %s [n_trocas]\n", argv[0]);
+    return 1;
+  }
+
+  processo_t procs[N_PROCS] = { 0 };
+  for (int i = 0; i < N_PROCS; i++) {
+    procs[i].pid = i + 1;
+    procs[i].prioridade = 0.5;
+  }
+
+  mede_alocada(procs, n_trocas);
+  mede_intrusiva(procs, n_trocas);
+  return 0;
+}
@@ -0,0 +1,185 @@
+// cache_prog.c
+// cache de programas lidos de arquivos '.maq'
+// simulador de computador
+// so24b
+
+#include "cache_prog.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+// um programa no cache
+// as entradas formam uma lista duplamente encadeada em ordem de uso, da
+//   usada mais recentemente para a usada há mais tempo
+typedef struct entrada_t entrada_t;
+struct entrada_t {
+  char *nome;
+  // identificação do arquivo de onde o programa foi lido
+  struct timespec modificacao;
+  off_t tamanho_arq;
+  programa_t *prog;
+  // memória ocupada pelo programa
+  int bytes;
+  entrada_t *anterior;
+  entrada_t *proximo;
+};
+
+struct cache_prog_t {
+  entrada_t *mais_recente;
+  entrada_t *menos_recente;
+  int bytes;
+  int max_bytes;
+  long acertos;
+  long faltas;
+  long descartes;
+};
+
+cache_prog_t *cache_prog_cria(int max_bytes)
+{
+  cache_prog_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->mais_recente = NULL;
+  self->menos_recente = NULL;
+  self->bytes = 0;
+  self->max_bytes = max_bytes;
+  self->acertos = 0;
+  self->faltas = 0;
+  self->descartes = 0;
+  return self;
+}
+
+// retira a entrada da lista, sem liberá-la
+static void cache_prog_desencadeia(cache_prog_t *self, entrada_t *ent)
+{
+  if (ent->anterior != NULL) {
+    ent->anterior->proximo = ent->proximo;
+  } else {
+    self->mais_recente = ent->proximo;
+  }
+  if (ent->proximo != NULL) {
+    ent->proximo->anterior = ent->anterior;
+  } else {
+    self->menos_recente = ent->anterior;
+  }
+  ent->anterior = NULL;
+  ent->proximo = NULL;
+}
+
+// coloca a entrada no início da lista (usada mais recentemente)
+static void cache_prog_encadeia(cache_prog_t *self, entrada_t *ent)
+{
+  ent->anterior = NULL;
+  ent->proximo = self->mais_recente;
+  if (self->mais_recente != NULL) {
+    self->mais_recente->anterior = ent;
+  } else {
+    self->menos_recente = ent;
+  }
+  self->mais_recente = ent;
+}
+
+// retira a entrada do cache e libera o programa
+static void cache_prog_descarta(cache_prog_t *self, entrada_t *ent)
+{
+  cache_prog_desencadeia(self, ent);
+  self->bytes -= ent->bytes;
+  prog_destroi(ent->prog);
+  free(ent->nome);
+  free(ent);
+}
+
+void cache_prog_destroi(cache_prog_t *self)
+{
+  while (self->mais_recente != NULL) {
+    cache_prog_descarta(self, self->mais_recente);
+  }
+  free(self);
+}
+
+static entrada_t *cache_prog_procura(cache_prog_t *self, char *nome)
+{
+  for (entrada_t *ent = self->mais_recente; ent != NULL; ent = ent->proximo) {
+    if (strcmp(ent->nome, nome) == 0) return ent;
+  }
+  return NULL;
+}
+
+// retorna true se o arquivo não mudou desde que o programa foi lido
+static bool cache_prog_entrada_valida(entrada_t *ent, struct stat *st)
+{
+  return ent->modificacao.tv_sec == st->st_mtim.tv_sec
+      && ent->modificacao.tv_nsec == st->st_mtim.tv_nsec
+      && ent->tamanho_arq == st->st_size;
+}
+
+// descarta os programas usados há mais tempo até caber no limite, sem
+//   descartar o mais recente
+static void cache_prog_libera_espaco(cache_prog_t *self)
+{
+  while (self->bytes > self->max_bytes
+         && self->menos_recente != self->mais_recente) {
+    cache_prog_descarta(self, self->menos_recente);
+    self->descartes++;
+  }
+}
+
+programa_t *cache_prog_pega(cache_prog_t *self, char *nome)
+{
+  struct stat st;
+  entrada_t *ent = cache_prog_procura(self, nome);
+  if (stat(nome, &st) != 0) {
+    // o arquivo não existe mais; o programa antigo não serve
+    if (ent != NULL) {
+      cache_prog_descarta(self, ent);
+      self->descartes++;
+    }
+    self->faltas++;
+    return NULL;
+  }
+
+  if (ent != NULL) {
+    if (cache_prog_entrada_valida(ent, &st)) {
+      self->acertos++;
+      cache_prog_desencadeia(self, ent);
+      cache_prog_encadeia(self, ent);
+      return ent->prog;
+    }
+    cache_prog_descarta(self, ent);
+    self->descartes++;
+  }
+
+  self->faltas++;
+  programa_t *prog = prog_cria(nome);
+  if (prog == NULL) return NULL;
+
+  ent = malloc(sizeof(*ent));
+  assert(ent != NULL);
+  ent->nome = strdup(nome);
+  assert(ent->nome != NULL);
+  ent->modificacao = st.st_mtim;
+  ent->tamanho_arq = st.st_size;
+  ent->prog = prog;
+  ent->bytes = sizeof(*ent) + prog_tamanho(prog) * sizeof(int);
+  cache_prog_encadeia(self, ent);
+  self->bytes += ent->bytes;
+  cache_prog_libera_espaco(self);
+  return prog;
+}
+
+long cache_prog_acertos(cache_prog_t *self)
+{
+  return self->acertos;
+}
+
+long cache_prog_faltas(cache_prog_t *self)
+{
+  return self->faltas;
+}
+
+long cache_prog_descartes(cache_prog_t *self)
+{
+  return self->descartes;
+}
@@ -0,0 +1,45 @@
+// cache_prog.h
+// cache de programas lidos de arquivos '.maq'
+// simulador de computador
+// so24b
+
+#ifndef CACHE_PROG_H
+#define CACHE_PROG_H
+
+// guarda os programas já lidos, para que criar vários processos com o mesmo
+//   executável não precise ler e interpretar o arquivo de novo
+// cada programa é identificado pelo nome do arquivo; a data de modificação
+//   e o tamanho do arquivo são guardados junto, e se o arquivo mudar o
+//   programa é lido de novo
+// a memória ocupada pelos programas é limitada; quando passa do limite, são
+//   descartados os programas usados há mais tempo (LRU)
+
+#include "programa.h"
+
+typedef struct cache_prog_t cache_prog_t;
+
+// cria um cache vazio, que ocupa no máximo 'max_bytes' com os programas
+// mata o programa em caso de erro (malloc)
+cache_prog_t *cache_prog_cria(int max_bytes);
+
+// destrói o cache e todos os programas que estão nele
+void cache_prog_destroi(cache_prog_t *self);
+
+// retorna o programa do arquivo 'nome', do cache ou lido do arquivo
+// retorna NULL se o arquivo não existir ou não for um programa válido
+// o programa pertence ao cache: não deve ser destruído, e só é válido até
+//   a próxima chamada a cache_prog_pega
+// o último programa retornado nunca é descartado, mesmo que sozinho ocupe
+//   mais que o limite
+programa_t *cache_prog_pega(cache_prog_t *self, char *nome);
+
+// número de vezes que o programa pedido estava no cache
+long cache_prog_acertos(cache_prog_t *self);
+
+// número de vezes que o programa teve que ser lido do arquivo
+long cache_prog_faltas(cache_prog_t *self);
+
+// número de programas descartados por falta de espaço ou arquivo alterado
+long cache_prog_descartes(cache_prog_t *self);
+
+#endif // CACHE_PROG_H
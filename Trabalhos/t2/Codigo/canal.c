@@ -0,0 +1,73 @@
+// canal.c
+// canal de mensagens entre duas threads
+// simulador de computador
+// so24b
+
+#include "canal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+// tamanho de uma linha de cache do hospedeiro; os índices ficam em linhas
+//   diferentes, para uma thread não invalidar a cache da outra a cada
+//   alteração do seu índice
+#define TAM_LINHA_CACHE 64
+
+// os índices só crescem (a posição é o índice % cap); a diferença entre eles
+//   é o número de mensagens no canal, mesmo depois de darem a volta (por
+//   isso cap é potência de 2, divide o número de valores de um unsigned)
+struct canal_t {
+  char *buf;
+  unsigned cap;
+  size_t tam_msg;
+  // número de mensagens já enviadas, só alterado pelo produtor
+  _Alignas(TAM_LINHA_CACHE) atomic_uint escrita;
+  // número de mensagens já recebidas, só alterado pelo consumidor
+  _Alignas(TAM_LINHA_CACHE) atomic_uint leitura;
+};
+
+canal_t *canal_cria(int cap, size_t tam_msg)
+{
+  assert(cap > 0 && (cap & (cap - 1)) == 0);
+  canal_t *self = aligned_alloc(TAM_LINHA_CACHE, sizeof(*self));
+  assert(self != NULL);
+  self->buf = malloc(cap * tam_msg);
+  assert(self->buf != NULL);
+  self->cap = cap;
+  self->tam_msg = tam_msg;
+  atomic_init(&self->escrita, 0);
+  atomic_init(&self->leitura, 0);
+  return self;
+}
+
+void canal_destroi(canal_t *self)
+{
+  free(self->buf);
+  free(self);
+}
+
+bool canal_envia(canal_t *self, const void *msg)
+{
+  unsigned e = atomic_load_explicit(&self->escrita, memory_order_relaxed);
+  // 'acquire' garante que o consumidor já copiou a mensagem que estava na
+  //   posição que vai ser reaproveitada
+  unsigned l = atomic_load_explicit(&self->leitura, memory_order_acquire);
+  if (e - l == self->cap) return false;
+  memcpy(self->buf + (e % self->cap) * self->tam_msg, msg, self->tam_msg);
+  // 'release' garante que a mensagem está copiada quando o consumidor vir
+  //   o novo índice
+  atomic_store_explicit(&self->escrita, e + 1, memory_order_release);
+  return true;
+}
+
+bool canal_recebe(canal_t *self, void *msg)
+{
+  unsigned l = atomic_load_explicit(&self->leitura, memory_order_relaxed);
+  unsigned e = atomic_load_explicit(&self->escrita, memory_order_acquire);
+  if (l == e) return false;
+  memcpy(msg, self->buf + (l % self->cap) * self->tam_msg, self->tam_msg);
+  atomic_store_explicit(&self->leitura, l + 1, memory_order_release);
+  return true;
+}
@@ -0,0 +1,41 @@
+// canal.h
+// canal de mensagens entre duas threads
+// simulador de computador
+// so24b
+
+#ifndef CANAL_H
+#define CANAL_H
+
+// fila circular de mensagens de tamanho fixo, para passar dados de uma
+//   thread (a produtora, a única que envia) para outra (a consumidora, a
+//   única que recebe)
+// não usa trava: com um só produtor e um só consumidor, cada índice da fila
+//   só é alterado por uma das threads, e basta que a alteração do índice
+//   seja vista depois da cópia da mensagem (operações atômicas de C11)
+// nenhuma operação espera: enviar para um canal cheio ou receber de um canal
+//   vazio retorna false na hora, e quem chamou decide o que fazer
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct canal_t canal_t;
+
+// cria um canal para até 'cap' mensagens de 'tam_msg' bytes
+// 'cap' deve ser uma potência de 2
+// mata o programa em caso de erro (malloc)
+canal_t *canal_cria(int cap, size_t tam_msg);
+
+// destrói o canal; nenhuma das threads pode estar usando
+void canal_destroi(canal_t *self);
+
+// copia a mensagem apontada por 'msg' para o fim do canal
+// só pode ser chamada pela thread produtora
+// retorna false se o canal estiver cheio
+bool canal_envia(canal_t *self, const void *msg);
+
+// copia para 'msg' a mensagem do início do canal, e a remove
+// só pode ser chamada pela thread consumidora
+// retorna false se o canal estiver vazio
+bool canal_recebe(canal_t *self, void *msg);
+
+#endif // CANAL_H
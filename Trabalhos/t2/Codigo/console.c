@@ -3,17 +3,34 @@
 // simulador de computador
 // so24b
 
+// com tela, a console é dividida entre duas threads:
+// - a da simulação, que chama as funções de console.h: tem os terminais, o
+//   arquivo de log e os comandos para o controlador
+// - a da tela, criada pela console: é a única que usa a tela (tela.h), tem
+//   uma cópia do que aparece nela, e lê o teclado
+// as threads só se comunicam por dois canais (ver canal.h), sem trava: a
+//   simulação manda para a tela as linhas da console, a linha de status e as
+//   linhas dos terminais que mudaram; a tela manda para a simulação as linhas
+//   de comando digitadas pelo operador
+// nenhuma das threads espera pela outra: se um canal estiver cheio, o que não
+//   coube é enviado depois (status e terminais) ou só vai para o log (linhas
+//   da console)
+
 // INCLUDES {{{1
 
 #include "console.h"
 #include "terminal.h"
 #include "tela.h"
+#include "dispositivos.h"
+#include "canal.h"
 
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <time.h>
+#include <pthread.h>
 #include <assert.h>
 
 // CONSTANTES {{{1
@@ -24,45 +41,121 @@
 #define N_COL 80  // número de colunas na tela
 
 // número de linhas para cada componente da tela
-#define N_TERM        4  // número de terminais, cada um ocupa 2 linhas na tela
-#define N_LIN_TERM    (N_TERM * 2)
+// cada terminal ocupa 2 linhas; a console fica com as que sobram, que
+//   dependem do número de terminais
 #define N_LIN_STATUS  1
 #define N_LIN_ENTRADA 1
-#define N_LIN_CONSOLE (N_LIN - N_LIN_TERM - N_LIN_STATUS - N_LIN_ENTRADA)
+#define N_LIN_CONSOLE_MAX (N_LIN - 2 - N_LIN_STATUS - N_LIN_ENTRADA)
 
-// linha onde começa cada componente
+// linha onde começa cada componente (os outros estão em console_t)
 #define LINHA_TERM    0
-#define LINHA_STATUS  (LINHA_TERM + N_LIN_TERM)
-#define LINHA_CONSOLE (LINHA_STATUS + N_LIN_STATUS)
-#define LINHA_ENTRADA (LINHA_CONSOLE + N_LIN_CONSOLE)
 
 // números de comandos para o controlador que podem ser guardados na console
 #define N_CMD_EXT 10
 
+// número de mensagens que cabem nos canais para a tela e da tela
+#define CAP_PARA_TELA 4096
+#define CAP_DA_TELA   64
+
 // DECLARAÇÃO {{{1
 
+// mensagens trocadas entre a simulação e a thread da tela
+typedef enum {
+  // da simulação para a tela
+  MSG_CONSOLE,   // uma linha para a área geral da console
+  MSG_STATUS,    // o texto da linha de status
+  MSG_TERMINAL,  // uma linha de um terminal, como deve aparecer
+  MSG_FIM,       // a simulação terminou
+  // da tela para a simulação
+  MSG_COMANDO,   // uma linha de comando digitada pelo operador
+} tipo_msg_t;
+
+typedef struct {
+  tipo_msg_t tipo;
+  // para MSG_TERMINAL, o número do terminal e a linha (0 entrada, 1 saída)
+  int terminal;
+  int linha;
+  char txt[N_COL+1];
+} mensagem_t;
+
 struct console_t {
-  terminal_t *term[N_TERM];
-  int cor_txt[N_TERM];
-  int cor_cursor[N_TERM];
-  char txt_status[N_COL+1];
-  char txt_console[N_LIN_CONSOLE][N_COL+1];
-  char txt_entrada[N_COL+1];
+  int n_term;
+  // false se a console está sendo usada sem tela (execução em lote)
+  bool com_tela;
+  // linhas da console e onde começam a status, a console e a entrada
+  int n_lin_console;
+  int linha_status;
+  int linha_console;
+  int linha_entrada;
+
+  // usados pela thread da simulação
+  terminal_t *term[MAX_TERMINAIS];
   char fila_de_comandos_externos[N_CMD_EXT];
   FILE *arquivo_de_log;
+  // arquivos da saída direta dos terminais, quando sem tela
+  FILE *arquivo_do_terminal[MAX_TERMINAIS];
+  // último texto de status enviado para a tela
+  char txt_status[N_COL+1];
+  // o que não coube no canal para a tela: o status e as linhas dos terminais
+  //   são enviados de novo, as linhas da console são só contadas
+  bool status_pendente;
+  bool terminal_pendente[MAX_TERMINAIS];
+  int linhas_perdidas;
+  // hora (real, em ms) a partir da qual as linhas dos terminais que mudaram
+  //   podem ser enviadas de novo para a tela
+  long proximo_envio_ms;
+
+  // canais entre as threads, e a thread da tela
+  canal_t *para_tela;
+  canal_t *da_tela;
+  pthread_t thread_tela;
+
+  // usados pela thread da tela
+  int cor_txt[MAX_TERMINAIS];
+  int cor_cursor[MAX_TERMINAIS];
+  char tela_terminal[MAX_TERMINAIS][2][N_COL+1];
+  char tela_status[N_COL+1];
+  char txt_console[N_LIN_CONSOLE_MAX][N_COL+1];
+  char txt_entrada[N_COL+1];
+  // partes da tela que mudaram desde o último desenho
+  bool terminal_mudou[MAX_TERMINAIS];
+  bool status_mudou;
+  bool console_mudou;
+  bool entrada_mudou;
 };
 
+// retorna a hora do sistema hospedeiro, em ms
+static long agora_ms(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000L + t.tv_nsec / 1000000;
+}
+
 // CRIAÇÃO {{{1
 
+static void *console_thread_tela(void *arg);
+
 static console_t *console_global; // gambiarra para simplificar o uso de prints na console
-console_t *console_cria(void)
+console_t *console_cria(bool com_tela, char *arquivo_log, int n_terminais,
+                        int cap_entrada)
 {
+  assert(n_terminais >= 1 && n_terminais <= MAX_TERMINAIS);
+  assert(cap_entrada >= 1);
   console_t *self = malloc(sizeof(*self));
   assert(self != NULL);
   console_global = self;
-
-  for (int t = 0; t < N_TERM; t++) {
-    self->term[t] = terminal_cria(N_COL);
+  self->com_tela = com_tela;
+  self->n_term = n_terminais;
+  self->linha_status = LINHA_TERM + n_terminais * 2;
+  self->linha_console = self->linha_status + N_LIN_STATUS;
+  self->n_lin_console = N_LIN - self->linha_console - N_LIN_ENTRADA;
+  self->linha_entrada = self->linha_console + self->n_lin_console;
+
+  for (int t = 0; t < self->n_term; t++) {
+    self->term[t] = terminal_cria(N_COL, cap_entrada);
+    self->arquivo_do_terminal[t] = NULL;
+    self->terminal_pendente[t] = false;
     if ((t % 2) == 0) {
       self->cor_txt[t] = COR_TXT_PAR;
       self->cor_cursor[t] = COR_CURSOR_PAR;
@@ -70,35 +163,61 @@ console_t *console_cria(void)
       self->cor_txt[t] = COR_TXT_IMPAR;
       self->cor_cursor[t] = COR_CURSOR_IMPAR;
     }
+    strcpy(self->tela_terminal[t][0], "");
+    strcpy(self->tela_terminal[t][1], "");
+    self->terminal_mudou[t] = true;
   }
-  for (int l = 0; l < N_LIN_CONSOLE; l++) {
+  for (int l = 0; l < self->n_lin_console; l++) {
     strcpy(self->txt_console[l], "");
   }
   strcpy(self->txt_entrada, "");
+  strcpy(self->txt_status, "");
+  strcpy(self->tela_status, "");
+  self->status_pendente = false;
+  self->linhas_perdidas = 0;
+  self->proximo_envio_ms = 0;
+  self->status_mudou = true;
+  self->console_mudou = true;
+  self->entrada_mudou = true;
   self->fila_de_comandos_externos[0] = '\0';
-  self->arquivo_de_log = fopen("log_da_console", "w");
-
-  tela_init();
+  self->arquivo_de_log = NULL;
+  if (arquivo_log != NULL) self->arquivo_de_log = fopen(arquivo_log, "w");
+  self->para_tela = NULL;
+  self->da_tela = NULL;
+
+  if (com_tela) {
+    self->para_tela = canal_cria(CAP_PARA_TELA, sizeof(mensagem_t));
+    self->da_tela = canal_cria(CAP_DA_TELA, sizeof(mensagem_t));
+    int r = pthread_create(&self->thread_tela, NULL, console_thread_tela, self);
+    assert(r == 0);
+  } else {
+    console_define_saida(self, NULL);
+  }
 
   return self;
 }
 
-static void console_desenha(console_t *self);
+static void fecha_arquivos_dos_terminais(console_t *self);
 
 void console_destroi(console_t *self)
 {
-  console_desenha(self);
-  if (self->arquivo_de_log != NULL) fclose(self->arquivo_de_log);
-  tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
-  tela_atualiza();
-  while (tela_tecla() != '\n') {
-    ;
+  if (self->com_tela) {
+    // a tela mostra o que falta, espera o operador e termina
+    // o fim não pode se perder: espera ter lugar no canal
+    mensagem_t msg = { .tipo = MSG_FIM };
+    while (!canal_envia(self->para_tela, &msg)) {
+      nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+    pthread_join(self->thread_tela, NULL);
+    canal_destroi(self->para_tela);
+    canal_destroi(self->da_tela);
   }
-  tela_fim();
+  if (self->arquivo_de_log != NULL) fclose(self->arquivo_de_log);
 
-  for (int t = 0; t < N_TERM; t++) {
+  for (int t = 0; t < self->n_term; t++) {
     terminal_destroi(self->term[t]);
   }
+  fecha_arquivos_dos_terminais(self);
   free(self);
   return;
 }
@@ -108,20 +227,77 @@ void console_destroi(console_t *self)
 terminal_t *console_terminal(console_t *self, char id_terminal)
 {
   int num_terminal = tolower(id_terminal) - 'a';
-  if (num_terminal < 0 || num_terminal >= N_TERM) return NULL;
+  if (num_terminal < 0 || num_terminal >= self->n_term) return NULL;
   return self->term[num_terminal];
 }
 
+int console_n_terminais(console_t *self)
+{
+  return self->n_term;
+}
+
+static void fecha_arquivos_dos_terminais(console_t *self)
+{
+  for (int t = 0; t < self->n_term; t++) {
+    FILE *arq = self->arquivo_do_terminal[t];
+    if (arq != NULL && arq != stdout) fclose(arq);
+    self->arquivo_do_terminal[t] = NULL;
+  }
+}
+
+bool console_define_saida(console_t *self, char *prefixo)
+{
+  if (self->com_tela) return false;
+  fecha_arquivos_dos_terminais(self);
+  for (int t = 0; t < self->n_term; t++) {
+    char id = 'A' + t;
+    char nome[100];
+    if (prefixo == NULL) {
+      // todos na saída padrão, cada linha identificada pelo terminal
+      self->arquivo_do_terminal[t] = stdout;
+      sprintf(nome, "%c: ", id);
+      terminal_define_saida_direta(self->term[t], stdout, nome);
+    } else {
+      snprintf(nome, sizeof(nome), "%s%c", prefixo, id);
+      self->arquivo_do_terminal[t] = fopen(nome, "w");
+      if (self->arquivo_do_terminal[t] == NULL) {
+        console_printf("Não foi possível criar o arquivo '%s'", nome);
+        console_define_saida(self, NULL);
+        return false;
+      }
+      terminal_define_saida_direta(self->term[t], self->arquivo_do_terminal[t], "");
+    }
+  }
+  return true;
+}
+
+bool console_grava_estado(console_t *self, FILE *arq)
+{
+  for (int t = 0; t < self->n_term; t++) {
+    if (!terminal_grava_estado(self->term[t], arq)) return false;
+  }
+  return true;
+}
+
+bool console_le_estado(console_t *self, FILE *arq)
+{
+  for (int t = 0; t < self->n_term; t++) {
+    if (!terminal_le_estado(self->term[t], arq)) return false;
+  }
+  return true;
+}
+
 static void atualiza_terminais(console_t *self)
 {
-  for (int t = 0; t < N_TERM; t++) {
+  for (int t = 0; t < self->n_term; t++) {
     terminal_tictac(self->term[t]);
   }
 }
 
-static void insere_string_no_terminal(console_t *self, char id_terminal, char *str)
+static void insere_string_no_terminal(console_t *self, char id_terminal, char *str,
+                                      char final)
 {
-  // insere caracteres no terminal (e espaço no final)
+  // insere caracteres no terminal (e 'final' no final)
   terminal_t *terminal = console_terminal(self, id_terminal);
   if (terminal == NULL) {
     console_printf("Terminal '%c' inválido\n", id_terminal);
@@ -132,7 +308,7 @@ static void insere_string_no_terminal(console_t *self, char id_terminal, char *s
     terminal_insere_char(terminal, *p);
     p++;
   }
-  terminal_insere_char(terminal, ' ');
+  terminal_insere_char(terminal, final);
 }
 
 static void limpa_saida_do_terminal(console_t *self, char id_terminal)
@@ -147,17 +323,36 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
 
 // SAÍDA {{{1
 
+// envia uma mensagem com o texto 'txt' para a tela
+// retorna false se o canal estiver cheio
+static bool envia_para_tela(console_t *self, tipo_msg_t tipo, int terminal,
+                            int linha, char *txt)
+{
+  mensagem_t msg = { .tipo = tipo, .terminal = terminal, .linha = linha };
+  strncpy(msg.txt, txt, N_COL);
+  msg.txt[N_COL] = '\0';
+  return canal_envia(self->para_tela, &msg);
+}
+
 static void insere_string_na_console(console_t *self, char *s)
 {
-  for(int l=0; l<N_LIN_CONSOLE-1; l++) {
-    strncpy(self->txt_console[l], self->txt_console[l+1], N_COL);
-    self->txt_console[l][N_COL] = '\0'; // quem definiu strncpy é estúpido!
-  }
-  strncpy(self->txt_console[N_LIN_CONSOLE-1], s, N_COL);
-  self->txt_console[N_LIN_CONSOLE-1][N_COL] = '\0'; // grrrr
   if (self->arquivo_de_log != NULL) {
     fprintf(self->arquivo_de_log, "%s\n", s);
   }
+  // avisa antes quantas linhas não couberam no canal
+  if (self->linhas_perdidas > 0) {
+    char aviso[N_COL+1];
+    snprintf(aviso, sizeof(aviso), "(%d linhas não mostradas, ver o log)",
+             self->linhas_perdidas);
+    if (!envia_para_tela(self, MSG_CONSOLE, 0, 0, aviso)) {
+      self->linhas_perdidas++;
+      return;
+    }
+    self->linhas_perdidas = 0;
+  }
+  if (!envia_para_tela(self, MSG_CONSOLE, 0, 0, s)) {
+    self->linhas_perdidas++;
+  }
 }
 
 static void insere_strings_na_console(console_t *self, char *s)
@@ -177,8 +372,26 @@ static void insere_strings_na_console(console_t *self, char *s)
 
 void console_print_status(console_t *self, char *txt)
 {
-  // imprime alinhado a esquerda ("-"), max N_COL chars ("*")
-  sprintf(self->txt_status, "%-*s", N_COL, txt);
+  // sem tela, ninguém vai ver o status
+  if (!self->com_tela) return;
+  // o texto é completado com espaços só quando é desenhado
+  if (!self->status_pendente && strncmp(self->txt_status, txt, N_COL) == 0) return;
+  strncpy(self->txt_status, txt, N_COL);
+  self->txt_status[N_COL] = '\0';
+  self->status_pendente = !envia_para_tela(self, MSG_STATUS, 0, 0, self->txt_status);
+}
+
+// envia para a tela as linhas dos terminais que mudaram
+static void envia_terminais(console_t *self)
+{
+  for (int t = 0; t < self->n_term; t++) {
+    terminal_t *terminal = self->term[t];
+    // terminal_mudou é sempre chamada, para esquecer a mudança
+    if (!terminal_mudou(terminal) && !self->terminal_pendente[t]) continue;
+    self->terminal_pendente[t] =
+      !envia_para_tela(self, MSG_TERMINAL, t, 0, terminal_txt_entrada(terminal))
+      || !envia_para_tela(self, MSG_TERMINAL, t, 1, terminal_txt_saida(terminal));
+  }
 }
 
 int console_printf(char *formato, ...)
@@ -187,11 +400,17 @@ int console_printf(char *formato, ...)
   // Se não sabe como é isso, dá uma olhada em:
   // https://www.geeksforgeeks.org/variadic-functions-in-c/
   console_t *self = console_global; // gambiarra para simplificar o uso de prints na console
-  char s[sizeof(self->txt_console)];
+  char s[N_LIN_CONSOLE_MAX * (N_COL+1)];
   va_list arg;
   va_start(arg, formato);
   int r = vsnprintf(s, sizeof(s), formato, arg);
-  insere_strings_na_console(self, s);
+  va_end(arg);
+  if (self->com_tela) {
+    insere_strings_na_console(self, s);
+  } else if (self->arquivo_de_log != NULL) {
+    // sem tela, não precisa separar as linhas da console, vai direto pro log
+    fprintf(self->arquivo_de_log, "%s\n", s);
+  }
   return r;
 }
 
@@ -216,32 +435,38 @@ static char remove_comando_externo(console_t *self)
   return cmd;
 }
 
-static void interpreta_linha_entrada(console_t *self)
+static void interpreta_linha_entrada(console_t *self, char *linha)
 {
   // interpreta uma linha digitada pelo operador
   // Comandos aceitos:
   // Etstr entra a string 'str' no terminal 't'  ex: eb30
+  // Ltstr entra a linha 'str' no terminal 't', terminada por '\n'  ex: la oi
   // Zt    esvazia a saída do terminal 't'  ex: za
-  // Dn    altera o tempo de espera do teclado  ex: d0  -> modo turbo
+  // Vn    altera a velocidade de rolagem dos terminais, em caracteres por
+  //       atualização  ex: v0 -> uma linha inteira por vez
   // P     para a execução
   // 1     executa uma instrução
   // C     continua a execução
   // F     fim da simulação
 
-  char *linha = self->txt_entrada;
   console_printf("CMD: '%s'", linha);
   char cmd = toupper(linha[0]);
   int val;
   switch (cmd) {
     case 'E':
-      insere_string_no_terminal(self, linha[1], &linha[2]);
+      insere_string_no_terminal(self, linha[1], &linha[2], ' ');
+      break;
+    case 'L':
+      insere_string_no_terminal(self, linha[1], &linha[2], '\n');
       break;
     case 'Z':
       limpa_saida_do_terminal(self, linha[1]);
       break;
-    case 'D':
+    case 'V':
       val = atoi(&linha[1]);
-      tela_espera(val);
+      for (int t = 0; t < self->n_term; t++) {
+        terminal_define_velocidade(self->term[t], val);
+      }
       break;
     case 'P':
     case '1':
@@ -252,36 +477,110 @@ static void interpreta_linha_entrada(console_t *self)
     default:
       console_printf("Comando '%c' não reconhecido", cmd);
   }
-  strcpy(self->txt_entrada, "");
 }
 
-// lê e guarda um caractere do teclado; interpreta linha se for 'enter'
-static void verifica_entrada(console_t *self)
+// interpreta as linhas de comando que chegaram da tela
+static void recebe_comandos(console_t *self)
 {
-  char ch = tela_tecla();
+  mensagem_t msg;
+  while (canal_recebe(self->da_tela, &msg)) {
+    interpreta_linha_entrada(self, msg.txt);
+  }
+}
+
+char console_comando_externo(console_t *self)
+{
+  return remove_comando_externo(self);
+}
+
+// TELA {{{1
 
-  int l = strlen(self->txt_entrada);
+// tudo nesta parte é executado pela thread da tela
 
-  if (ch == '\b' || ch == 127) {   // backspace ou del
-    if (l > 0) {
-      self->txt_entrada[l - 1] = '\0';
+// coloca uma linha no final da área geral da console, rolando as outras
+static void tela_insere_na_console(console_t *self, char *s)
+{
+  int n_lin = self->n_lin_console;
+  for(int l=0; l<n_lin-1; l++) {
+    strncpy(self->txt_console[l], self->txt_console[l+1], N_COL);
+    self->txt_console[l][N_COL] = '\0'; // quem definiu strncpy é estúpido!
+  }
+  strncpy(self->txt_console[n_lin-1], s, N_COL);
+  self->txt_console[n_lin-1][N_COL] = '\0'; // grrrr
+  self->console_mudou = true;
+}
+
+// atualiza a cópia do que aparece na tela com as mensagens da simulação
+// retorna true se a simulação terminou
+static bool tela_recebe_mensagens(console_t *self)
+{
+  mensagem_t msg;
+  // não esvazia um canal que está sempre recebendo: a tela tem que ser
+  //   desenhada de vez em quando
+  for (int i = 0; i < CAP_PARA_TELA && canal_recebe(self->para_tela, &msg); i++) {
+    switch (msg.tipo) {
+      case MSG_CONSOLE:
+        tela_insere_na_console(self, msg.txt);
+        break;
+      case MSG_STATUS:
+        strcpy(self->tela_status, msg.txt);
+        self->status_mudou = true;
+        break;
+      case MSG_TERMINAL:
+        strcpy(self->tela_terminal[msg.terminal][msg.linha], msg.txt);
+        self->terminal_mudou[msg.terminal] = true;
+        break;
+      case MSG_FIM:
+        return true;
+      default:
+        break;
     }
-  } else if (ch == '\n') {
-    interpreta_linha_entrada(self);
-  } else if (ch >= ' ' && ch < 127 && l < N_COL) {
-    self->txt_entrada[l] = ch;
-    self->txt_entrada[l+1] = '\0';
-  } // senão, ignora o caractere digitado
+  }
+  return false;
 }
 
-char console_comando_externo(console_t *self)
+// manda a linha digitada para a simulação (se não for vazia)
+static void tela_envia_linha_entrada(console_t *self)
 {
-  verifica_entrada(self);
-  return remove_comando_externo(self);
+  char *linha = self->txt_entrada;
+  if (linha[0] == '\0') return;
+  mensagem_t msg = { .tipo = MSG_COMANDO };
+  strcpy(msg.txt, linha);
+  if (!canal_envia(self->da_tela, &msg)) {
+    tela_insere_na_console(self, "muitos comandos na fila, comando ignorado");
+  }
+  strcpy(self->txt_entrada, "");
+  self->entrada_mudou = true;
+}
+
+// lê e guarda os caracteres já digitados; envia a linha a cada 'enter'
+static void tela_verifica_entrada(console_t *self)
+{
+  char ch;
+  while ((ch = tela_tecla()) != 0) {
+    int l = strlen(self->txt_entrada);
+
+    if (ch == '\b' || ch == 127) {   // backspace ou del
+      if (l > 0) {
+        self->txt_entrada[l - 1] = '\0';
+        self->entrada_mudou = true;
+      }
+    } else if (ch == '\n') {
+      tela_envia_linha_entrada(self);
+    } else if (ch >= ' ' && ch < 127 && l < N_COL) {
+      self->txt_entrada[l] = ch;
+      self->txt_entrada[l+1] = '\0';
+      self->entrada_mudou = true;
+    } // senão, ignora o caractere digitado
+  }
 }
 
 // DESENHO {{{1
 
+// a tela só é redesenhada CONSOLE_QUADROS_POR_SEGUNDO vezes por segundo, e
+//   só nas partes que mudaram desde o último desenho
+// com 'tudo' true, desenha todas as partes
+
 static void desenha_linha_terminal(char *txt, int linha, int cor_txt, int cor_cursor)
 {
   tela_posiciona(linha, 0);
@@ -290,63 +589,136 @@ static void desenha_linha_terminal(char *txt, int linha, int cor_txt, int cor_cu
   tela_puts(cor_cursor, " ");
 }
 
-static void desenha_terminais(console_t *self)
+static bool desenha_terminais(console_t *self, bool tudo)
 {
-  for (int t = 0; t < N_TERM; t++) {
-    terminal_t *terminal = self->term[t];
+  bool desenhou = false;
+  for (int t = 0; t < self->n_term; t++) {
+    if (!self->terminal_mudou[t] && !tudo) continue;
+    self->terminal_mudou[t] = false;
     int cor_txt = self->cor_txt[t];
     int cor_cursor = self->cor_cursor[t];
     int linha = LINHA_TERM + t * 2;
-    desenha_linha_terminal(terminal_txt_entrada(terminal), linha, cor_txt, cor_cursor);
-    desenha_linha_terminal(terminal_txt_saida(terminal), linha+1, cor_txt, cor_cursor);
+    desenha_linha_terminal(self->tela_terminal[t][0], linha, cor_txt, cor_cursor);
+    desenha_linha_terminal(self->tela_terminal[t][1], linha+1, cor_txt, cor_cursor);
+    desenhou = true;
   }
+  return desenhou;
 }
 
-static void desenha_status(console_t *self)
+static bool desenha_status(console_t *self, bool tudo)
 {
-  tela_posiciona(LINHA_STATUS, 0);
-  tela_puts(COR_STATUS, self->txt_status);
+  if (!self->status_mudou && !tudo) return false;
+  self->status_mudou = false;
+  // alinhado a esquerda ("-"), N_COL chars ("*"), para pintar a linha toda
+  char txt[N_COL+1];
+  sprintf(txt, "%-*s", N_COL, self->tela_status);
+  tela_posiciona(self->linha_status, 0);
+  tela_puts(COR_STATUS, txt);
   tela_limpa_linha();
+  return true;
 }
 
-static void desenha_console(console_t *self)
+static bool desenha_console(console_t *self, bool tudo)
 {
-  for (int l=0; l<N_LIN_CONSOLE; l++) {
-    tela_posiciona(LINHA_CONSOLE + l, 0);
+  if (!self->console_mudou && !tudo) return false;
+  self->console_mudou = false;
+  for (int l=0; l<self->n_lin_console; l++) {
+    tela_posiciona(self->linha_console + l, 0);
     tela_puts(COR_CONSOLE, self->txt_console[l]);
     tela_limpa_linha();
   }
+  return true;
 }
 
-static void desenha_entrada(console_t *self)
+static bool desenha_entrada(console_t *self, bool tudo)
 {
-  char txt_fixo[] = "P=para C=continua 1=passo F=fim  Ets=entra Zt=zera";
-  tela_posiciona(LINHA_ENTRADA, 0);
+  if (!self->entrada_mudou && !tudo) return false;
+  self->entrada_mudou = false;
+  char txt_fixo[] = "P=para C=continua 1=passo F=fim  Ets=entra Zt=zera Vn=veloc";
+  tela_posiciona(self->linha_entrada, 0);
   tela_puts(COR_ENTRADA, ""); // gambiarra para limpar na cor certa
   tela_limpa_linha();
-  tela_posiciona(LINHA_ENTRADA, N_COL - sizeof(txt_fixo));
+  tela_posiciona(self->linha_entrada, N_COL - sizeof(txt_fixo));
   tela_puts(COR_ENTRADA, txt_fixo);
-  tela_posiciona(LINHA_ENTRADA, 0);
+  tela_posiciona(self->linha_entrada, 0);
   tela_puts(COR_ENTRADA, self->txt_entrada);
+  return true;
 }
 
-static void console_desenha(console_t *self)
+static void console_desenha(console_t *self, bool tudo)
 {
-  desenha_terminais(self);
-  desenha_status(self);
-  desenha_console(self);
-  desenha_entrada(self);
+  // todas as partes são visitadas, para esquecerem as mudanças
+  bool desenhou = desenha_terminais(self, tudo);
+  desenhou = desenha_status(self, tudo) || desenhou;
+  desenhou = desenha_console(self, tudo) || desenhou;
+  desenhou = desenha_entrada(self, tudo) || desenhou;
+
+  // faz aparecer tudo que foi desenhado, com o cursor na linha de entrada
+  if (desenhou) {
+    tela_posiciona(self->linha_entrada, strlen(self->txt_entrada));
+    tela_atualiza();
+  }
+}
 
-  // faz aparecer tudo que foi desenhado
-  tela_atualiza();
+// o laço da thread da tela, até a simulação terminar: a cada quadro, recebe
+//   as mensagens da simulação e redesenha o que mudou; entre um quadro e
+//   outro, dorme esperando o teclado, e só acorda antes se tiver tecla
+// a simulação não é avisada das mensagens que envia; elas esperam no canal
+//   até o próximo quadro, que é quando seriam desenhadas
+static void *console_thread_tela(void *arg)
+{
+  console_t *self = arg;
+  tela_init();
+  long proximo_quadro_ms = 0;
+  bool fim = false;
+  while (!fim) {
+    long agora = agora_ms();
+    if (agora >= proximo_quadro_ms) {
+      proximo_quadro_ms = agora + 1000 / CONSOLE_QUADROS_POR_SEGUNDO;
+      fim = tela_recebe_mensagens(self);
+      console_desenha(self, false);
+      continue;
+    }
+    if (tela_espera_tecla(proximo_quadro_ms - agora)) {
+      tela_verifica_entrada(self);
+    }
+  }
+  console_desenha(self, true);
+  // sem ninguém vendo a tela, não tem por que esperar o enter
+  if (tela_visivel()) {
+    tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
+    tela_atualiza();
+    while (tela_espera_tecla(-1) && tela_tecla() != '\n') {
+    }
+  }
+  tela_fim();
+  return NULL;
 }
 
 // TICTAC {{{1
+bool console_terminais_ocupados(console_t *self)
+{
+  for (int t = 0; t < self->n_term; t++) {
+    if (terminal_ocupado(self->term[t])) return true;
+  }
+  return false;
+}
+
 void console_tictac(console_t *self)
 {
-  verifica_entrada(self);
+  if (!self->com_tela) {
+    atualiza_terminais(self);
+    return;
+  }
+  recebe_comandos(self);
   atualiza_terminais(self);
-  console_desenha(self);
+  // a tela não desenha mais rápido que isso, não adianta mandar mais
+  long agora = agora_ms();
+  if (agora >= self->proximo_envio_ms) {
+    self->proximo_envio_ms = agora + 1000 / CONSOLE_QUADROS_POR_SEGUNDO;
+    envia_terminais(self);
+    if (self->status_pendente) console_print_status(self, self->txt_status);
+  }
 }
 
 // vim: foldmethod=marker
@@ -11,16 +11,38 @@
 
 typedef struct console_t console_t;
 
+// número máximo de vezes por segundo que a tela é redesenhada; cada vez, só
+//   as partes que mudaram (terminais, status, console, entrada)
+#define CONSOLE_QUADROS_POR_SEGUNDO 30
+
 // cria e inicializa a console
-console_t *console_cria(void);
+// com tela, a console cria uma thread que desenha a tela e lê o teclado; as
+//   funções daqui devem ser chamadas só pela thread da simulação, e não
+//   esperam pela tela (ver console.c)
+// se 'com_tela' for false, a console não usa a tela: não lê o teclado, não
+//   desenha nada, o que é impresso na console só vai para o arquivo de log e
+//   a saída dos terminais vai direto para 'saida' (ver console_define_saida)
+// o que é impresso na console é também gravado no arquivo 'arquivo_log'
+//   (NULL para não ter arquivo de log)
+// a console tem 'n_terminais' terminais, de 1 a MAX_TERMINAIS (ver
+//   dispositivos.h); com tela, as linhas que sobram dos terminais são da
+//   área geral da console
+// cada terminal guarda até 'cap_entrada' caracteres digitados e ainda não
+//   lidos
+console_t *console_cria(bool com_tela, char *arquivo_log, int n_terminais,
+                        int cap_entrada);
 
 // destrói a console
+// com tela, espera o operador digitar ENTER e termina a thread da tela
 void console_destroi(console_t *self);
 
 // imprime na área geral do console
 int console_printf(char *fmt, ...);
 
 // imprime na linha de status
+// a linha só é redesenhada se o texto mudou; como a tela não é redesenhada
+//   mais que CONSOLE_QUADROS_POR_SEGUNDO vezes por segundo, não adianta
+//   chamar com mais frequência que isso
 void console_print_status(console_t *self, char *txt);
 
 // retorna o próximo comando externo digitado pelo operador na console.
@@ -34,10 +56,33 @@ void console_print_status(console_t *self, char *txt);
 // retorna '\0' caso não tenha comando externo digitado
 char console_comando_externo(console_t *self);
 
-// retorna o terminal identificado ('A', 'B', etc)
+// retorna o terminal identificado ('A', 'B', etc), ou NULL se não existir
 terminal_t *console_terminal(console_t *self, char id_terminal);
 
+// retorna o número de terminais da console
+int console_n_terminais(console_t *self);
+
+// define para onde vai a saída dos terminais quando a console não tem tela
+// se 'prefixo' for NULL, a saída de todos os terminais vai para a saída
+//   padrão, cada linha precedida pela identificação do terminal; senão, a
+//   saída de cada terminal vai para um arquivo com o nome formado pelo
+//   prefixo seguido pela identificação do terminal (ex: "saida_A")
+// retorna false se não conseguir abrir algum arquivo
+bool console_define_saida(console_t *self, char *prefixo);
+
+// retorna true se algum terminal está rolando ou limpando a saída, o que
+//   anda a cada chamada a console_tictac
+bool console_terminais_ocupados(console_t *self);
+
+// grava no arquivo o estado dos terminais, ou lê o estado gravado (ver
+//   estado.h); a tela não faz parte do estado
+// retornam false em caso de erro
+bool console_grava_estado(console_t *self, FILE *arq);
+bool console_le_estado(console_t *self, FILE *arq);
+
 // esta função deve ser chamada periodicamente para que tela funcione
+// atende os comandos digitados, faz andar os terminais e envia para a tela
+//   o que mudou neles; não espera o teclado
 void console_tictac(console_t *self);
 
 #endif // CONSOLE_H
@@ -0,0 +1,161 @@
+// controlador_int.c
+// controlador de interrupções
+// simulador de computador
+// so24b
+
+#include "controlador_int.h"
+#include "estado.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+// um dispositivo que pede interrupção por nível
+typedef struct {
+  void *disp;
+  f_linha_int_t f_linha;
+} linha_int_t;
+
+struct controlador_int_t {
+  // pedidos por borda ainda não entregues
+  unsigned pedidos;
+  // máscara das interrupções que podem ser entregues
+  unsigned habilitadas;
+  int prioridade[N_IRQ];
+  // dispositivos que pedem por nível (f_linha NULL se não tem)
+  linha_int_t linha[N_IRQ];
+  // interrupção acessada pelo registrador de prioridade
+  int selecionada;
+};
+
+controlador_int_t *controlador_int_cria(void)
+{
+  controlador_int_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->pedidos = 0;
+  self->habilitadas = (1u << N_IRQ) - 1;
+  for (int irq = 0; irq < N_IRQ; irq++) {
+    self->prioridade[irq] = 0;
+    self->linha[irq].disp = NULL;
+    self->linha[irq].f_linha = NULL;
+  }
+  self->selecionada = 0;
+  return self;
+}
+
+void controlador_int_destroi(controlador_int_t *self)
+{
+  free(self);
+}
+
+void controlador_int_registra_linha(controlador_int_t *self, irq_t irq,
+                                    void *disp, f_linha_int_t f_linha)
+{
+  assert(irq >= 0 && irq < N_IRQ);
+  self->linha[irq].disp = disp;
+  self->linha[irq].f_linha = f_linha;
+}
+
+void controlador_int_pede(controlador_int_t *self, irq_t irq)
+{
+  self->pedidos |= 1u << irq;
+}
+
+// máscara das interrupções pendentes: os pedidos por borda mais os
+//   dispositivos que estão pedindo por nível
+static unsigned controlador_int_pendentes(controlador_int_t *self)
+{
+  unsigned pendentes = self->pedidos;
+  for (int irq = 0; irq < N_IRQ; irq++) {
+    linha_int_t *linha = &self->linha[irq];
+    if (linha->f_linha != NULL && linha->f_linha(linha->disp)) {
+      pendentes |= 1u << irq;
+    }
+  }
+  return pendentes;
+}
+
+bool controlador_int_tem_interrupcao(controlador_int_t *self)
+{
+  return (controlador_int_pendentes(self) & self->habilitadas) != 0;
+}
+
+bool controlador_int_proxima(controlador_int_t *self, irq_t *pirq)
+{
+  unsigned mapa = controlador_int_pendentes(self) & self->habilitadas;
+  int escolhida = -1;
+  for (int irq = 0; irq < N_IRQ; irq++) {
+    if ((mapa & (1u << irq)) == 0) continue;
+    if (escolhida == -1 || self->prioridade[irq] > self->prioridade[escolhida]) {
+      escolhida = irq;
+    }
+  }
+  if (escolhida == -1) return false;
+  *pirq = escolhida;
+  return true;
+}
+
+void controlador_int_aceita(controlador_int_t *self, irq_t irq)
+{
+  self->pedidos &= ~(1u << irq);
+}
+
+err_t controlador_int_leitura(void *disp, int id, int *pvalor)
+{
+  controlador_int_t *self = disp;
+  switch (id) {
+    case 0:
+      *pvalor = controlador_int_pendentes(self);
+      break;
+    case 1:
+      *pvalor = self->habilitadas;
+      break;
+    case 2:
+      *pvalor = self->selecionada;
+      break;
+    case 3:
+      *pvalor = self->prioridade[self->selecionada];
+      break;
+    default:
+      return ERR_END_INV;
+  }
+  return ERR_OK;
+}
+
+err_t controlador_int_escrita(void *disp, int id, int valor)
+{
+  controlador_int_t *self = disp;
+  switch (id) {
+    case 0:
+      self->pedidos &= ~valor;
+      break;
+    case 1:
+      self->habilitadas = valor & ((1u << N_IRQ) - 1);
+      break;
+    case 2:
+      if (valor < 0 || valor >= N_IRQ) return ERR_OP_INV;
+      self->selecionada = valor;
+      break;
+    case 3:
+      self->prioridade[self->selecionada] = valor;
+      break;
+    default:
+      return ERR_END_INV;
+  }
+  return ERR_OK;
+}
+
+bool controlador_int_grava_estado(controlador_int_t *self, FILE *arq)
+{
+  return ESTADO_GRAVA(arq, self->pedidos)
+      && ESTADO_GRAVA(arq, self->habilitadas)
+      && ESTADO_GRAVA(arq, self->prioridade)
+      && ESTADO_GRAVA(arq, self->selecionada);
+}
+
+bool controlador_int_le_estado(controlador_int_t *self, FILE *arq)
+{
+  return ESTADO_LE(arq, self->pedidos)
+      && ESTADO_LE(arq, self->habilitadas)
+      && ESTADO_LE(arq, self->prioridade)
+      && ESTADO_LE(arq, self->selecionada);
+}
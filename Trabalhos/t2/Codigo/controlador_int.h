@@ -0,0 +1,84 @@
+// controlador_int.h
+// controlador de interrupções
+// simulador de computador
+// so24b
+
+#ifndef CONTROLADOR_INT_H
+#define CONTROLADOR_INT_H
+
+// simulador de um controlador de interrupções
+//
+// junta os pedidos de interrupção dos dispositivos e decide qual deles é
+//   entregue à CPU
+// um dispositivo pode pedir interrupção de duas formas:
+// - por nível: o controlador consulta uma função do dispositivo, que diz se
+//   ele está pedindo interrupção; o pedido continua enquanto o dispositivo
+//   não for desarmado (pelo SO, através dos registradores do dispositivo).
+//   é o caso do relógio e do disco
+// - por borda: o dispositivo avisa o controlador quando acontece o evento
+//   (controlador_int_pede), e o pedido fica registrado até ser entregue à
+//   CPU ou removido pelo SO. é o caso do teclado e da tela dos terminais,
+//   que não têm como ser desarmados
+// o controlador mantém uma máscara das interrupções pendentes (pedidas
+//   e ainda não entregues), uma das habilitadas (só essas são entregues)
+//   e a prioridade de cada interrupção; quando tem mais de uma pendente e
+//   habilitada, é entregue a de maior prioridade, e entre as de mesma
+//   prioridade a de menor número
+// o bit i das máscaras corresponde à interrupção i (ver irq.h)
+
+#include "err.h"
+#include "irq.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef struct controlador_int_t controlador_int_t;
+
+// tipo da função que o controlador chama para saber se um dispositivo está
+//   pedindo interrupção por nível; recebe o ponteiro fornecido no registro
+typedef bool (*f_linha_int_t)(void *disp);
+
+// cria e inicializa um controlador de interrupções, com nada pendente,
+//   todas as interrupções habilitadas e com a mesma prioridade (0)
+controlador_int_t *controlador_int_cria(void);
+
+// destrói um controlador de interrupções
+void controlador_int_destroi(controlador_int_t *self);
+
+// registra 'f_linha' como a função que diz se o dispositivo 'disp' está
+//   pedindo a interrupção 'irq' por nível
+void controlador_int_registra_linha(controlador_int_t *self, irq_t irq,
+                                    void *disp, f_linha_int_t f_linha);
+
+// pedido de interrupção por borda, feito por um dispositivo
+void controlador_int_pede(controlador_int_t *self, irq_t irq);
+
+// retorna true se tem interrupção pendente e habilitada
+bool controlador_int_tem_interrupcao(controlador_int_t *self);
+
+// coloca em '*pirq' a interrupção que deve ser entregue à CPU
+// retorna false se não tiver nenhuma pendente e habilitada
+bool controlador_int_proxima(controlador_int_t *self, irq_t *pirq);
+
+// informa que a interrupção 'irq' foi aceita pela CPU
+// o pedido por borda é removido; o por nível continua até o dispositivo
+//   ser desarmado
+void controlador_int_aceita(controlador_int_t *self, irq_t irq);
+
+// Funções para acessar o controlador como dispositivo de E/S, com id:
+//   '0' leitura da máscara de interrupções pendentes; escrever remove os
+//       pedidos por borda dos bits ligados no valor escrito
+//   '1' leitura ou escrita da máscara de interrupções habilitadas
+//   '2' leitura ou escrita da interrupção selecionada para o dispositivo 3
+//   '3' leitura ou escrita da prioridade da interrupção selecionada
+// Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
+err_t controlador_int_leitura(void *disp, int id, int *pvalor);
+err_t controlador_int_escrita(void *disp, int id, int valor);
+
+// grava no arquivo o estado do controlador (pedidos, máscara e
+//   prioridades), ou lê o estado gravado (ver estado.h)
+// os dispositivos registrados não fazem parte do estado
+// retornam false em caso de erro
+bool controlador_int_grava_estado(controlador_int_t *self, FILE *arq);
+bool controlador_int_le_estado(controlador_int_t *self, FILE *arq);
+
+#endif // CONTROLADOR_INT_H
@@ -4,25 +4,64 @@
 // so24b
 
 #include "controle.h"
+#include "estado.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include <assert.h>
 
 struct controle_t {
   cpu_t *cpu;
   relogio_t *relogio;
+  disco_t *disco;
+  controlador_int_t *ci;
   console_t *console;
   enum { executando, passo, parado, fim } estado;
+  // execução em lote: sem tela, a console é atendida só de vez em quando
+  bool em_lote;
+  // número máximo de instruções executadas entre atendimentos da console
+  int intervalo_console;
+  // tempo real máximo entre atendimentos da console (ms, 0 se não usa)
+  int intervalo_console_ms;
+  // número de instruções executadas desde o último atendimento da console
+  int instrucoes_desde_console;
+  // número de instruções executadas desde a última consulta à hora real
+  int instrucoes_desde_hora;
+  // hora (real, em ms) do próximo atendimento da console
+  long proximo_atendimento_ms;
+  // número de instruções executadas e limite (0 se não tem)
+  // o tempo pulado com a CPU parada conta como instruções (é tempo que passou)
+  long instrucoes;
+  long limite_instrucoes;
+  // quanto tempo foi pulado com a CPU parada, esperando uma interrupção
+  long tempo_pulado;
+  // quantas instruções do lote em execução já passaram nos dispositivos
+  //   (ver controle_sincroniza)
+  int avancado_no_lote;
+  // estado mostrado na linha de status, e hora (real, em ms) a partir da
+  //   qual a linha pode ser atualizada de novo
+  int estado_no_status;
+  long proximo_status_ms;
 };
 
+// a cada quantas instruções consulta o tempo real, que é uma operação cara
+#define INSTRUCOES_ENTRE_CONSULTAS_A_HORA 1024
+
+// tempo real (ms) de espera entre atendimentos da console com a máquina
+//   parada; a tela tem sua própria thread, não precisa que a console seja
+//   atendida sem parar para responder ao teclado
+#define ESPERA_PARADO_MS 5
+
 // funções auxiliares
 static void controle_processa_comandos_da_console(controle_t *self);
 static void controle_atualiza_estado_na_console(controle_t *self);
+static void controle_sincroniza(void *arg, int n);
 
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          disco_t *disco, controlador_int_t *ci)
 {
   controle_t *self = malloc(sizeof(*self));
   assert(self != NULL);
@@ -30,7 +69,23 @@ controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
   self->cpu = cpu;
   self->console = console;
   self->relogio = relogio;
+  self->disco = disco;
+  self->ci = ci;
   self->estado = parado;
+  self->em_lote = false;
+  self->intervalo_console = 1;
+  self->intervalo_console_ms = 0;
+  self->instrucoes_desde_console = 0;
+  self->instrucoes_desde_hora = 0;
+  self->proximo_atendimento_ms = 0;
+  self->instrucoes = 0;
+  self->limite_instrucoes = 0;
+  self->tempo_pulado = 0;
+  self->avancado_no_lote = 0;
+  self->estado_no_status = -1;
+  self->proximo_status_ms = 0;
+
+  cpu_define_sincronizacao(cpu, controle_sincroniza, self);
 
   return self;
 }
@@ -40,32 +95,236 @@ void controle_destroi(controle_t *self)
   free(self);
 }
 
+bool controle_grava_estado(controle_t *self, FILE *arq)
+{
+  return ESTADO_GRAVA(arq, self->instrucoes)
+      && ESTADO_GRAVA(arq, self->tempo_pulado)
+      && ESTADO_GRAVA(arq, self->instrucoes_desde_console);
+}
+
+bool controle_le_estado(controle_t *self, FILE *arq)
+{
+  return ESTADO_LE(arq, self->instrucoes)
+      && ESTADO_LE(arq, self->tempo_pulado)
+      && ESTADO_LE(arq, self->instrucoes_desde_console);
+}
+
+void controle_define_lote(controle_t *self, int intervalo, int intervalo_ms,
+                          long limite)
+{
+  self->em_lote = true;
+  self->estado = executando;
+  self->intervalo_console = intervalo > 0 ? intervalo : 1;
+  self->intervalo_console_ms = intervalo_ms;
+  self->limite_instrucoes = limite;
+}
+
+// retorna a hora do sistema hospedeiro, em ms
+static long agora_ms(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000L + t.tv_nsec / 1000000;
+}
+
+// retorna a hora do próximo evento dos dispositivos que pode gerar
+//   interrupção, ou -1 se não tem nenhum previsto
+// um terminal rolando ou limpando a saída anda a cada atendimento da
+//   console, então o tempo não pode ser pulado enquanto isso acontece
+static int controle_proximo_evento(controle_t *self)
+{
+  if (console_terminais_ocupados(self->console)) {
+    return relogio_agora(self->relogio) + 1;
+  }
+  int evento = relogio_proximo_evento(self->relogio);
+  int t_disco = disco_tempo_ate_evento(self->disco);
+  if (t_disco != -1) {
+    int evento_disco = relogio_agora(self->relogio) + t_disco;
+    if (evento == -1 || evento_disco < evento) evento = evento_disco;
+  }
+  return evento;
+}
+
+// retorna true se algum dispositivo está pedindo interrupção (habilitada)
+static bool controle_tem_interrupcao(controle_t *self)
+{
+  return controlador_int_tem_interrupcao(self->ci);
+}
+
+// entrega à CPU a interrupção escolhida pelo controlador de interrupções,
+//   se tiver alguma e a CPU puder aceitar
+static void controle_interrompe(controle_t *self)
+{
+  irq_t irq;
+  if (!controlador_int_proxima(self->ci, &irq)) return;
+  if (cpu_interrompe(self->cpu, irq)) {
+    controlador_int_aceita(self->ci, irq);
+  }
+}
+
+// faz passar 'n' unidades de tempo nos dispositivos
+static void controle_avanca_tempo(controle_t *self, int n)
+{
+  relogio_avanca(self->relogio, n);
+  disco_avanca(self->disco, n);
+}
+
+// chamada pela CPU antes de uma instrução de E/S, quando 'n' instruções do
+//   lote já foram executadas: faz passar o tempo delas que os dispositivos
+//   ainda não viram, para a instrução ver a hora certa
+// não passa de evento nenhum, porque o lote não vai além do próximo
+static void controle_sincroniza(void *arg, int n)
+{
+  controle_t *self = arg;
+  controle_avanca_tempo(self, n - self->avancado_no_lote);
+  self->avancado_no_lote = n;
+}
+
+// retorna true se a CPU está parada e não tem mais como receber interrupção
+//   (nenhum dispositivo tem evento previsto), ou seja, a simulação acabou
+static bool controle_maquina_morta(controle_t *self)
+{
+  if (!cpu_parada(self->cpu)) return false;
+  return controle_proximo_evento(self) == -1 && !controle_tem_interrupcao(self);
+}
+
+// decide se a console deve ser atendida, depois de executar 'n' instruções
+// fora do modo em lote ou se não está executando, sempre
+static bool controle_hora_de_atender_console(controle_t *self, int n)
+{
+  if (self->estado != executando) return true;
+  self->instrucoes_desde_console += n;
+  if (self->instrucoes_desde_console >= self->intervalo_console) return true;
+  if (self->intervalo_console_ms > 0) {
+    self->instrucoes_desde_hora += n;
+    if (self->instrucoes_desde_hora >= INSTRUCOES_ENTRE_CONSULTAS_A_HORA) {
+      self->instrucoes_desde_hora = 0;
+      if (agora_ms() >= self->proximo_atendimento_ms) return true;
+    }
+  }
+  return false;
+}
+
+// calcula quantas instruções podem ser executadas de uma vez, sem passar
+//   do momento de atender a console, do próximo evento de E/S ou do limite
+static int controle_tamanho_do_lote(controle_t *self)
+{
+  int max = self->intervalo_console - self->instrucoes_desde_console;
+  // se tem interrupção que não pôde ser aceita, tem que tentar de novo depois
+  //   de cada instrução
+  if (controle_tem_interrupcao(self)) return 1;
+  int evento = controle_proximo_evento(self);
+  if (evento != -1) {
+    int t_ate_evento = evento - relogio_agora(self->relogio);
+    if (t_ate_evento < max) max = t_ate_evento;
+  }
+  if (self->limite_instrucoes > 0
+      && self->limite_instrucoes - self->instrucoes < max) {
+    max = self->limite_instrucoes - self->instrucoes;
+  }
+  if (max < 1) max = 1;
+  return max;
+}
+
+// com a CPU parada, nada acontece até a próxima interrupção; em vez de passar
+//   o tempo de um em um, pula direto para o próximo evento (sem passar do
+//   limite de execução)
+// retorna o número de unidades de tempo puladas
+static int controle_pula_tempo_ocioso(controle_t *self)
+{
+  int n = 1;
+  int evento = controle_proximo_evento(self);
+  if (evento != -1 && !controle_tem_interrupcao(self)) {
+    n = evento - relogio_agora(self->relogio);
+    if (n < 1) n = 1;
+  }
+  if (self->limite_instrucoes > 0
+      && self->limite_instrucoes - self->instrucoes < n) {
+    n = self->limite_instrucoes - self->instrucoes;
+    if (n < 1) n = 1;
+  }
+  controle_avanca_tempo(self, n);
+  self->tempo_pulado += n;
+  return n;
+}
+
+// executa um lote de instruções (ou uma só, se for passo a passo)
+// retorna o número de unidades de tempo que passaram
+static int controle_executa(controle_t *self)
+{
+  if (self->estado == passo) {
+    cpu_executa_1(self->cpu);
+    controle_avanca_tempo(self, 1);
+    return 1;
+  }
+  if (cpu_parada(self->cpu)) {
+    return controle_pula_tempo_ocioso(self);
+  }
+  self->avancado_no_lote = 0;
+  int n = cpu_executa_n(self->cpu, controle_tamanho_do_lote(self));
+  controle_avanca_tempo(self, n - self->avancado_no_lote);
+  return n;
+}
+
+static void controle_atende_console(controle_t *self)
+{
+  self->instrucoes_desde_console = 0;
+  if (self->intervalo_console_ms > 0) {
+    self->proximo_atendimento_ms = agora_ms() + self->intervalo_console_ms;
+  }
+  console_tictac(self->console);
+
+  controle_processa_comandos_da_console(self);
+  controle_atualiza_estado_na_console(self);
+}
+
 void controle_laco(controle_t *self)
 {
-  // executa uma instrução por vez até a console dizer que chega
+  long inicio_ms = agora_ms();
+  // executa lotes de instruções até a console dizer que chega
   do {
+    int n = 0;
     if (self->estado == passo || self->estado == executando) {
-      cpu_executa_1(self->cpu);
-      relogio_tictac(self->relogio);
+      n = controle_executa(self);
+      self->instrucoes += n;
 
       if (self->estado == passo) self->estado = parado;
 
-      // enquanto não tem controlador de interrupção, fala direto com o relógio
-      // o dispositivo 3 do relógio contém 1 se o timer expirou
-      int tem_int;
-      relogio_leitura(self->relogio, 3, &tem_int);
-      if (tem_int != 0) {
-        cpu_interrompe(self->cpu, IRQ_RELOGIO);
+      controle_interrompe(self);
+
+      if (self->em_lote) {
+        if (controle_maquina_morta(self)) self->estado = fim;
+        if (self->limite_instrucoes > 0
+            && self->instrucoes >= self->limite_instrucoes) {
+          self->estado = fim;
+        }
+      }
+    }
+    if (controle_hora_de_atender_console(self, n)) {
+      controle_atende_console(self);
+      // parado, não tem o que simular até chegar um comando
+      if (self->estado == parado) {
+        nanosleep(&(struct timespec){ .tv_nsec = ESPERA_PARADO_MS * 1000000L }, NULL);
       }
     }
-    console_tictac(self->console);
-
-    controle_processa_comandos_da_console(self);
-    controle_atualiza_estado_na_console(self);
   } while (self->estado != fim);
 
+  long acertos, faltas;
+  cpu_estatisticas_decod(self->cpu, &acertos, &faltas);
+  double taxa = 100.0 * acertos / (acertos + faltas > 0 ? acertos + faltas : 1);
   console_printf("Fim da execução.");
   console_printf("relógio: %d\n", relogio_agora(self->relogio));
+  console_printf("cache de decodificação: %ld acertos, %ld faltas (%.2f%%)",
+                 acertos, faltas, taxa);
+  if (self->em_lote) {
+    long duracao_ms = agora_ms() - inicio_ms;
+    fprintf(stderr, "instruções: %ld (%ld pulados com a CPU parada)"
+            "  tempo: %ld ms  instruções/s: %.0f\n",
+            self->instrucoes, self->tempo_pulado, duracao_ms,
+            self->instrucoes * 1000.0 / (duracao_ms > 0 ? duracao_ms : 1));
+    fprintf(stderr, "cache de decodificação: %ld acertos, %ld faltas (%.2f%%)\n",
+            acertos, faltas, taxa);
+  }
 }
  
 
@@ -88,8 +347,20 @@ static void controle_processa_comandos_da_console(controle_t *self)
   }
 }
 
+// a descrição da CPU muda a cada instrução, mas só é montada quando a tela vai
+//   poder mostrar (ver CONSOLE_QUADROS_POR_SEGUNDO), ou quando o estado do
+//   controle muda
 static void controle_atualiza_estado_na_console(controle_t *self)
 {
+  // sem tela, ninguém vai ver o estado
+  if (self->em_lote) return;
+  long agora = agora_ms();
+  if (self->estado == self->estado_no_status
+      && agora < self->proximo_status_ms) {
+    return;
+  }
+  self->estado_no_status = self->estado;
+  self->proximo_status_ms = agora + 1000 / CONSOLE_QUADROS_POR_SEGUNDO;
   char status[100];
   switch (self->estado) {
     case fim:        strcpy(status, "FIM    | "); break;
@@ -11,10 +11,34 @@ typedef struct controle_t controle_t;
 #include "cpu.h"
 #include "console.h"
 #include "relogio.h"
+#include "disco.h"
+#include "controlador_int.h"
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio);
+// as interrupções dos dispositivos chegam à CPU através de 'ci'; o relógio
+//   e o disco são usados para saber quando vai acontecer o próximo evento
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          disco_t *disco, controlador_int_t *ci);
 void controle_destroi(controle_t *self);
 
+// coloca o controlador em modo de execução em lote (sem tela)
+// a execução inicia sem esperar comando, e a console só é atendida a cada
+//   'intervalo' instruções ou a cada 'intervalo_ms' milisegundos de tempo
+//   real (0 para não considerar o tempo real)
+// a simulação termina sozinha quando a CPU estiver parada sem ter mais
+//   interrupção que possa acordá-la, ou depois de executar 'limite'
+//   instruções (0 para não ter limite)
+void controle_define_lote(controle_t *self, int intervalo, int intervalo_ms,
+                          long limite);
+
+// grava no arquivo o estado do controlador (número de instruções executadas
+//   e tempo pulado), ou lê o estado gravado (ver estado.h)
+// o modo de execução e o limite de instruções não fazem parte do estado; o
+//   limite continua valendo para o total de instruções, contando as
+//   executadas antes da gravação
+// retornam false em caso de erro
+bool controle_grava_estado(controle_t *self, FILE *arq);
+bool controle_le_estado(controle_t *self, FILE *arq);
+
 // o laço principal da simulação
 void controle_laco(controle_t *self);
 
@@ -7,6 +7,8 @@
 #include "cpu.h"
 #include "err.h"
 #include "instrucao.h"
+#include "perfil.h"
+#include "estado.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -15,6 +17,22 @@
 #include <assert.h>
 
 // DECLARAÇÃO {{{1
+
+// função que implementa uma instrução
+typedef void (*operacao_t)(cpu_t *self);
+
+// uma instrução já decodificada, na cache de decodificação
+// a cache tem uma entrada por endereço físico da memória, que é preenchida na
+//   primeira execução da instrução nesse endereço e invalidada quando a
+//   memória é alterada nesse endereço ou no seguinte (onde está o argumento)
+typedef struct {
+  // função que implementa a instrução; NULL se a entrada é inválida
+  operacao_t op;
+  int opcode;
+  // argumento da instrução (se ela tiver)
+  int A1;
+} instr_decod_t;
+
 // uma CPU tem estado, memória, controlador de ES
 struct cpu_t {
   // registradores
@@ -33,8 +51,30 @@ struct cpu_t {
   // função e argumento para implementar instrução CHAMAC
   func_chamaC_t funcaoC;
   void *argC;
+  // cache de decodificação, indexada por endereço físico
+  instr_decod_t *decod;
+  int tam_decod;
+  // instrução decodificada em execução (NULL se não tem; ver pega_A1)
+  instr_decod_t *decod_corrente;
+  // se cpu_executa_n deve parar depois da instrução corrente (foi aceita
+  //   uma interrupção ou a instrução fez E/S)
+  bool termina_lote;
+  // função e argumento para avisar quantas instruções do lote já foram
+  //   executadas, antes de uma instrução de E/S
+  func_sincroniza_t funcao_sincroniza;
+  void *arg_sincroniza;
+  // estatísticas da cache de decodificação
+  long decod_acertos;
+  long decod_faltas;
+  // recebe cada instrução executada; NULL se não tiver
+  perfil_t *perfil;
 };
 
+static void cpu_invalida_decod(void *arg, int endereco);
+
+// a tabela com a função de cada instrução (está mais para o final)
+static operacao_t operacoes[N_OPCODE];
+
 // CRIAÇÃO {{{1
 cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
 {
@@ -52,6 +92,7 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
   self->complemento = 0;
   self->modo = usuario;
   self->funcaoC = NULL;
+  self->funcao_sincroniza = NULL;
   // inicializa instruções privilegiadas
   memset(self->privilegiadas, 0, sizeof(self->privilegiadas));
   self->privilegiadas[PARA] = true;
@@ -59,6 +100,17 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
   self->privilegiadas[ESCR] = true;
   self->privilegiadas[RETI] = true;
   self->privilegiadas[CHAMAC] = true;
+  // inicializa a cache de decodificação, vazia
+  mem_t *mem = mmu_mem(mmu);
+  self->tam_decod = mem_tam(mem);
+  self->decod = calloc(self->tam_decod, sizeof(*self->decod));
+  assert(self->decod != NULL);
+  self->decod_corrente = NULL;
+  self->termina_lote = false;
+  self->decod_acertos = 0;
+  self->decod_faltas = 0;
+  self->perfil = NULL;
+  mem_define_aviso_escrita(mem, cpu_invalida_decod, self);
   // gera uma interrupção de reset, para o SO poder executar
   cpu_interrompe(self, IRQ_RESET);
 
@@ -68,6 +120,8 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
 void cpu_destroi(cpu_t *self)
 {
   // eu nao criei MMU nem es; quem criou que destrua!
+  mem_define_aviso_escrita(mmu_mem(self->mmu), NULL, NULL);
+  free(self->decod);
   free(self);
 }
 
@@ -77,6 +131,25 @@ void cpu_define_chamaC(cpu_t *self, func_chamaC_t funcaoC, void *argC)
   self->argC = argC;
 }
 
+void cpu_define_sincronizacao(cpu_t *self, func_sincroniza_t func, void *arg)
+{
+  self->funcao_sincroniza = func;
+  self->arg_sincroniza = arg;
+}
+
+// avisa que 'n' instruções do lote em execução já foram executadas
+static void cpu_sincroniza(cpu_t *self, int n)
+{
+  if (self->funcao_sincroniza != NULL) {
+    self->funcao_sincroniza(self->arg_sincroniza, n);
+  }
+}
+
+void cpu_define_perfil(cpu_t *self, perfil_t *perfil)
+{
+  self->perfil = perfil;
+}
+
 // IMPRESSÃO {{{1
 static void imprime_registradores(cpu_t *self, char *str)
 {
@@ -148,6 +221,11 @@ static bool pega_opcode(cpu_t *self, int *popc)
   // não tem que testar endereços, é tarefa da mmu
   // não pode executar se houver erro na leitura da memória
   if (!pega_mem(self, self->PC, popc)) return false;
+  // não pode executar o que não é instrução
+  if (*popc < 0 || *popc >= N_OPCODE || operacoes[*popc] == NULL) {
+    self->erro = ERR_INSTR_INV;
+    return false;
+  }
   // pode executar se tiver privilégio para isso
   if (self->modo == supervisor || !self->privilegiadas[*popc]) return true;
   // não pode executar instrução privilegiada em modo usuário
@@ -156,8 +234,13 @@ static bool pega_opcode(cpu_t *self, int *popc)
 }
 
 // lê o argumento 1 da instrução no PC
+// se a instrução veio da cache de decodificação, o argumento já está lá
 static bool pega_A1(cpu_t *self, int *pA1)
 {
+  if (self->decod_corrente != NULL) {
+    *pA1 = self->decod_corrente->A1;
+    return true;
+  }
   return pega_mem(self, self->PC + 1, pA1);
 }
 
@@ -382,6 +465,7 @@ static void op_RET(cpu_t *self) // retorno de subrotina
 static void op_LE(cpu_t *self) // leitura de E/S
 {
   int A1, dado;
+  self->termina_lote = true;
   if (pega_A1(self, &A1) && pega_es(self, A1, &dado)) {
     self->A = dado;
     self->PC += 2;
@@ -391,6 +475,7 @@ static void op_LE(cpu_t *self) // leitura de E/S
 static void op_ESCR(cpu_t *self) // escrita de E/S
 {
   int A1;
+  self->termina_lote = true;
   if (pega_A1(self, &A1) && poe_es(self, A1, self->A)) {
     self->PC += 2;
   }
@@ -406,6 +491,7 @@ static void op_RETI(cpu_t *self) // retorno de interrupção
 
 static void op_CHAMAC(cpu_t *self) // chama função em C
 {
+  self->termina_lote = true;
   if (self->funcaoC == NULL) {
     self->erro = ERR_OP_INV;
     return;
@@ -424,38 +510,114 @@ static void op_CHAMAS(cpu_t *self) // chamada de sistema
 
 // EXECUTA UMA INSTRUÇÃO {{{1
 
-static void executa_a_instrucao(cpu_t *self, int opcode)
-{
-  switch (opcode) {
-    case NOP:    op_NOP(self);    break;
-    case PARA:   op_PARA(self);   break;
-    case CARGI:  op_CARGI(self);  break;
-    case CARGM:  op_CARGM(self);  break;
-    case CARGX:  op_CARGX(self);  break;
-    case ARMM:   op_ARMM(self);   break;
-    case ARMX:   op_ARMX(self);   break;
-    case TRAX:   op_TRAX(self);   break;
-    case CPXA:   op_CPXA(self);   break;
-    case INCX:   op_INCX(self);   break;
-    case SOMA:   op_SOMA(self);   break;
-    case SUB:    op_SUB(self);    break;
-    case MULT:   op_MULT(self);   break;
-    case DIV:    op_DIV(self);    break;
-    case RESTO:  op_RESTO(self);  break;
-    case NEG:    op_NEG(self);    break;
-    case DESV:   op_DESV(self);   break;
-    case DESVZ:  op_DESVZ(self);  break;
-    case DESVNZ: op_DESVNZ(self); break;
-    case DESVN:  op_DESVN(self);  break;
-    case DESVP:  op_DESVP(self);  break;
-    case CHAMA:  op_CHAMA(self);  break;
-    case RET:    op_RET(self);    break;
-    case LE:     op_LE(self);     break;
-    case ESCR:   op_ESCR(self);   break;
-    case RETI:   op_RETI(self);   break;
-    case CHAMAC: op_CHAMAC(self); break;
-    case CHAMAS: op_CHAMAS(self); break;
-    default:     self->erro = ERR_INSTR_INV;
+// função que implementa cada instrução; NULL para opcodes inválidos
+static operacao_t operacoes[N_OPCODE] = {
+  [NOP]    = op_NOP,
+  [PARA]   = op_PARA,
+  [CARGI]  = op_CARGI,
+  [CARGM]  = op_CARGM,
+  [CARGX]  = op_CARGX,
+  [ARMM]   = op_ARMM,
+  [ARMX]   = op_ARMX,
+  [TRAX]   = op_TRAX,
+  [CPXA]   = op_CPXA,
+  [INCX]   = op_INCX,
+  [SOMA]   = op_SOMA,
+  [SUB]    = op_SUB,
+  [MULT]   = op_MULT,
+  [DIV]    = op_DIV,
+  [RESTO]  = op_RESTO,
+  [NEG]    = op_NEG,
+  [DESV]   = op_DESV,
+  [DESVZ]  = op_DESVZ,
+  [DESVNZ] = op_DESVNZ,
+  [DESVN]  = op_DESVN,
+  [DESVP]  = op_DESVP,
+  [CHAMA]  = op_CHAMA,
+  [RET]    = op_RET,
+  [LE]     = op_LE,
+  [ESCR]   = op_ESCR,
+  [RETI]   = op_RETI,
+  [CHAMAC] = op_CHAMAC,
+  [CHAMAS] = op_CHAMAS,
+};
+
+// chamada pela memória quando o endereço físico 'endereco' é alterado
+// invalida a instrução que começa nesse endereço e a que começa no anterior
+//   (que pode ter o argumento nesse endereço)
+static void cpu_invalida_decod(void *arg, int endereco)
+{
+  cpu_t *self = arg;
+  if (endereco < self->tam_decod) self->decod[endereco].op = NULL;
+  if (endereco > 0) self->decod[endereco - 1].op = NULL;
+}
+
+// decodifica a instrução no PC, que está no endereço físico 'endfis', e
+//   coloca na entrada correspondente da cache
+// retorna a entrada, ou NULL se a instrução não pode ser executada (o erro
+//   já está na CPU) ou não pode ser colocada na cache (o opcode fica em
+//   '*popc', para a instrução ser executada sem a cache)
+static instr_decod_t *cpu_decodifica(cpu_t *self, int endfis, int *popc)
+{
+  if (!pega_opcode(self, popc)) return NULL;
+  int opcode = *popc;
+  int A1 = 0;
+  if (instrucao_num_args(opcode) > 0) {
+    // uma instrução que atravessa uma fronteira de página não vai para a
+    //   cache: a página do argumento pode ser trocada sem alterar a memória
+    //   no endereço físico da instrução
+    if ((self->PC + 1) % mmu_tam_pagina(self->mmu) == 0) return NULL;
+    // se não conseguir ler o argumento, deixa a instrução descobrir o erro
+    if (mmu_le(self->mmu, self->PC + 1, &A1, self->modo) != ERR_OK) return NULL;
+  }
+  instr_decod_t *decod = &self->decod[endfis];
+  decod->opcode = opcode;
+  decod->A1 = A1;
+  decod->op = operacoes[opcode];
+  return decod;
+}
+
+// busca a instrução no PC, da cache ou da memória
+// retorna a instrução decodificada ou NULL em caso de erro ou se a instrução
+//   não pode ser colocada na cache -- nesse caso, se a CPU não estiver em erro,
+//   o opcode está em '*popc' e a instrução deve ser executada sem a cache
+static instr_decod_t *cpu_busca_instrucao(cpu_t *self, int *popc)
+{
+  int endfis;
+  self->erro = mmu_traduz(self->mmu, self->PC, &endfis, self->modo);
+  if (self->erro != ERR_OK) {
+    self->complemento = self->PC;
+    return NULL;
+  }
+  // endereço físico fora da memória, deixa a leitura normal gerar o erro
+  if (endfis < 0 || endfis >= self->tam_decod) {
+    pega_opcode(self, popc);
+    return NULL;
+  }
+  instr_decod_t *decod = &self->decod[endfis];
+  if (decod->op != NULL) {
+    self->decod_acertos++;
+    // pode executar se tiver privilégio para isso
+    if (self->modo == usuario && self->privilegiadas[decod->opcode]) {
+      self->erro = ERR_INSTR_PRIV;
+      return NULL;
+    }
+    return decod;
+  }
+  self->decod_faltas++;
+  return cpu_decodifica(self, endfis, popc);
+}
+
+// se a CPU entrou em erro, causa uma interrupção
+// a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
+//   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
+//   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
+//   até que venha uma interrupção de E/S
+static void cpu_verifica_erro(cpu_t *self)
+{
+  if (self->erro != ERR_OK && self->erro != ERR_CPU_PARADA) {
+    // se a interrupção não é aceita nesse ponto, temos um problema grave...
+    assert(cpu_interrompe(self, IRQ_ERR_CPU));
   }
 }
 
@@ -464,20 +626,149 @@ void cpu_executa_1(cpu_t *self)
   // não executa se CPU já estiver em erro
   if (self->erro != ERR_OK) return;
 
-  int opcode;
-  if (pega_opcode(self, &opcode)) {
-    executa_a_instrucao(self, opcode);
+  int pc = self->PC;
+  cpu_modo_t modo = self->modo;
+  int opcode = -1;
+  instr_decod_t *decod = cpu_busca_instrucao(self, &opcode);
+  if (decod != NULL) {
+    opcode = decod->opcode;
+    self->decod_corrente = decod;
+    decod->op(self);
+    self->decod_corrente = NULL;
+  } else if (self->erro == ERR_OK) {
+    // instrução fora da cache
+    operacoes[opcode](self);
+  } else if (self->erro != ERR_PAG_AUSENTE) {
+    // a instrução não pode ser executada
+    opcode = -1;
   }
 
-  // se a CPU entrou em erro, causa uma interrupção
-  // a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
-  //   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
-  //   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
-  //   até que venha uma interrupção de E/S
-  if (self->erro != ERR_OK && self->erro != ERR_CPU_PARADA) {
-    // se a interrupção não é aceita nesse ponto, temos um problema grave...
-    assert(cpu_interrompe(self, IRQ_ERR_CPU));
+  // antes de cpu_verifica_erro, que limpa o erro se aceitar a interrupção
+  if (self->perfil != NULL) {
+    perfil_instrucao(self->perfil, pc, modo, opcode, self->erro, self->PC);
+  }
+
+  cpu_verifica_erro(self);
+}
+
+// EXECUTA VÁRIAS INSTRUÇÕES {{{1
+
+// com gcc (e clang), usa "computed goto": cada instrução desvia diretamente
+//   para o código da próxima (código "threaded"), o que é bem mais amigável
+//   ao preditor de desvios do hospedeiro que um switch em um laço, porque
+//   cada instrução tem seu próprio desvio indireto
+// sem, usa um switch normal
+#if defined(__GNUC__) && !defined(CPU_SEM_ROTULOS)
+#define CPU_DESPACHO_POR_ROTULOS
+#endif
+
+// a lista das instruções, para gerar a tabela de rótulos e os casos do switch
+// as que fazem E/S (ES) precisam que os dispositivos estejam na hora certa
+#define INSTRUCOES(X, ES) \
+  X(NOP)   X(PARA)  X(CARGI)  X(CARGM)  X(CARGX) X(ARMM)  X(ARMX) \
+  X(TRAX)  X(CPXA)  X(INCX)   X(SOMA)   X(SUB)   X(MULT)  X(DIV)  \
+  X(RESTO) X(NEG)   X(DESV)   X(DESVZ)  X(DESVNZ) X(DESVN) X(DESVP) \
+  X(CHAMA) X(RET)   ES(LE)    ES(ESCR)  X(RETI)  ES(CHAMAC) X(CHAMAS)
+
+// retorna true se a instrução faz E/S (acessa dispositivos, direto ou pelo SO)
+static bool instrucao_faz_es(int opcode)
+{
+  return opcode == LE || opcode == ESCR || opcode == CHAMAC;
+}
+
+// versão de cpu_executa_n usada com perfilador: executa uma instrução por
+//   vez com cpu_executa_1, que informa o perfilador
+static int cpu_executa_n_perfil(cpu_t *self, int max)
+{
+  int n = 0;
+  self->termina_lote = false;
+  while (n < max && self->erro == ERR_OK && !self->termina_lote) {
+    cpu_sincroniza(self, n);
+    n++;
+    cpu_executa_1(self);
+  }
+  return n;
+}
+
+int cpu_executa_n(cpu_t *self, int max)
+{
+  // o laço abaixo não informa o perfilador, para não ter custo sem ele
+  if (self->perfil != NULL) return cpu_executa_n_perfil(self, max);
+
+  int n = 0;
+  int opcode;
+  instr_decod_t *decod;
+  self->termina_lote = false;
+
+// busca a próxima instrução, ou termina o lote
+// instruções fora da cache são executadas em 'fora_da_cache'
+#define BUSCA() \
+  if (n >= max || self->erro != ERR_OK || self->termina_lote) goto fim; \
+  n++; \
+  decod = cpu_busca_instrucao(self, &opcode); \
+  if (decod == NULL) goto fora_da_cache; \
+  self->decod_corrente = decod
+
+#ifdef CPU_DESPACHO_POR_ROTULOS
+#define ROTULO(nome) [nome] = &&exec_##nome,
+#define DESPACHA() BUSCA(); goto *rotulos[decod->opcode]
+#define EXECUTA(nome) \
+  exec_##nome: \
+    op_##nome(self); \
+    self->decod_corrente = NULL; \
+    cpu_verifica_erro(self); \
+    DESPACHA();
+#define EXECUTA_ES(nome) \
+  exec_##nome: \
+    cpu_sincroniza(self, n - 1); \
+    op_##nome(self); \
+    self->decod_corrente = NULL; \
+    cpu_verifica_erro(self); \
+    DESPACHA();
+
+  static void *rotulos[N_OPCODE] = { INSTRUCOES(ROTULO, ROTULO) };
+
+  DESPACHA();
+  INSTRUCOES(EXECUTA, EXECUTA_ES)
+#else
+#define CASO(nome) case nome: op_##nome(self); break;
+#define CASO_ES(nome) case nome: cpu_sincroniza(self, n - 1); op_##nome(self); break;
+#define DESPACHA() goto proxima
+
+proxima:
+  BUSCA();
+  switch (decod->opcode) {
+    INSTRUCOES(CASO, CASO_ES)
+  }
+  self->decod_corrente = NULL;
+  cpu_verifica_erro(self);
+  DESPACHA();
+#endif
+
+fora_da_cache:
+  if (self->erro == ERR_OK) {
+    if (instrucao_faz_es(opcode)) cpu_sincroniza(self, n - 1);
+    operacoes[opcode](self);
   }
+  cpu_verifica_erro(self);
+  DESPACHA();
+
+fim:
+  return n;
+}
+
+#undef BUSCA
+#undef DESPACHA
+
+void cpu_estatisticas_decod(cpu_t *self, long *pacertos, long *pfaltas)
+{
+  *pacertos = self->decod_acertos;
+  *pfaltas = self->decod_faltas;
+}
+
+bool cpu_parada(cpu_t *self)
+{
+  return self->erro == ERR_CPU_PARADA;
 }
 
 // INTERRUPÇÃO {{{1
@@ -512,6 +803,7 @@ bool cpu_interrompe(cpu_t *self, irq_t irq)
   self->PC = IRQ_END_TRATADOR;
   self->A = irq;
   self->erro = ERR_OK;
+  self->termina_lote = true;
 
   return true;
 }
@@ -537,4 +829,81 @@ static void cpu_desinterrompe(cpu_t *self)
   self->erro = erro;
 }
 
+// CHECKPOINT {{{1
+
+// a cache de decodificação é gravada como o número de entradas válidas
+//   seguido de endereço, opcode e argumento de cada uma; a função da
+//   instrução é obtida de novo do opcode na leitura
+static bool cpu_grava_decod(cpu_t *self, FILE *arq)
+{
+  int n = 0;
+  for (int i = 0; i < self->tam_decod; i++) {
+    if (self->decod[i].op != NULL) n++;
+  }
+  if (!ESTADO_GRAVA(arq, n)) return false;
+  for (int i = 0; i < self->tam_decod; i++) {
+    instr_decod_t *d = &self->decod[i];
+    if (d->op == NULL) continue;
+    if (!ESTADO_GRAVA(arq, i) || !ESTADO_GRAVA(arq, d->opcode)
+        || !ESTADO_GRAVA(arq, d->A1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool cpu_le_decod(cpu_t *self, FILE *arq)
+{
+  memset(self->decod, 0, self->tam_decod * sizeof(*self->decod));
+  int n;
+  if (!ESTADO_LE(arq, n)) return false;
+  for (int k = 0; k < n; k++) {
+    int i, opcode, A1;
+    if (!ESTADO_LE(arq, i) || !ESTADO_LE(arq, opcode) || !ESTADO_LE(arq, A1)
+        || i < 0 || i >= self->tam_decod || opcode < 0 || opcode >= N_OPCODE) {
+      return false;
+    }
+    self->decod[i].op = operacoes[opcode];
+    self->decod[i].opcode = opcode;
+    self->decod[i].A1 = A1;
+  }
+  return true;
+}
+
+bool cpu_grava_estado(cpu_t *self, FILE *arq)
+{
+  int erro = self->erro;
+  int modo = self->modo;
+  return ESTADO_GRAVA(arq, self->PC)
+      && ESTADO_GRAVA(arq, self->A)
+      && ESTADO_GRAVA(arq, self->X)
+      && ESTADO_GRAVA(arq, erro)
+      && ESTADO_GRAVA(arq, self->complemento)
+      && ESTADO_GRAVA(arq, modo)
+      && ESTADO_GRAVA(arq, self->decod_acertos)
+      && ESTADO_GRAVA(arq, self->decod_faltas)
+      && cpu_grava_decod(self, arq);
+}
+
+bool cpu_le_estado(cpu_t *self, FILE *arq)
+{
+  int erro, modo;
+  if (!ESTADO_LE(arq, self->PC)
+      || !ESTADO_LE(arq, self->A)
+      || !ESTADO_LE(arq, self->X)
+      || !ESTADO_LE(arq, erro)
+      || !ESTADO_LE(arq, self->complemento)
+      || !ESTADO_LE(arq, modo)
+      || !ESTADO_LE(arq, self->decod_acertos)
+      || !ESTADO_LE(arq, self->decod_faltas)
+      || !cpu_le_decod(self, arq)) {
+    return false;
+  }
+  self->erro = erro;
+  self->modo = modo;
+  self->decod_corrente = NULL;
+  self->termina_lote = false;
+  return true;
+}
+
 // vim: foldmethod=marker
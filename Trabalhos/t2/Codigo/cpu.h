@@ -15,10 +15,17 @@ typedef enum { supervisor, usuario } cpu_modo_t;
 #include "err.h"
 #include "irq.h"
 #include "mmu.h"
+#include <stdio.h>
+
+typedef struct perfil_t perfil_t;
 
 // tipo da função a ser chamada quando executar a instrução CHAMAC
 typedef int (*func_chamaC_t)(void *argC, int reg_A);
 
+// tipo da função chamada por cpu_executa_n antes de uma instrução de E/S,
+//   com o número de instruções do lote já executadas
+typedef void (*func_sincroniza_t)(void *arg, int n);
+
 
 // cria uma unidade de execução com acesso à MMU e ao
 //   controlador de E/S fornecidos
@@ -33,6 +40,19 @@ void cpu_destroi(cpu_t *self);
 //     e causa uma interrupção
 void cpu_executa_1(cpu_t *self);
 
+// executa até 'max' instruções, como se fossem várias chamadas a
+//   cpu_executa_1, mas sem voltar ao controlador entre elas
+// para antes se a CPU aceitar uma interrupção (chamada de sistema ou erro) ou
+//   parar (instrução PARA); não executa nada se a CPU já estiver em erro
+// o controlador usa 'max' para não passar do instante em que o relógio ou a
+//   console devem ser atendidos
+// também para depois de uma instrução que faz E/S (LE, ESCR ou CHAMAC), que
+//   pode programar um evento que o controlador tem que levar em conta
+// antes de executar uma instrução de E/S, informa a função definida com
+//   cpu_define_sincronizacao, para os dispositivos verem a hora certa
+// retorna o número de instruções executadas (incluindo a que causou erro)
+int cpu_executa_n(cpu_t *self, int max);
+
 // implementa uma interrupção
 // passa para modo supervisor, salva o estado da CPU no início da memória,
 //   altera A para identificar a requisição de interrupção, altera PC para
@@ -40,10 +60,36 @@ void cpu_executa_1(cpu_t *self);
 // retorna true se interrupção foi aceita ou false caso contrário
 bool cpu_interrompe(cpu_t *self, irq_t irq);
 
+// retorna true se a CPU está parada (executou PARA em modo supervisor), e
+//   só volta a executar se receber uma interrupção
+bool cpu_parada(cpu_t *self);
+
 // define a função a chamar quando executar a instrução CHAMAC
 // e o argumento a passar para ela (normalmente, um ponteiro para o SO)
 void cpu_define_chamaC(cpu_t *self, func_chamaC_t func, void *argC);
 
+// define a função a chamar em cpu_executa_n antes de uma instrução de E/S
+//   e o argumento a passar para ela (normalmente, o controlador, que faz o
+//   tempo das instruções já executadas no lote passar nos dispositivos)
+void cpu_define_sincronizacao(cpu_t *self, func_sincroniza_t func, void *arg);
+
+// define o perfilador que recebe cada instrução executada (NULL para não ter)
+// com perfilador, cpu_executa_n executa uma instrução por vez, como
+//   cpu_executa_1; sem, o custo é um teste por chamada a cpu_executa_n e
+//   por instrução em cpu_executa_1
+void cpu_define_perfil(cpu_t *self, perfil_t *perfil);
+
+// coloca em '*pacertos' e '*pfaltas' o número de acertos e faltas na cache
+//   de instruções decodificadas
+void cpu_estatisticas_decod(cpu_t *self, long *pacertos, long *pfaltas);
+
+// grava no arquivo o estado da CPU (registradores, erro, modo e cache de
+//   decodificação), ou lê o estado gravado (ver estado.h)
+// a memória já deve estar restaurada quando a CPU for lida
+// retornam false em caso de erro
+bool cpu_grava_estado(cpu_t *self, FILE *arq);
+bool cpu_le_estado(cpu_t *self, FILE *arq);
+
 // concatena a descrição do estado da CPU no final de str
 void cpu_concatena_descricao(cpu_t *self, char *str);
 
@@ -0,0 +1,234 @@
+// disco.c
+// dispositivo de E/S de memória secundária (disco)
+// simulador de computador
+// so24b
+
+#include "disco.h"
+#include "estado.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+struct disco_t {
+  // conteúdo do disco
+  int *dados;
+  // true se o conteúdo é um arquivo mapeado (disco_mapeia_imagem)
+  bool mapeado;
+  // memória principal, para as transferências
+  mem_t *mem;
+  // latência
+  int tempo_busca;
+  int tempo_palavra;
+  // registradores do dispositivo
+  int end_disco;
+  int end_mem;
+  int quant;
+  // transferência em andamento: comando (0 se livre), endereços e quanto
+  //   tempo falta para terminar
+  int comando;
+  int transf_disco;
+  int transf_mem;
+  int transf_quant;
+  int t_ate_fim;
+  // onde a cabeça ficou depois da última transferência
+  int cabeca;
+  // 1 se está gerando interrupção, 0 se não
+  int interrupcao;
+};
+
+disco_t *disco_cria(mem_t *mem)
+{
+  disco_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->dados = calloc(DISCO_TAM, sizeof(*self->dados));
+  assert(self->dados != NULL);
+  self->mapeado = false;
+  self->mem = mem;
+  self->tempo_busca = DISCO_TEMPO_BUSCA;
+  self->tempo_palavra = DISCO_TEMPO_PALAVRA;
+  self->end_disco = 0;
+  self->end_mem = 0;
+  self->quant = 0;
+  self->comando = 0;
+  self->t_ate_fim = 0;
+  self->cabeca = 0;
+  self->interrupcao = 0;
+  return self;
+}
+
+void disco_destroi(disco_t *self)
+{
+  if (self->mapeado) {
+    munmap(self->dados, DISCO_TAM * sizeof(*self->dados));
+  } else {
+    free(self->dados);
+  }
+  free(self);
+}
+
+void disco_define_latencia(disco_t *self, int tempo_busca, int tempo_palavra)
+{
+  self->tempo_busca = tempo_busca;
+  self->tempo_palavra = tempo_palavra;
+}
+
+// realiza a cópia da transferência em andamento, que terminou
+static void disco_termina_transferencia(disco_t *self)
+{
+  for (int i = 0; i < self->transf_quant; i++) {
+    int *pdisco = &self->dados[self->transf_disco + i];
+    if (self->comando == DISCO_CMD_LE) {
+      mem_escreve(self->mem, self->transf_mem + i, *pdisco);
+    } else {
+      mem_le(self->mem, self->transf_mem + i, pdisco);
+    }
+  }
+  self->cabeca = self->transf_disco + self->transf_quant;
+  self->comando = 0;
+  self->interrupcao = 1;
+}
+
+void disco_avanca(disco_t *self, int n)
+{
+  if (self->comando == 0) return;
+  if (n >= self->t_ate_fim) {
+    disco_termina_transferencia(self);
+  } else {
+    self->t_ate_fim -= n;
+  }
+}
+
+int disco_tempo_ate_evento(disco_t *self)
+{
+  if (self->comando == 0) return -1;
+  return self->t_ate_fim;
+}
+
+bool disco_tem_interrupcao(void *disp)
+{
+  disco_t *self = disp;
+  return self->interrupcao != 0;
+}
+
+// inicia uma transferência com os valores dos registradores
+static err_t disco_inicia_transferencia(disco_t *self, int comando)
+{
+  if (comando != DISCO_CMD_LE && comando != DISCO_CMD_ESCREVE) return ERR_OP_INV;
+  if (self->comando != 0) return ERR_OCUP;
+  if (self->quant <= 0 || self->end_disco < 0
+      || self->end_disco + self->quant > DISCO_TAM
+      || self->end_mem < 0
+      || self->end_mem + self->quant > mem_tam(self->mem)) {
+    return ERR_END_INV;
+  }
+  self->comando = comando;
+  self->transf_disco = self->end_disco;
+  self->transf_mem = self->end_mem;
+  self->transf_quant = self->quant;
+  self->t_ate_fim = self->quant * self->tempo_palavra;
+  if (self->end_disco != self->cabeca) self->t_ate_fim += self->tempo_busca;
+  // uma transferência sempre leva pelo menos uma unidade de tempo
+  if (self->t_ate_fim < 1) self->t_ate_fim = 1;
+  return ERR_OK;
+}
+
+err_t disco_leitura(void *disp, int id, int *pvalor)
+{
+  disco_t *self = disp;
+  switch (id) {
+    case 0:
+      *pvalor = self->comando != 0 ? 1 : 0;
+      break;
+    case 1:
+      *pvalor = self->end_disco;
+      break;
+    case 2:
+      *pvalor = self->end_mem;
+      break;
+    case 3:
+      *pvalor = self->quant;
+      break;
+    case 4:
+      *pvalor = self->interrupcao;
+      break;
+    case 5:
+      if (self->end_disco < 0 || self->end_disco >= DISCO_TAM) return ERR_END_INV;
+      *pvalor = self->dados[self->end_disco++];
+      break;
+    case 6:
+      *pvalor = DISCO_TAM;
+      break;
+    default:
+      return ERR_END_INV;
+  }
+  return ERR_OK;
+}
+
+err_t disco_escrita(void *disp, int id, int valor)
+{
+  disco_t *self = disp;
+  switch (id) {
+    case 0:
+      return disco_inicia_transferencia(self, valor);
+    case 1:
+      self->end_disco = valor;
+      break;
+    case 2:
+      self->end_mem = valor;
+      break;
+    case 3:
+      self->quant = valor;
+      break;
+    case 4:
+      self->interrupcao = (valor == 0) ? 0 : 1;
+      break;
+    case 5:
+      if (self->end_disco < 0 || self->end_disco >= DISCO_TAM) return ERR_END_INV;
+      self->dados[self->end_disco++] = valor;
+      break;
+    default:
+      return ERR_END_INV;
+  }
+  return ERR_OK;
+}
+
+bool disco_grava_estado(disco_t *self, FILE *arq)
+{
+  // os ponteiros vão junto, mas não são usados na leitura
+  return ESTADO_GRAVA(arq, *self);
+}
+
+bool disco_le_estado(disco_t *self, FILE *arq)
+{
+  disco_t lido;
+  if (!ESTADO_LE(arq, lido)) return false;
+  lido.dados = self->dados;
+  lido.mapeado = self->mapeado;
+  lido.mem = self->mem;
+  // a latência é a configurada nesta execução, não a da gravação
+  lido.tempo_busca = self->tempo_busca;
+  lido.tempo_palavra = self->tempo_palavra;
+  *self = lido;
+  return true;
+}
+
+bool disco_grava_imagem(disco_t *self, FILE *arq)
+{
+  return fwrite(self->dados, sizeof(*self->dados), DISCO_TAM, arq) == DISCO_TAM;
+}
+
+bool disco_mapeia_imagem(disco_t *self, int fd, off_t desl)
+{
+  size_t tam = DISCO_TAM * sizeof(*self->dados);
+  int *dados = mmap(NULL, tam, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, desl);
+  if (dados == MAP_FAILED) return false;
+  if (self->mapeado) {
+    munmap(self->dados, tam);
+  } else {
+    free(self->dados);
+  }
+  self->dados = dados;
+  self->mapeado = true;
+  return true;
+}
@@ -0,0 +1,95 @@
+// disco.h
+// dispositivo de E/S de memória secundária (disco)
+// simulador de computador
+// so24b
+
+#ifndef DISCO_H
+#define DISCO_H
+
+// simulador de um disco, usado como memória secundária para a paginação
+// o disco transfere blocos de palavras entre ele e a memória principal
+//   (por DMA), sem ocupar a CPU; a transferência leva um tempo que depende
+//   da posição da cabeça de leitura e do número de palavras, e ao final
+//   o disco pede uma interrupção (IRQ_DISCO)
+// o tempo é medido nas mesmas unidades do relógio (instruções)
+
+#include "err.h"
+#include "memoria.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+typedef struct disco_t disco_t;
+
+// tamanho do disco, em palavras
+#define DISCO_TAM 100000
+
+// latência inicial: tempo para posicionar a cabeça se a transferência não
+//   começar onde terminou a anterior
+// podem ser alterados com disco_define_latencia (opções -B e -W do main)
+#define DISCO_TEMPO_BUSCA   100
+// tempo para transferir cada palavra
+#define DISCO_TEMPO_PALAVRA 5
+
+// comandos que podem ser escritos no dispositivo 0
+#define DISCO_CMD_LE      1  // copia do disco para a memória principal
+#define DISCO_CMD_ESCREVE 2  // copia da memória principal para o disco
+
+// cria e inicializa um disco com DISCO_TAM palavras zeradas
+// 'mem' é a memória principal, usada nas transferências
+// mata o programa em caso de erro (malloc)
+disco_t *disco_cria(mem_t *mem);
+
+// destrói um disco
+// nenhuma outra operação pode ser realizada no disco após esta chamada
+void disco_destroi(disco_t *self);
+
+// altera a latência do disco (ver DISCO_TEMPO_BUSCA e DISCO_TEMPO_PALAVRA)
+// vale para as transferências iniciadas depois da chamada
+void disco_define_latencia(disco_t *self, int tempo_busca, int tempo_palavra);
+
+// registra a passagem de 'n' unidades de tempo
+// se a transferência em andamento terminar, copia os dados e pede interrupção
+// é chamada pelo controlador, junto com o relógio
+void disco_avanca(disco_t *self, int n);
+
+// retorna em quantas unidades de tempo a transferência em andamento vai
+//   terminar, ou -1 se o disco estiver livre
+int disco_tempo_ate_evento(disco_t *self);
+
+// retorna true se o disco está pedindo interrupção (o mesmo que o
+//   dispositivo 4)
+// segue o protocolo f_linha_int_t de controlador_int.h, para o controlador
+//   de interrupções consultar o disco
+bool disco_tem_interrupcao(void *disp);
+
+// Funções para acessar o disco como dispositivo de E/S, com id:
+//   '0' comando: escrever DISCO_CMD_LE ou DISCO_CMD_ESCREVE inicia uma
+//       transferência com os valores dos dispositivos 1 a 3 (ERR_OCUP se
+//       já tiver uma em andamento); ler dá 1 se o disco estiver ocupado
+//   '1' endereço no disco
+//   '2' endereço na memória principal
+//   '3' número de palavras a transferir
+//   '4' ler ou escrever se uma interrupção está sendo pedida
+//   '5' acesso direto à palavra do disco no endereço do dispositivo 1, que
+//       é incrementado; não tem latência, serve para o SO preparar o
+//       conteúdo do disco (colocar os programas)
+//   '6' leitura do tamanho do disco
+// Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
+err_t disco_leitura(void *disp, int id, int *pvalor);
+err_t disco_escrita(void *disp, int id, int valor);
+
+// grava no arquivo o estado do disco (registradores e transferência em
+//   andamento, sem o conteúdo), ou lê o estado gravado (ver estado.h)
+// a latência não é restaurada, fica a definida com disco_define_latencia
+// retornam false em caso de erro
+bool disco_grava_estado(disco_t *self, FILE *arq);
+bool disco_le_estado(disco_t *self, FILE *arq);
+
+// grava o conteúdo do disco no arquivo, ou substitui o conteúdo pelo que
+//   está no arquivo 'fd' a partir de 'desl', como em mem_grava_imagem e
+//   mem_mapeia_imagem
+bool disco_grava_imagem(disco_t *self, FILE *arq);
+bool disco_mapeia_imagem(disco_t *self, int fd, off_t desl);
+
+#endif // DISCO_H
@@ -6,6 +6,13 @@
 #ifndef DISPOSITIVOS_H
 #define DISPOSITIVOS_H
 
+// número máximo de terminais (A a H); quantos existem é definido na criação
+//   da console
+// cada terminal tem 4 dispositivos: teclado, teclado ok, tela e tela ok
+// os terminais A a D têm números fixos (os programas usam o 4 a 7 do B); os
+//   demais ficam depois dos outros dispositivos, a partir de D_TERM_E_TECLADO
+#define MAX_TERMINAIS 8
+
 typedef enum {
   D_TERM_A_TECLADO        =  0,
   D_TERM_A_TECLADO_OK     =  1,
@@ -27,8 +34,28 @@ typedef enum {
   D_RELOGIO_REAL          = 17,
   D_RELOGIO_TIMER         = 18,
   D_RELOGIO_INTERRUPCAO   = 19,
-  N_DISPOSITIVOS
+  D_DISCO_COMANDO         = 20,
+  D_DISCO_END_DISCO       = 21,
+  D_DISCO_END_MEM         = 22,
+  D_DISCO_QUANT           = 23,
+  D_DISCO_INTERRUPCAO     = 24,
+  D_DISCO_DADO            = 25,
+  D_DISCO_TAMANHO         = 26,
+  D_INT_PENDENTES         = 27,
+  D_INT_HABILITADAS       = 28,
+  D_INT_IRQ               = 29,
+  D_INT_PRIORIDADE        = 30,
+  D_TERM_E_TECLADO        = 31,
+  N_DISPOSITIVOS          = D_TERM_E_TECLADO + 4 * (MAX_TERMINAIS - 4)
 } dispositivo_id_t;
 
+// retorna o dispositivo 'reg' (0 a 3, na ordem acima) do terminal número
+//   'terminal' (0 é o A)
+static inline int dispositivo_terminal(int terminal, int reg)
+{
+  if (terminal < 4) return D_TERM_A_TECLADO + terminal * 4 + reg;
+  return D_TERM_E_TECLADO + (terminal - 4) * 4 + reg;
+}
+
 #endif // DISPOSITIVOS_H
 
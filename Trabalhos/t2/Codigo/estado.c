@@ -0,0 +1,118 @@
+// estado.c
+// gravação e restauração do estado da máquina (checkpoint)
+// simulador de computador
+// so24b
+
+#include "estado.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+bool estado_grava_bytes(FILE *arq, const void *dados, size_t tam)
+{
+  return fwrite(dados, 1, tam, arq) == tam;
+}
+
+bool estado_le_bytes(FILE *arq, void *dados, size_t tam)
+{
+  return fread(dados, 1, tam, arq) == tam;
+}
+
+// completa o arquivo com zeros até um múltiplo do tamanho de página, e
+//   retorna o deslocamento (-1 em caso de erro)
+static int64_t estado_alinha(FILE *arq)
+{
+  long pagina = sysconf(_SC_PAGESIZE);
+  long desl = ftell(arq);
+  if (desl < 0) return -1;
+  while (desl % pagina != 0) {
+    if (fputc(0, arq) == EOF) return -1;
+    desl++;
+  }
+  return desl;
+}
+
+// grava o estado dos componentes, na ordem em que estado_le_componentes lê
+static bool estado_grava_componentes(estado_maquina_t *maq, FILE *arq)
+{
+  // a MMU identifica as tabelas de páginas na TLB pelo SO, que já tem que
+  //   ter criado as tabelas quando a MMU for restaurada
+  return cpu_grava_estado(maq->cpu, arq)
+      && relogio_grava_estado(maq->relogio, arq)
+      && disco_grava_estado(maq->disco, arq)
+      && controlador_int_grava_estado(maq->ci, arq)
+      && console_grava_estado(maq->console, arq)
+      && controle_grava_estado(maq->controle, arq)
+      && so_grava_estado(maq->so, arq)
+      && mmu_grava_estado(maq->mmu, arq, so_id_tabpag, maq->so);
+}
+
+static bool estado_le_componentes(estado_maquina_t *maq, FILE *arq)
+{
+  return cpu_le_estado(maq->cpu, arq)
+      && relogio_le_estado(maq->relogio, arq)
+      && disco_le_estado(maq->disco, arq)
+      && controlador_int_le_estado(maq->ci, arq)
+      && console_le_estado(maq->console, arq)
+      && controle_le_estado(maq->controle, arq)
+      && so_le_estado(maq->so, arq)
+      && mmu_le_estado(maq->mmu, arq, so_tabpag_do_id, maq->so);
+}
+
+bool estado_grava(estado_maquina_t *maq, char *nome)
+{
+  FILE *arq = fopen(nome, "wb");
+  if (arq == NULL) return false;
+
+  estado_cabecalho_t cab;
+  memset(&cab, 0, sizeof(cab));
+  memcpy(cab.magica, ESTADO_MAGICA, sizeof(cab.magica));
+  cab.versao = ESTADO_VERSAO;
+  cab.tam_mem = mem_tam(maq->mem);
+  cab.tam_disco = DISCO_TAM;
+  cab.tam_pagina = mmu_tam_pagina(maq->mmu);
+  cab.n_terminais = console_n_terminais(maq->console);
+
+  // o cabeçalho é gravado de novo no final, com os deslocamentos das imagens
+  bool ok = ESTADO_GRAVA(arq, cab)
+         && estado_grava_componentes(maq, arq)
+         && (cab.desl_mem = estado_alinha(arq)) >= 0
+         && mem_grava_imagem(maq->mem, arq)
+         && (cab.desl_disco = estado_alinha(arq)) >= 0
+         && disco_grava_imagem(maq->disco, arq)
+         && fseek(arq, 0, SEEK_SET) == 0
+         && ESTADO_GRAVA(arq, cab);
+  if (fclose(arq) != 0) ok = false;
+  return ok;
+}
+
+bool estado_restaura(estado_maquina_t *maq, char *nome)
+{
+  FILE *arq = fopen(nome, "rb");
+  if (arq == NULL) return false;
+
+  estado_cabecalho_t cab;
+  struct stat st;
+  bool ok = ESTADO_LE(arq, cab)
+         && memcmp(cab.magica, ESTADO_MAGICA, sizeof(cab.magica)) == 0
+         && cab.versao == ESTADO_VERSAO
+         && cab.tam_mem == mem_tam(maq->mem)
+         && cab.tam_disco == DISCO_TAM
+         && cab.tam_pagina == mmu_tam_pagina(maq->mmu)
+         && cab.n_terminais == console_n_terminais(maq->console)
+         && fstat(fileno(arq), &st) == 0;
+  // acessar um mapeamento além do fim do arquivo mata o programa (SIGBUS)
+  ok = ok
+    && cab.desl_mem + cab.tam_mem * (int64_t)sizeof(int) <= st.st_size
+    && cab.desl_disco + cab.tam_disco * (int64_t)sizeof(int) <= st.st_size;
+  // as imagens são mapeadas antes de ler o resto: mapear a memória não
+  //   avisa a CPU, que tem que ler a cache de decodificação depois
+  ok = ok
+    && mem_mapeia_imagem(maq->mem, fileno(arq), cab.desl_mem)
+    && disco_mapeia_imagem(maq->disco, fileno(arq), cab.desl_disco)
+    && estado_le_componentes(maq, arq);
+  // os mapeamentos continuam válidos depois de fechar o arquivo
+  fclose(arq);
+  return ok;
+}
@@ -0,0 +1,89 @@
+// estado.h
+// gravação e restauração do estado da máquina (checkpoint)
+// simulador de computador
+// so24b
+
+#ifndef ESTADO_H
+#define ESTADO_H
+
+// grava o estado completo da máquina simulada (hardware e SO) em um arquivo
+//   binário, e restaura a máquina a partir dele, para continuar a execução
+//   do ponto em que foi gravada sem precisar inicializar tudo de novo
+// o arquivo tem:
+//   - o cabeçalho (estado_cabecalho_t), no início
+//   - o estado de cada componente, em sequência, gravado e lido pelas funções
+//     xxx_grava_estado e xxx_le_estado de cada um
+//   - as imagens da memória principal e do disco, cada uma começando em um
+//     deslocamento múltiplo do tamanho de página do hospedeiro, para poderem
+//     ser mapeadas (mmap) direto na restauração, sem cópia
+// como o formato binário dos programas (ver maqbin.h), os números estão na
+//   ordem de bytes da máquina que gravou, e o arquivo só pode ser lido pelo
+//   mesmo executável (as estruturas são gravadas como estão na memória)
+// o que não é estado da máquina não é gravado: a tela, os arquivos de saída
+//   dos terminais, o perfil, o cache de programas do SO
+
+#include "memoria.h"
+#include "mmu.h"
+#include "cpu.h"
+#include "relogio.h"
+#include "disco.h"
+#include "controlador_int.h"
+#include "console.h"
+#include "controle.h"
+#include "so.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ESTADO_MAGICA "SO24"
+#define ESTADO_VERSAO 6
+
+typedef struct {
+  char magica[4];
+  int32_t versao;
+  // número de palavras das imagens, e onde começam no arquivo
+  int32_t tam_mem;
+  int32_t tam_disco;
+  // configuração da máquina que não está nas imagens
+  int32_t tam_pagina;
+  int32_t n_terminais;
+  int64_t desl_mem;
+  int64_t desl_disco;
+} estado_cabecalho_t;
+
+// os componentes da máquina
+typedef struct {
+  mem_t *mem;
+  mmu_t *mmu;
+  cpu_t *cpu;
+  relogio_t *relogio;
+  disco_t *disco;
+  controlador_int_t *ci;
+  console_t *console;
+  controle_t *controle;
+  so_t *so;
+} estado_maquina_t;
+
+// grava o estado da máquina no arquivo 'nome'
+// retorna false em caso de erro
+bool estado_grava(estado_maquina_t *maq, char *nome);
+
+// restaura o estado da máquina gravado no arquivo 'nome'
+// a máquina deve ter sido criada com a mesma configuração (tamanho da
+//   memória e da página, número de terminais, TLB etc) da que foi gravada,
+//   mas não deve ter executado nada
+// retorna false em caso de erro (arquivo inválido ou de outra configuração);
+//   nesse caso a máquina pode ter ficado com parte do estado alterado
+bool estado_restaura(estado_maquina_t *maq, char *nome);
+
+// funções auxiliares para os componentes gravarem e lerem seu estado
+// gravam ou leem 'tam' bytes; retornam false em caso de erro
+bool estado_grava_bytes(FILE *arq, const void *dados, size_t tam);
+bool estado_le_bytes(FILE *arq, void *dados, size_t tam);
+
+// grava ou lê uma variável
+#define ESTADO_GRAVA(arq, var) estado_grava_bytes(arq, &(var), sizeof(var))
+#define ESTADO_LE(arq, var) estado_le_bytes(arq, &(var), sizeof(var))
+
+#endif // ESTADO_H
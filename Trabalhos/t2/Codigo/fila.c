@@ -0,0 +1,95 @@
+// fila.c
+// fila de processos prontos
+// simulador de computador
+// so24b
+
+#include "fila.h"
+#include "processo.h"
+#include <stddef.h>
+
+void fila_inicializa(fila_t *self)
+{
+  self->inicio = NULL;
+  self->fim = NULL;
+}
+
+bool fila_vazia(fila_t *self)
+{
+  return self->inicio == NULL;
+}
+
+processo_t *fila_primeiro(fila_t *self)
+{
+  return self->inicio;
+}
+
+processo_t *fila_proximo(processo_t *proc)
+{
+  return proc->fila_proximo;
+}
+
+void fila_insere(fila_t *self, processo_t *proc)
+{
+  if (proc->fila != NULL) return;
+  proc->fila = self;
+
+  // procura o primeiro com prioridade menor; o novo fica antes dele
+  processo_t *atual = self->inicio;
+  while (atual != NULL && atual->prioridade >= proc->prioridade) {
+    atual = atual->fila_proximo;
+  }
+
+  proc->fila_proximo = atual;
+  if (atual == NULL) {
+    // no fim (ou fila vazia)
+    proc->fila_anterior = self->fim;
+    self->fim = proc;
+  } else {
+    proc->fila_anterior = atual->fila_anterior;
+    atual->fila_anterior = proc;
+  }
+  if (proc->fila_anterior == NULL) {
+    self->inicio = proc;
+  } else {
+    proc->fila_anterior->fila_proximo = proc;
+  }
+}
+
+void fila_insere_fim(fila_t *self, processo_t *proc)
+{
+  if (proc->fila != NULL) return;
+  proc->fila = self;
+
+  proc->fila_proximo = NULL;
+  proc->fila_anterior = self->fim;
+  if (self->fim == NULL) {
+    self->inicio = proc;
+  } else {
+    self->fim->fila_proximo = proc;
+  }
+  self->fim = proc;
+}
+
+void fila_remove(fila_t *self, processo_t *proc)
+{
+  if (proc->fila != self) return;
+  proc->fila = NULL;
+
+  if (proc->fila_anterior != NULL) {
+    proc->fila_anterior->fila_proximo = proc->fila_proximo;
+  } else {
+    self->inicio = proc->fila_proximo;
+  }
+  if (proc->fila_proximo != NULL) {
+    proc->fila_proximo->fila_anterior = proc->fila_anterior;
+  } else {
+    self->fim = proc->fila_anterior;
+  }
+  proc->fila_anterior = NULL;
+  proc->fila_proximo = NULL;
+}
+
+fila_t *fila_do_processo(processo_t *proc)
+{
+  return proc->fila;
+}
@@ -0,0 +1,54 @@
+// fila.h
+// fila de processos prontos
+// simulador de computador
+// so24b
+
+#ifndef FILA_H
+#define FILA_H
+
+// fila duplamente encadeada de processos, ordenada por prioridade
+//   (fila_insere) ou por ordem de chegada (fila_insere_fim)
+// a fila é intrusiva: os ponteiros de encadeamento ficam no próprio
+//   processo_t (fila_anterior, fila_proximo), então inserir e remover não
+//   alocam memória, e remover um processo não precisa procurá-lo na fila
+// um processo está em no máximo uma fila, que fica registrada nele (fila)
+
+#include <stdbool.h>
+
+// processo.h inclui este arquivo, para poder ter filas no descritor
+typedef struct processo_t processo_t;
+
+typedef struct fila_t {
+  processo_t *inicio;
+  processo_t *fim;
+} fila_t;
+
+// inicializa uma fila vazia
+void fila_inicializa(fila_t *self);
+
+// retorna true se não tem processo na fila
+bool fila_vazia(fila_t *self);
+
+// retorna o primeiro processo da fila (sem retirá-lo), ou NULL se vazia
+processo_t *fila_primeiro(fila_t *self);
+
+// retorna o processo seguinte a 'proc' na fila, ou NULL se for o último
+processo_t *fila_proximo(processo_t *proc);
+
+// insere o processo na fila, depois de todos os que têm prioridade maior
+//   ou igual à dele
+// não faz nada se o processo já estiver em uma fila
+void fila_insere(fila_t *self, processo_t *proc);
+
+// insere o processo no fim da fila, sem considerar a prioridade
+// não faz nada se o processo já estiver em uma fila
+void fila_insere_fim(fila_t *self, processo_t *proc);
+
+// retira o processo da fila, em tempo constante
+// não faz nada se o processo não estiver nessa fila
+void fila_remove(fila_t *self, processo_t *proc);
+
+// retorna a fila em que o processo está, ou NULL
+fila_t *fila_do_processo(processo_t *proc);
+
+#endif // FILA_H
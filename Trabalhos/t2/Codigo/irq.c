@@ -10,6 +10,7 @@ static char *nomes[N_IRQ] = {
   [IRQ_ERR_CPU] = "Erro de execução",
   [IRQ_SISTEMA] = "Chamada de sistema",
   [IRQ_RELOGIO] = "E/S: relógio",
+  [IRQ_DISCO]   = "E/S: disco",
   [IRQ_TECLADO] = "E/S: teclado",
   [IRQ_TELA]    = "E/S: console",
 };
@@ -14,9 +14,9 @@ typedef enum {
   IRQ_SISTEMA,       // chamada de sistema
   // interrupções geradas por dispositivos de E/S
   IRQ_RELOGIO,       // interrupção causada pelo relógio
-  // interrupções de E/S ainda não implementadas
-  IRQ_TECLADO,       // interrupção causada pelo teclado
-  IRQ_TELA,          // interrupção causada pela tela
+  IRQ_DISCO,         // fim de transferência do disco
+  IRQ_TECLADO,       // chegou caractere em um teclado que estava vazio
+  IRQ_TELA,          // uma tela voltou a aceitar caracteres
   N_IRQ              // número de interrupções
 } irq_t;
 
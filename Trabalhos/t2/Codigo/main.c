@@ -6,19 +6,64 @@
 #include "controle.h"
 #include "memoria.h"
 #include "mmu.h"
+#include "disco.h"
 #include "cpu.h"
 #include "relogio.h"
+#include "controlador_int.h"
 #include "console.h"
 #include "terminal.h"
 #include "es.h"
 #include "dispositivos.h"
 #include "so.h"
+#include "perfil.h"
+#include "estado.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <assert.h>
 
-// constantes
+// valores padrão da configuração da máquina
 #define MEM_TAM 10000        // tamanho da memória principal
+#define N_TERMINAIS 4        // número de terminais
+#define CAP_ENTRADA_TERM 1024 // caracteres digitados e não lidos em cada terminal
+
+// valores default para a execução em lote (sem tela)
+#define LOTE_INTERVALO_CONSOLE    10000  // instruções entre atendimentos da console
+#define LOTE_INTERVALO_CONSOLE_MS 10     // ms entre atendimentos da console
+#define ARQUIVO_LOG "log_da_console"
+
+// opções da linha de comando
+typedef struct {
+  // true para executar em lote, sem tela
+  bool em_lote;
+  int intervalo_console;
+  int intervalo_console_ms;
+  long limite_instrucoes;
+  // prefixo dos arquivos de saída dos terminais (NULL para saída padrão)
+  char *prefixo_saida;
+  // prefixo dos arquivos do perfil (NULL para executar sem perfilador)
+  char *prefixo_perfil;
+  // arquivo de onde restaurar o estado da máquina antes de executar, e onde
+  //   gravar o estado no final da execução (NULL se não tem)
+  char *arquivo_restaura;
+  char *arquivo_grava;
+  // arquivo de log da console (NULL se não tem)
+  char *arquivo_log;
+  // configuração da máquina
+  int tam_mem;
+  int tam_pagina;
+  int n_terminais;
+  int cap_entrada_terminal;
+  int tlb_entradas;
+  int tlb_vias;
+  int disco_tempo_busca;
+  int disco_tempo_palavra;
+  // parâmetros do SO
+  so_param_t param_so;
+} opcoes_t;
 
 // estrutura com os componentes do computador simulado
 typedef struct {
@@ -26,88 +71,403 @@ typedef struct {
   mmu_t *mmu;
   cpu_t *cpu;
   relogio_t *relogio;
+  disco_t *disco;
+  controlador_int_t *ci;
   console_t *console;
   es_t *es;
   controle_t *controle;
+  perfil_t *perfil;
 } hardware_t;
 
-static void cria_hardware(hardware_t *hw)
+static void cria_hardware(hardware_t *hw, opcoes_t *op)
 {
   // cria a memória e a MMU
-  hw->mem = mem_cria(MEM_TAM);
-  hw->mmu = mmu_cria(hw->mem);
+  hw->mem = mem_cria(op->tam_mem);
+  hw->mmu = mmu_cria(hw->mem, op->tam_pagina);
+  mmu_configura_tlb(hw->mmu, op->tlb_entradas, op->tlb_vias);
 
   // cria dispositivos de E/S
-  hw->console = console_cria();
+  hw->console = console_cria(!op->em_lote, op->arquivo_log, op->n_terminais,
+                             op->cap_entrada_terminal);
+  if (op->em_lote && op->prefixo_saida != NULL) {
+    console_define_saida(hw->console, op->prefixo_saida);
+  }
   hw->relogio = relogio_cria();
+  hw->disco = disco_cria(hw->mem);
+  disco_define_latencia(hw->disco, op->disco_tempo_busca, op->disco_tempo_palavra);
+
+  // cria o controlador de interrupções; o relógio e o disco pedem
+  //   interrupção por nível, os terminais avisam o controlador
+  hw->ci = controlador_int_cria();
+  controlador_int_registra_linha(hw->ci, IRQ_RELOGIO, hw->relogio, relogio_tem_interrupcao);
+  controlador_int_registra_linha(hw->ci, IRQ_DISCO, hw->disco, disco_tem_interrupcao);
 
   // cria o controlador de E/S e registra os dispositivos
   //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
   //   dispositivo 0 do relógio (que é o contador de instruções)
   hw->es = es_cria();
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal A
-  terminal_t *terminal;
-  terminal = console_terminal(hw->console, 'A');
-  es_registra_dispositivo(hw->es, D_TERM_A_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_A_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_A_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_A_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal B
-  terminal = console_terminal(hw->console, 'B');
-  es_registra_dispositivo(hw->es, D_TERM_B_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_B_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_B_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_B_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal C
-  terminal = console_terminal(hw->console, 'C');
-  es_registra_dispositivo(hw->es, D_TERM_C_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_C_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_C_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_C_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal D
-  terminal = console_terminal(hw->console, 'D');
-  es_registra_dispositivo(hw->es, D_TERM_D_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_D_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_D_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_D_TELA_OK    , terminal, 3, terminal_leitura, NULL);
+  // lê teclado, testa teclado, escreve tela, testa tela de cada terminal
+  for (int t = 0; t < op->n_terminais; t++) {
+    terminal_t *terminal = console_terminal(hw->console, 'A' + t);
+    terminal_define_controlador_int(terminal, hw->ci);
+    es_registra_dispositivo(hw->es, dispositivo_terminal(t, 0), terminal, 0, terminal_leitura, NULL);
+    es_registra_dispositivo(hw->es, dispositivo_terminal(t, 1), terminal, 1, terminal_leitura, NULL);
+    es_registra_dispositivo(hw->es, dispositivo_terminal(t, 2), terminal, 2, NULL, terminal_escrita);
+    es_registra_dispositivo(hw->es, dispositivo_terminal(t, 3), terminal, 3, terminal_leitura, NULL);
+  }
   // lê relógio virtual, relógio real
   es_registra_dispositivo(hw->es, D_RELOGIO_INSTRUCOES, hw->relogio, 0, relogio_leitura, NULL);
   es_registra_dispositivo(hw->es, D_RELOGIO_REAL      , hw->relogio, 1, relogio_leitura, NULL);
   es_registra_dispositivo(hw->es, D_RELOGIO_TIMER     , hw->relogio, 2, relogio_leitura, relogio_escrita);
   es_registra_dispositivo(hw->es, D_RELOGIO_INTERRUPCAO,hw->relogio, 3, relogio_leitura, relogio_escrita);
+  // comando, endereços e tamanho da transferência, interrupção, acesso
+  //   direto e tamanho do disco
+  es_registra_dispositivo(hw->es, D_DISCO_COMANDO     , hw->disco, 0, disco_leitura, disco_escrita);
+  es_registra_dispositivo(hw->es, D_DISCO_END_DISCO   , hw->disco, 1, disco_leitura, disco_escrita);
+  es_registra_dispositivo(hw->es, D_DISCO_END_MEM     , hw->disco, 2, disco_leitura, disco_escrita);
+  es_registra_dispositivo(hw->es, D_DISCO_QUANT       , hw->disco, 3, disco_leitura, disco_escrita);
+  es_registra_dispositivo(hw->es, D_DISCO_INTERRUPCAO , hw->disco, 4, disco_leitura, disco_escrita);
+  es_registra_dispositivo(hw->es, D_DISCO_DADO        , hw->disco, 5, disco_leitura, disco_escrita);
+  es_registra_dispositivo(hw->es, D_DISCO_TAMANHO     , hw->disco, 6, disco_leitura, NULL);
+  // interrupções pendentes, habilitadas, seleção e prioridade da selecionada
+  es_registra_dispositivo(hw->es, D_INT_PENDENTES     , hw->ci, 0, controlador_int_leitura, controlador_int_escrita);
+  es_registra_dispositivo(hw->es, D_INT_HABILITADAS   , hw->ci, 1, controlador_int_leitura, controlador_int_escrita);
+  es_registra_dispositivo(hw->es, D_INT_IRQ           , hw->ci, 2, controlador_int_leitura, controlador_int_escrita);
+  es_registra_dispositivo(hw->es, D_INT_PRIORIDADE    , hw->ci, 3, controlador_int_leitura, controlador_int_escrita);
 
   // cria a unidade de execução e inicializa com a MMU e E/S
   hw->cpu = cpu_cria(hw->mmu, hw->es);
+  hw->perfil = NULL;
+  if (op->prefixo_perfil != NULL) {
+    hw->perfil = perfil_cria();
+    cpu_define_perfil(hw->cpu, hw->perfil);
+  }
 
-  // cria o controlador da CPU e inicializa com a unidade de execução, a console e
-  //   o relógio
-  hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio);
+  // cria o controlador da CPU e inicializa com a unidade de execução, a console,
+  //   o relógio, o disco e o controlador de interrupções
+  hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio, hw->disco,
+                               hw->ci);
+  if (op->em_lote) {
+    controle_define_lote(hw->controle, op->intervalo_console,
+                         op->intervalo_console_ms, op->limite_instrucoes);
+  }
 }
 
 static void destroi_hardware(hardware_t *hw)
 {
   controle_destroi(hw->controle);
   cpu_destroi(hw->cpu);
+  if (hw->perfil != NULL) perfil_destroi(hw->perfil);
   es_destroi(hw->es);
+  disco_destroi(hw->disco);
   relogio_destroi(hw->relogio);
+  // os terminais da console avisam o controlador de interrupções
   console_destroi(hw->console);
+  controlador_int_destroi(hw->ci);
   mmu_destroi(hw->mmu);
   mem_destroi(hw->mem);
 }
 
-int main()
+static void uso(char *nome)
+{
+  so_param_t padrao;
+  so_param_padrao(&padrao);
+  fprintf(stderr, "uso: %s [-b] [-n instr] [-t ms] [-l instr] [-o prefixo] [-p prefixo]\n"
+          "          [-r arquivo] [-g arquivo] [-e escalonador] [-s substituição]\n"
+          "          [-q quantum] [-i instr] [-m arquivo] [-L arquivo] [-M palavras]\n"
+          "          [-P palavras] [-T terminais] [-I caracteres] [-Q quadros]\n"
+          "          [-E entradas] [-V vias] [-B instr] [-W instr] [-c arquivo]\n"
+          "  -b         executa em lote, sem tela\n"
+          "  -n instr   em lote, atende a console a cada 'instr' instruções (%d)\n"
+          "  -t ms      em lote, atende a console a cada 'ms' milisegundos (%d)\n"
+          "  -l instr   em lote, termina depois de 'instr' instruções\n"
+          "  -o prefixo em lote, a saída do terminal X vai para o arquivo 'prefixoX'\n"
+          "             (sem essa opção, vai para a saída padrão)\n"
+          "  -p prefixo perfila as instruções executadas, gravando o perfil em\n"
+          "             'prefixo.pilhas' (para flamegraph) e 'prefixo.txt'\n"
+          "  -r arquivo continua a execução gravada em 'arquivo' com -g, em vez\n"
+          "             de iniciar a máquina do zero; o limite de -l conta as\n"
+          "             instruções executadas antes da gravação\n"
+          "  -g arquivo no final da execução, grava o estado da máquina em 'arquivo'\n"
+          "  -e escalonador  normal, rr, rrp (round-robin com prioridade) ou mlfq\n"
+          "  -s substituição fifo, segunda_chance, envelhecimento ou wsclock\n"
+          "  -q quantum interrupções do relógio por quantum\n"
+          "  -i instr   instruções entre interrupções do relógio\n"
+          "  -m arquivo grava as métricas em 'arquivo' (%s)\n"
+          "  -L arquivo grava o log da console em 'arquivo' (%s)\n"
+          "  -M palavras tamanho da memória principal (%d)\n"
+          "  -P palavras tamanho das páginas (%d)\n"
+          "  -T terminais número de terminais, de 1 a %d (%d)\n"
+          "  -I caracteres quantos caracteres digitados e ainda não lidos\n"
+          "             cabem em cada terminal (%d)\n"
+          "  -Q quadros número máximo de quadros para páginas, pelo menos %d\n"
+          "             (0 para usar toda a memória livre)\n"
+          "  -E entradas número de entradas da TLB, 0 para não usar TLB (%d)\n"
+          "  -V vias    número de vias (associatividade) da TLB; o número de\n"
+          "             entradas deve ser múltiplo dele (%d)\n"
+          "  -B instr   tempo de busca do disco (%d)\n"
+          "  -W instr   tempo de transferência de cada palavra do disco (%d)\n"
+          "  -c arquivo lê a configuração de 'arquivo', com linhas 'nome = valor'\n"
+          "             ('#' começa um comentário); os nomes são memoria,\n"
+          "             tam_pagina, terminais, entrada_terminal, tlb_entradas,\n"
+          "             tlb_vias, disco_tempo_busca, disco_tempo_palavra e os\n"
+          "             parâmetros do SO (escalonador, substituicao, quantum,\n"
+          "             intervalo_interrupcao, max_quadros, arquivo_metricas);\n"
+          "             as opções seguintes alteram a configuração lida\n",
+          nome, LOTE_INTERVALO_CONSOLE, LOTE_INTERVALO_CONSOLE_MS,
+          padrao.arquivo_metricas, ARQUIVO_LOG, MEM_TAM, TAM_PAGINA,
+          MAX_TERMINAIS, N_TERMINAIS, CAP_ENTRADA_TERM,
+          MIN_QUADROS_POR_PROCESSO, TLB_ENTRADAS, TLB_VIAS,
+          DISCO_TEMPO_BUSCA, DISCO_TEMPO_PALAVRA);
+  exit(1);
+}
+
+// pega o valor numérico do argumento seguinte a argv[*pargi]
+static long pega_numero(int argc, char *argv[argc], int *pargi)
+{
+  (*pargi)++;
+  if (*pargi >= argc) uso(argv[0]);
+  char *fim;
+  long val = strtol(argv[*pargi], &fim, 0);
+  if (*fim != '\0' || val < 0) {
+    fprintf(stderr, "ERRO: valor inválido: '%s'\n", argv[*pargi]);
+    uso(argv[0]);
+  }
+  return val;
+}
+
+// retorna o argumento seguinte a argv[*pargi]
+static char *pega_texto(int argc, char *argv[argc], int *pargi)
+{
+  (*pargi)++;
+  if (*pargi >= argc) uso(argv[0]);
+  return argv[*pargi];
+}
+
+// coloca em '*pnum' o valor de 'valor', que deve ser um número entre 'min'
+//   e 'max'
+static bool pega_numero_entre(char *valor, int min, int max, int *pnum)
+{
+  char *fim;
+  long num = strtol(valor, &fim, 0);
+  if (*valor == '\0' || *fim != '\0' || num < min || num > max) return false;
+  *pnum = num;
+  return true;
+}
+
+// altera a configuração 'nome' (da máquina ou do SO) para 'valor'
+// retorna false se o nome ou o valor forem inválidos
+static bool altera_opcao(opcoes_t *op, char *nome, char *valor)
+{
+  if (strcmp(nome, "memoria") == 0) {
+    return pega_numero_entre(valor, 1, INT_MAX, &op->tam_mem);
+  } else if (strcmp(nome, "tam_pagina") == 0) {
+    return pega_numero_entre(valor, 1, INT_MAX, &op->tam_pagina);
+  } else if (strcmp(nome, "terminais") == 0) {
+    return pega_numero_entre(valor, 1, MAX_TERMINAIS, &op->n_terminais);
+  } else if (strcmp(nome, "entrada_terminal") == 0) {
+    return pega_numero_entre(valor, 1, INT_MAX, &op->cap_entrada_terminal);
+  } else if (strcmp(nome, "tlb_entradas") == 0) {
+    return pega_numero_entre(valor, 0, INT_MAX, &op->tlb_entradas);
+  } else if (strcmp(nome, "tlb_vias") == 0) {
+    return pega_numero_entre(valor, 1, INT_MAX, &op->tlb_vias);
+  } else if (strcmp(nome, "disco_tempo_busca") == 0) {
+    return pega_numero_entre(valor, 0, INT_MAX, &op->disco_tempo_busca);
+  } else if (strcmp(nome, "disco_tempo_palavra") == 0) {
+    return pega_numero_entre(valor, 0, INT_MAX, &op->disco_tempo_palavra);
+  }
+  return so_param_altera(&op->param_so, nome, valor);
+}
+
+// altera a configuração 'nome' para o argumento seguinte a argv[*pargi]
+static void pega_opcao(int argc, char *argv[argc], int *pargi,
+                       opcoes_t *op, char *nome)
+{
+  char *valor = pega_texto(argc, argv, pargi);
+  if (!altera_opcao(op, nome, valor)) {
+    fprintf(stderr, "ERRO: valor inválido: '%s'\n", valor);
+    uso(argv[0]);
+  }
+}
+
+// retira os espaços do início e do fim de 's'
+static char *tira_espacos(char *s)
+{
+  while (*s == ' ' || *s == '\t') s++;
+  char *fim = s + strlen(s);
+  while (fim > s && strchr(" \t\r\n", fim[-1]) != NULL) fim--;
+  *fim = '\0';
+  return s;
+}
+
+// lê a configuração do arquivo 'nome', com linhas 'nome = valor'
+// os valores são copiados, porque os textos ficam nas opções (o nome do
+//   arquivo de métricas) até o final da execução
+static bool le_configuracao(opcoes_t *op, char *nome)
+{
+  FILE *arq = fopen(nome, "r");
+  if (arq == NULL) {
+    fprintf(stderr, "ERRO: não foi possível abrir '%s'\n", nome);
+    return false;
+  }
+  char linha[200];
+  int num_linha = 0;
+  bool ok = true;
+  while (ok && fgets(linha, sizeof(linha), arq) != NULL) {
+    num_linha++;
+    char *comentario = strchr(linha, '#');
+    if (comentario != NULL) *comentario = '\0';
+    char *opcao = tira_espacos(linha);
+    if (*opcao == '\0') continue;
+    char *igual = strchr(opcao, '=');
+    if (igual == NULL) {
+      ok = false;
+      break;
+    }
+    *igual = '\0';
+    opcao = tira_espacos(opcao);
+    char *valor = strdup(tira_espacos(igual + 1));
+    assert(valor != NULL);
+    ok = altera_opcao(op, opcao, valor);
+  }
+  if (!ok) {
+    fprintf(stderr, "ERRO: %s:%d: configuração inválida\n", nome, num_linha);
+  }
+  fclose(arq);
+  return ok;
+}
+
+static void verifica_args(int argc, char *argv[argc], opcoes_t *op)
+{
+  op->em_lote = false;
+  op->intervalo_console = LOTE_INTERVALO_CONSOLE;
+  op->intervalo_console_ms = LOTE_INTERVALO_CONSOLE_MS;
+  op->limite_instrucoes = 0;
+  op->prefixo_saida = NULL;
+  op->prefixo_perfil = NULL;
+  op->arquivo_restaura = NULL;
+  op->arquivo_grava = NULL;
+  op->arquivo_log = ARQUIVO_LOG;
+  op->tam_mem = MEM_TAM;
+  op->tam_pagina = TAM_PAGINA;
+  op->n_terminais = N_TERMINAIS;
+  op->cap_entrada_terminal = CAP_ENTRADA_TERM;
+  op->tlb_entradas = TLB_ENTRADAS;
+  op->tlb_vias = TLB_VIAS;
+  op->disco_tempo_busca = DISCO_TEMPO_BUSCA;
+  op->disco_tempo_palavra = DISCO_TEMPO_PALAVRA;
+  so_param_padrao(&op->param_so);
+  for (int argi = 1; argi < argc; argi++) {
+    if (strcmp(argv[argi], "-b") == 0) {
+      op->em_lote = true;
+    } else if (strcmp(argv[argi], "-n") == 0) {
+      op->intervalo_console = pega_numero(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-t") == 0) {
+      op->intervalo_console_ms = pega_numero(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-l") == 0) {
+      op->limite_instrucoes = pega_numero(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-o") == 0) {
+      op->prefixo_saida = pega_texto(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-p") == 0) {
+      op->prefixo_perfil = pega_texto(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-r") == 0) {
+      op->arquivo_restaura = pega_texto(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-g") == 0) {
+      op->arquivo_grava = pega_texto(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-e") == 0) {
+      pega_opcao(argc, argv, &argi, op, "escalonador");
+    } else if (strcmp(argv[argi], "-s") == 0) {
+      pega_opcao(argc, argv, &argi, op, "substituicao");
+    } else if (strcmp(argv[argi], "-q") == 0) {
+      pega_opcao(argc, argv, &argi, op, "quantum");
+    } else if (strcmp(argv[argi], "-i") == 0) {
+      pega_opcao(argc, argv, &argi, op, "intervalo_interrupcao");
+    } else if (strcmp(argv[argi], "-m") == 0) {
+      pega_opcao(argc, argv, &argi, op, "arquivo_metricas");
+    } else if (strcmp(argv[argi], "-L") == 0) {
+      op->arquivo_log = pega_texto(argc, argv, &argi);
+    } else if (strcmp(argv[argi], "-M") == 0) {
+      pega_opcao(argc, argv, &argi, op, "memoria");
+    } else if (strcmp(argv[argi], "-P") == 0) {
+      pega_opcao(argc, argv, &argi, op, "tam_pagina");
+    } else if (strcmp(argv[argi], "-T") == 0) {
+      pega_opcao(argc, argv, &argi, op, "terminais");
+    } else if (strcmp(argv[argi], "-I") == 0) {
+      pega_opcao(argc, argv, &argi, op, "entrada_terminal");
+    } else if (strcmp(argv[argi], "-Q") == 0) {
+      pega_opcao(argc, argv, &argi, op, "max_quadros");
+    } else if (strcmp(argv[argi], "-E") == 0) {
+      pega_opcao(argc, argv, &argi, op, "tlb_entradas");
+    } else if (strcmp(argv[argi], "-V") == 0) {
+      pega_opcao(argc, argv, &argi, op, "tlb_vias");
+    } else if (strcmp(argv[argi], "-B") == 0) {
+      pega_opcao(argc, argv, &argi, op, "disco_tempo_busca");
+    } else if (strcmp(argv[argi], "-W") == 0) {
+      pega_opcao(argc, argv, &argi, op, "disco_tempo_palavra");
+    } else if (strcmp(argv[argi], "-c") == 0) {
+      if (!le_configuracao(op, pega_texto(argc, argv, &argi))) uso(argv[0]);
+    } else {
+      uso(argv[0]);
+    }
+  }
+  // só dá para verificar depois de ler a memória, a página e o máximo de
+  //   quadros, em qualquer ordem
+  int n_quadros = so_quadros_para_paginas(&op->param_so, op->tam_mem,
+                                          op->tam_pagina);
+  if (n_quadros < MIN_QUADROS_POR_PROCESSO) {
+    fprintf(stderr, "ERRO: a memória de %d palavras com páginas de %d deixa %d"
+            " quadros para os processos; o mínimo é %d\n", op->tam_mem,
+            op->tam_pagina, n_quadros, MIN_QUADROS_POR_PROCESSO);
+    uso(argv[0]);
+  }
+  // só dá para verificar depois de ler as duas
+  if (op->tlb_entradas % op->tlb_vias != 0) {
+    fprintf(stderr, "ERRO: o número de entradas da TLB (%d) não é múltiplo"
+            " do número de vias (%d)\n", op->tlb_entradas, op->tlb_vias);
+    uso(argv[0]);
+  }
+}
+
+int main(int argc, char *argv[argc])
 {
   hardware_t hw;
   so_t *so;
+  opcoes_t op;
+
+  verifica_args(argc, argv, &op);
 
   // cria o hardware
-  cria_hardware(&hw);
+  cria_hardware(&hw, &op);
   // cria o sistema operacional
-  so = so_cria(hw.cpu, hw.mem, hw.mmu, hw.es, hw.console);
-  
+  so = so_cria(hw.cpu, hw.mem, hw.mmu, hw.es, hw.console, &op.param_so);
+  so_define_perfil(so, hw.perfil);
+
+  estado_maquina_t maq = {
+    .mem = hw.mem, .mmu = hw.mmu, .cpu = hw.cpu, .relogio = hw.relogio,
+    .disco = hw.disco, .ci = hw.ci, .console = hw.console,
+    .controle = hw.controle, .so = so,
+  };
+  if (op.arquivo_restaura != NULL && !estado_restaura(&maq, op.arquivo_restaura)) {
+    fprintf(stderr, "ERRO: não foi possível restaurar o estado de '%s'\n",
+            op.arquivo_restaura);
+    exit(1);
+  }
+
   // executa o laço principal do controlador
   controle_laco(hw.controle);
 
+  if (op.arquivo_grava != NULL && !estado_grava(&maq, op.arquivo_grava)) {
+    fprintf(stderr, "ERRO: não foi possível gravar o estado em '%s'\n",
+            op.arquivo_grava);
+  }
+  // depois de gravar o estado, para a execução continuada com -r não contar
+  //   duas vezes o que é calculado no final
+  so_encerra(so);
+
+  if (hw.perfil != NULL && !perfil_grava(hw.perfil, op.prefixo_perfil)) {
+    fprintf(stderr, "ERRO: não foi possível gravar o perfil '%s'\n", op.prefixo_perfil);
+  }
+
   // destroi tudo
   so_destroi(so);
   destroi_hardware(&hw);
@@ -0,0 +1,105 @@
+// maqbin.h
+// formato binário dos arquivos '.maq'
+// simulador de computador
+// so24b
+
+#ifndef MAQBIN_H
+#define MAQBIN_H
+
+// além do formato texto ("MAQ tam carga" seguido de linhas "[end] = v, v,"),
+//   o montador gera (com a opção '-b') um formato binário, que pode ser
+//   mapeado na memória (mmap) e usado diretamente, sem interpretar texto
+// todos os números são inteiros de 32 bits, na ordem de bytes da máquina
+//   que gerou o arquivo (o arquivo não é portável entre máquinas diferentes)
+// o arquivo tem:
+//   - o cabeçalho (maqbin_cabecalho_t), no início
+//   - a tabela de seções (n_secoes maqbin_secao_t), logo após o cabeçalho,
+//     em ordem crescente de endereço e sem sobreposição
+//   - os dados das seções do tipo MAQBIN_DADOS, em 'deslocamento' bytes a
+//     partir do início do arquivo
+//   - a tabela de símbolos (n_simbolos maqbin_simbolo_t), opcional, em
+//     'desl_simbolos' bytes a partir do início do arquivo
+//   - a tabela de relocação (n_relocacoes int32_t), em 'desl_relocacoes'
+//     bytes a partir do início do arquivo: os endereços, em ordem crescente,
+//     das posições que contêm o endereço de um rótulo do programa; só é
+//     válida se MAQBIN_RELOCAVEL estiver em 'flags'
+//   - a tabela de linhas (n_linhas maqbin_linha_t), opcional, em
+//     'desl_linhas' bytes a partir do início do arquivo: para cada linha do
+//     fonte que gerou alguma coisa na memória, o endereço do que ela gerou,
+//     em ordem crescente de endereço
+//   - o nome do arquivo fonte, terminado por '\0', em 'desl_fonte' bytes a
+//     partir do início do arquivo (-1 se não tiver)
+// as posições do programa que não estão em nenhuma seção valem 0
+// um programa relocável pode ser carregado em um endereço diferente de
+//   'carga': somando a diferença ao valor das posições da tabela de relocação
+
+#include <stdint.h>
+
+// os 4 primeiros bytes do arquivo (o formato texto começa com "MAQ ")
+#define MAQBIN_MAGICA "MAQB"
+#define MAQBIN_VERSAO 3
+
+// bits de 'flags'
+// o programa tem tabela de relocação, e pode ser carregado em qualquer
+//   endereço
+#define MAQBIN_RELOCAVEL 1
+
+typedef struct {
+  char magica[4];
+  int32_t versao;
+  // endereço de carga e número de posições de memória do programa
+  int32_t carga;
+  int32_t tamanho;
+  // endereço inicial de execução
+  int32_t inicio;
+  int32_t flags;
+  int32_t n_secoes;
+  int32_t n_simbolos;
+  int32_t desl_simbolos;
+  int32_t n_relocacoes;
+  int32_t desl_relocacoes;
+  int32_t n_linhas;
+  int32_t desl_linhas;
+  int32_t desl_fonte;
+} maqbin_cabecalho_t;
+
+// tipos de seção
+enum {
+  // os valores estão no arquivo
+  MAQBIN_DADOS,
+  // só zeros, não ocupa espaço no arquivo (regiões 'espaco' grandes)
+  MAQBIN_ZEROS
+};
+
+typedef struct {
+  int32_t tipo;
+  int32_t endereco;
+  int32_t tamanho;
+  int32_t deslocamento;
+} maqbin_secao_t;
+
+// tamanho máximo do nome de um símbolo, incluindo o '\0'
+#define MAQBIN_TAM_NOME 28
+
+// tipos de símbolo
+enum {
+  // rótulo, o valor é um endereço do programa
+  MAQBIN_ROTULO,
+  // definido com 'define', o valor é uma constante
+  MAQBIN_CONSTANTE
+};
+
+typedef struct {
+  int32_t valor;
+  int32_t tipo;
+  char nome[MAQBIN_TAM_NOME];
+} maqbin_simbolo_t;
+
+// o que a linha 'linha' do fonte gerou começa no endereço 'endereco', e
+//   vai até o endereço da próxima entrada da tabela
+typedef struct {
+  int32_t endereco;
+  int32_t linha;
+} maqbin_linha_t;
+
+#endif // MAQBIN_H
@@ -7,11 +7,17 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/mman.h>
 
 // tipo de dados para representar uma região de memória
 struct mem_t {
   int tam;
   int *conteudo;
+  // true se o conteúdo é um arquivo mapeado (mem_mapeia_imagem)
+  bool mapeada;
+  // função a chamar quando a memória for alterada
+  mem_f_aviso_t f_aviso;
+  void *arg_aviso;
 };
 
 mem_t *mem_cria(int tam)
@@ -24,6 +30,9 @@ mem_t *mem_cria(int tam)
   assert(self->conteudo != NULL);
 
   self->tam = tam;
+  self->mapeada = false;
+  self->f_aviso = NULL;
+  self->arg_aviso = NULL;
 
   return self;
 }
@@ -31,7 +40,9 @@ mem_t *mem_cria(int tam)
 void mem_destroi(mem_t *self)
 {
   if (self != NULL) {
-    if (self->conteudo != NULL) {
+    if (self->mapeada) {
+      munmap(self->conteudo, self->tam * sizeof(*self->conteudo));
+    } else if (self->conteudo != NULL) {
       free(self->conteudo);
     }
     free(self);
@@ -66,6 +77,35 @@ err_t mem_escreve(mem_t *self, int endereco, int valor)
   err_t err = verifica_permissao(self, endereco);
   if (err == ERR_OK) {
     self->conteudo[endereco] = valor;
+    if (self->f_aviso != NULL) self->f_aviso(self->arg_aviso, endereco);
   }
   return err;
 }
+
+void mem_define_aviso_escrita(mem_t *self, mem_f_aviso_t f_aviso, void *arg)
+{
+  self->f_aviso = f_aviso;
+  self->arg_aviso = arg;
+}
+
+bool mem_grava_imagem(mem_t *self, FILE *arq)
+{
+  return fwrite(self->conteudo, sizeof(*self->conteudo), self->tam, arq)
+         == self->tam;
+}
+
+bool mem_mapeia_imagem(mem_t *self, int fd, off_t desl)
+{
+  size_t tam = self->tam * sizeof(*self->conteudo);
+  int *conteudo = mmap(NULL, tam, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                       fd, desl);
+  if (conteudo == MAP_FAILED) return false;
+  if (self->mapeada) {
+    munmap(self->conteudo, tam);
+  } else {
+    free(self->conteudo);
+  }
+  self->conteudo = conteudo;
+  self->mapeada = true;
+  return true;
+}
@@ -7,6 +7,9 @@
 #define MEMORIA_H
 
 #include "err.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
 
 // tipo opaco que representa a memória
 typedef struct mem_t mem_t;
@@ -31,4 +34,25 @@ err_t mem_le(mem_t *self, int endereco, int *pvalor);
 // retorna erro ERR_END_INV se endereço inválido
 err_t mem_escreve(mem_t *self, int endereco, int valor);
 
+// tipo da função chamada a cada alteração da memória
+typedef void (*mem_f_aviso_t)(void *arg, int endereco);
+
+// define uma função a ser chamada (com o argumento 'arg') a cada escrita
+//   bem sucedida na memória, com o endereço alterado
+// serve para quem mantém informação derivada do conteúdo da memória (como a
+//   cache de instruções decodificadas da CPU) saber quando ela fica velha
+// só tem uma função; NULL desliga o aviso
+void mem_define_aviso_escrita(mem_t *self, mem_f_aviso_t f_aviso, void *arg);
+
+// grava o conteúdo da memória no arquivo, como imagem (ver estado.h)
+// retorna false em caso de erro
+bool mem_grava_imagem(mem_t *self, FILE *arq);
+
+// substitui o conteúdo da memória pela imagem que está no arquivo 'fd' a
+//   partir do deslocamento 'desl' (múltiplo do tamanho de página), mapeando
+//   o arquivo em uma cópia privada: as alterações não vão para o arquivo
+// não chama a função de aviso de escrita
+// retorna false em caso de erro (a memória não é alterada)
+bool mem_mapeia_imagem(mem_t *self, int fd, off_t desl);
+
 #endif // MEMORIA_H
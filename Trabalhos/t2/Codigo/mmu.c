@@ -4,24 +4,58 @@
 // so24b
 
 #include "mmu.h"
+#include "estado.h"
 #include <stdlib.h>
 #include <assert.h>
 
+// uma entrada da TLB, com a tradução de uma página
+// os bits de acesso e alteração da entrada dizem se a tabela de páginas já
+//   foi marcada por um acesso feito através dessa entrada; enquanto
+//   estiverem ligados, não é necessário alterar a tabela de novo
+typedef struct {
+  // tabela de páginas de onde veio a tradução (NULL se a entrada está livre)
+  tabpag_t *tabpag;
+  int pagina;
+  int quadro;
+  bool acessada;
+  bool alterada;
+  // momento do último uso, para escolher a entrada a substituir (LRU)
+  long uso;
+} entrada_tlb_t;
+
 // tipo de dados opaco para representar uma MMU
 struct mmu_t {
   // memória física
   mem_t *mem;
+  // tamanho das páginas
+  int tam_pagina;
   // tabela de páginas
   tabpag_t *tabpag;
+  // TLB, com n_conjuntos conjuntos de n_vias entradas cada
+  // a página p só pode estar no conjunto p % n_conjuntos
+  entrada_tlb_t *tlb;
+  int n_conjuntos;
+  int n_vias;
+  // contador de acessos à TLB, para o LRU
+  long relogio_tlb;
+  // estatísticas
+  long acertos;
+  long faltas;
 };
 
-mmu_t *mmu_cria(mem_t *mem)
+mmu_t *mmu_cria(mem_t *mem, int tam_pagina)
 {
+  assert(tam_pagina > 0);
   mmu_t *self;
   self = malloc(sizeof(*self));
   assert(self != NULL);
   self->mem = mem;
+  self->tam_pagina = tam_pagina;
   self->tabpag = NULL;
+  self->tlb = NULL;
+  self->acertos = 0;
+  self->faltas = 0;
+  mmu_configura_tlb(self, TLB_ENTRADAS, TLB_VIAS);
   return self;
 }
 
@@ -29,30 +63,197 @@ void mmu_destroi(mmu_t *self)
 {
   if (self != NULL) {
     // nem a tabela de páginas nem a memória pertencem à MMU, não são liberadas aqui
+    free(self->tlb);
     free(self);
   }
 }
 
+mem_t *mmu_mem(mmu_t *self)
+{
+  return self->mem;
+}
+
+int mmu_tam_pagina(mmu_t *self)
+{
+  return self->tam_pagina;
+}
+
 void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag)
 {
   self->tabpag = tabpag;
 }
 
-// tradur o endereço virtual 'endvirt', colocando o endereço físico
-//   correspondente em 'pendfis'.
+// TLB {{{1
+
+void mmu_configura_tlb(mmu_t *self, int n_entradas, int n_vias)
+{
+  free(self->tlb);
+  self->tlb = NULL;
+  self->n_conjuntos = 0;
+  self->n_vias = 0;
+  self->relogio_tlb = 0;
+  if (n_entradas <= 0) return;
+  assert(n_vias > 0 && n_entradas % n_vias == 0);
+  self->tlb = calloc(n_entradas, sizeof(*self->tlb));
+  assert(self->tlb != NULL);
+  self->n_conjuntos = n_entradas / n_vias;
+  self->n_vias = n_vias;
+}
+
+// retorna o primeiro elemento do conjunto onde a página 'pagina' pode estar
+static entrada_tlb_t *mmu__conjunto(mmu_t *self, int pagina)
+{
+  return &self->tlb[(pagina % self->n_conjuntos) * self->n_vias];
+}
+
+// retorna a entrada da TLB com a tradução de 'pagina' na tabela atual,
+//   ou NULL se não estiver na TLB
+static entrada_tlb_t *mmu__busca_tlb(mmu_t *self, int pagina)
+{
+  entrada_tlb_t *conj = mmu__conjunto(self, pagina);
+  for (int i = 0; i < self->n_vias; i++) {
+    if (conj[i].tabpag == self->tabpag && conj[i].pagina == pagina) {
+      return &conj[i];
+    }
+  }
+  return NULL;
+}
+
+// escolhe a entrada a ser usada para a página 'pagina': uma livre se houver,
+//   senão a usada há mais tempo no conjunto
+static entrada_tlb_t *mmu__vitima_tlb(mmu_t *self, int pagina)
+{
+  entrada_tlb_t *conj = mmu__conjunto(self, pagina);
+  entrada_tlb_t *vitima = &conj[0];
+  for (int i = 0; i < self->n_vias; i++) {
+    if (conj[i].tabpag == NULL) return &conj[i];
+    if (conj[i].uso < vitima->uso) vitima = &conj[i];
+  }
+  return vitima;
+}
+
+void mmu_invalida_pagina(mmu_t *self, tabpag_t *tabpag, int pagina)
+{
+  if (self->tlb == NULL || pagina < 0) return;
+  entrada_tlb_t *conj = mmu__conjunto(self, pagina);
+  for (int i = 0; i < self->n_vias; i++) {
+    if (conj[i].tabpag == tabpag && conj[i].pagina == pagina) {
+      conj[i].tabpag = NULL;
+    }
+  }
+}
+
+void mmu_invalida_tabpag(mmu_t *self, tabpag_t *tabpag)
+{
+  int n_entradas = self->n_conjuntos * self->n_vias;
+  for (int i = 0; i < n_entradas; i++) {
+    if (self->tlb[i].tabpag == tabpag) {
+      self->tlb[i].tabpag = NULL;
+    }
+  }
+}
+
+void mmu_estatisticas_tlb(mmu_t *self, long *pacertos, long *pfaltas)
+{
+  *pacertos = self->acertos;
+  *pfaltas = self->faltas;
+}
+
+// estado {{{1
+
+bool mmu_grava_estado(mmu_t *self, FILE *arq, mmu_f_id_tabpag_t f_id, void *arg)
+{
+  int id = f_id(arg, self->tabpag);
+  if (!ESTADO_GRAVA(arq, id)
+      || !ESTADO_GRAVA(arq, self->n_conjuntos)
+      || !ESTADO_GRAVA(arq, self->n_vias)
+      || !ESTADO_GRAVA(arq, self->relogio_tlb)
+      || !ESTADO_GRAVA(arq, self->acertos)
+      || !ESTADO_GRAVA(arq, self->faltas)) {
+    return false;
+  }
+  int n_entradas = self->n_conjuntos * self->n_vias;
+  for (int i = 0; i < n_entradas; i++) {
+    // a entrada é gravada com o número da tabela no lugar do ponteiro
+    entrada_tlb_t ent = self->tlb[i];
+    id = f_id(arg, ent.tabpag);
+    ent.tabpag = NULL;
+    if (!ESTADO_GRAVA(arq, id) || !ESTADO_GRAVA(arq, ent)) return false;
+  }
+  return true;
+}
+
+bool mmu_le_estado(mmu_t *self, FILE *arq, mmu_f_tabpag_t f_tabpag, void *arg)
+{
+  int id, n_conjuntos, n_vias;
+  if (!ESTADO_LE(arq, id)
+      || !ESTADO_LE(arq, n_conjuntos)
+      || !ESTADO_LE(arq, n_vias)
+      || n_conjuntos != self->n_conjuntos
+      || n_vias != self->n_vias
+      || !ESTADO_LE(arq, self->relogio_tlb)
+      || !ESTADO_LE(arq, self->acertos)
+      || !ESTADO_LE(arq, self->faltas)) {
+    return false;
+  }
+  self->tabpag = f_tabpag(arg, id);
+  int n_entradas = self->n_conjuntos * self->n_vias;
+  for (int i = 0; i < n_entradas; i++) {
+    entrada_tlb_t *ent = &self->tlb[i];
+    if (!ESTADO_LE(arq, id) || !ESTADO_LE(arq, *ent)) return false;
+    ent->tabpag = f_tabpag(arg, id);
+  }
+  return true;
+}
+
+// tradução {{{1
+
+// traduz o endereço virtual 'endvirt', colocando o endereço físico
+//   correspondente em 'pendfis', e marca o acesso à página (e a alteração,
+//   se 'alteracao' for true)
+// usa a TLB se possível; em uma falta, consulta a tabela de páginas e coloca
+//   a tradução na TLB
 // retorna ERR_OK ou um erro se a tradução não for possível
-static err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis)
+static err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis, bool alteracao)
 {
-  int pagina = endvirt / TAM_PAGINA;
-  int deslocamento = endvirt % TAM_PAGINA;
-  int quadro;
-  err_t err = tabpag_traduz(self->tabpag, pagina, &quadro);
-  if (err == ERR_OK) {
-    *pendfis = quadro * TAM_PAGINA + deslocamento;
+  int pagina = endvirt / self->tam_pagina;
+  int deslocamento = endvirt % self->tam_pagina;
+  entrada_tlb_t *ent = NULL;
+  if (self->tlb != NULL && endvirt >= 0) {
+    ent = mmu__busca_tlb(self, pagina);
   }
-  return err;
+  if (ent != NULL) {
+    self->acertos++;
+  } else {
+    self->faltas++;
+    int quadro;
+    err_t err = tabpag_traduz(self->tabpag, pagina, &quadro);
+    if (err != ERR_OK) return err;
+    if (self->tlb == NULL || endvirt < 0) {
+      tabpag_marca_bit_acesso(self->tabpag, pagina, alteracao);
+      *pendfis = quadro * self->tam_pagina + deslocamento;
+      return ERR_OK;
+    }
+    ent = mmu__vitima_tlb(self, pagina);
+    ent->tabpag = self->tabpag;
+    ent->pagina = pagina;
+    ent->quadro = quadro;
+    ent->acessada = false;
+    ent->alterada = false;
+  }
+  ent->uso = ++self->relogio_tlb;
+  // só altera a tabela de páginas se esta entrada ainda não marcou os bits
+  if (!ent->acessada || (alteracao && !ent->alterada)) {
+    tabpag_marca_bit_acesso(self->tabpag, pagina, alteracao);
+    ent->acessada = true;
+    if (alteracao) ent->alterada = true;
+  }
+  *pendfis = ent->quadro * self->tam_pagina + deslocamento;
+  return ERR_OK;
 }
 
+// acesso à memória {{{1
+
 err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
 {
   // em modo supervisor ou se não tiver tabela de páginas,
@@ -61,12 +262,9 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
     return mem_le(self->mem, endvirt, pvalor);
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  err_t err = mmu__traduz(self, endvirt, &endfis, false);
   if (err == ERR_OK) {
     err = mem_le(self->mem, endfis, pvalor);
-    if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, false);
-    }
   }
   return err;
 }
@@ -79,12 +277,18 @@ err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo)
     return mem_escreve(self->mem, endvirt, valor);
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  err_t err = mmu__traduz(self, endvirt, &endfis, true);
   if (err == ERR_OK) {
     err = mem_escreve(self->mem, endfis, valor);
-    if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, true);
-    }
   }
   return err;
 }
+
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo)
+{
+  if (modo == supervisor || self->tabpag == NULL) {
+    *pendfis = endvirt;
+    return ERR_OK;
+  }
+  return mmu__traduz(self, endvirt, pendfis, false);
+}
@@ -10,6 +10,10 @@
 // realiza a tradução de endereços virtuais do espaço de endereçamento
 //   de um processo em endereços físicos da memória principal
 // implementa memória virtual por paginação
+// as traduções mais recentes são mantidas em uma TLB, para evitar consultar
+//   a tabela de páginas a cada acesso
+// cada entrada da TLB é marcada com a tabela de páginas que a originou (faz o
+//   papel de ASID), então a TLB não precisa ser esvaziada na troca de tabela
 
 // tipo opaco que representa a MMU
 typedef struct mmu_t mmu_t;
@@ -18,29 +22,84 @@ typedef struct mmu_t mmu_t;
 #include "memoria.h"
 #include "err.h"
 #include "cpu.h"
+#include <stdio.h>
 
-// tamanho de uma página, em palavras de memória
-// t2: pode ser alterado para comparar configurações diferentes
+// tamanho padrão de uma página, em palavras de memória
+// t2: o tamanho usado é definido na criação da MMU, para comparar
+//   configurações diferentes
 #define TAM_PAGINA 10
 
+// configuração inicial da TLB: número de entradas e de vias (associatividade)
+// com TLB_VIAS igual a TLB_ENTRADAS a TLB é totalmente associativa
+// pode ser alterado com mmu_configura_tlb (opções -E e -V do main)
+#define TLB_ENTRADAS 16
+#define TLB_VIAS 4
+
 // cria uma MMU para gerenciar acessos à memória
 // retorna um ponteiro para um descritor, que deverá ser usado em todas
 //   as operações nessa MMU
-// recebe 'mem', a memória física que será gerenciada
+// recebe 'mem', a memória física que será gerenciada, e o tamanho das
+//   páginas, em palavras
 // mata o programa em caso de erro (malloc)
-mmu_t *mmu_cria(mem_t *mem);
+mmu_t *mmu_cria(mem_t *mem, int tam_pagina);
 
 // destrói uma MMU
 // nenhuma outra operação pode ser realizada na MMU após esta chamada
 void mmu_destroi(mmu_t *self);
 
+// retorna a memória física gerenciada pela MMU
+mem_t *mmu_mem(mmu_t *self);
+
+// retorna o tamanho das páginas, em palavras
+int mmu_tam_pagina(mmu_t *self);
+
 // define a tabela de páginas a usar nas próximas traduções
 // se tabpag for NULL, os acessos serão repassados sem alteração à memória
+// as entradas da TLB de outras tabelas não são perdidas
 void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag);
 
+// reconfigura a TLB para ter 'n_entradas' entradas, organizadas em conjuntos
+//   de 'n_vias' entradas cada (n_entradas deve ser múltiplo de n_vias)
+// com 'n_entradas' igual a 0 a TLB é desligada, toda tradução consulta a
+//   tabela de páginas
+// a TLB é esvaziada, as estatísticas não são alteradas
+void mmu_configura_tlb(mmu_t *self, int n_entradas, int n_vias);
+
+// esquece a tradução da página 'pagina' da tabela 'tabpag' que estiver na TLB
+// deve ser chamada quando o SO alterar a página na tabela (mudar o quadro,
+//   invalidar ou zerar o bit de acesso), para que a alteração seja vista
+void mmu_invalida_pagina(mmu_t *self, tabpag_t *tabpag, int pagina);
+
+// esquece todas as traduções da tabela 'tabpag' que estiverem na TLB
+// deve ser chamada antes de destruir uma tabela de páginas, porque uma nova
+//   tabela pode ser alocada no mesmo endereço
+void mmu_invalida_tabpag(mmu_t *self, tabpag_t *tabpag);
+
+// coloca em '*pacertos' e '*pfaltas' o número de traduções feitas pela TLB
+//   e o de traduções que precisaram consultar a tabela de páginas, desde a
+//   criação da MMU
+// os valores são cumulativos; para contar por processo, o SO deve guardar
+//   os valores na troca de processo e calcular a diferença
+void mmu_estatisticas_tlb(mmu_t *self, long *pacertos, long *pfaltas);
+
+// a MMU não sabe a quem pertencem as tabelas de páginas que usa; para gravar
+//   e ler seu estado (ver estado.h), quem as criou identifica cada uma por um
+//   número (-1 para NULL), com as funções abaixo
+typedef int (*mmu_f_id_tabpag_t)(void *arg, tabpag_t *tabpag);
+typedef tabpag_t *(*mmu_f_tabpag_t)(void *arg, int id);
+
+// grava no arquivo o estado da MMU (tabela de páginas atual, conteúdo da TLB
+//   e estatísticas), identificando as tabelas com 'f_id', ou lê o estado
+//   gravado, obtendo as tabelas com 'f_tabpag'
+// a TLB deve ter a mesma configuração da gravada
+// retornam false em caso de erro
+bool mmu_grava_estado(mmu_t *self, FILE *arq, mmu_f_id_tabpag_t f_id, void *arg);
+bool mmu_le_estado(mmu_t *self, FILE *arq, mmu_f_tabpag_t f_tabpag, void *arg);
+
 // coloca na posição apontada por 'pvalor' o valor que está na memória
 //   no endereço físico correspondente ao endereço virtual 'endvirt'
-// marca a página como acessada se o acesso for bem sucedido
+// marca a página como acessada se a tradução for bem sucedida (a tabela de
+//   páginas só é alterada no primeiro acesso feito por uma entrada da TLB)
 // retorna erro se acesso não for possível, por um erro de tradução
 //   (ver tabpag_traduz) ou de memória (ver mem_le)
 // se o acesso for feito em modo supervisor, ou se a mmu não tiver tabela de
@@ -50,7 +109,7 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
 
 // coloca 'valor' no endereço físico da memória correspondente ao endereço
 //   virtual 'endvirt'
-// marca a página como acessada e alterada se o acesso for bem sucedido
+// marca a página como acessada e alterada se a tradução for bem sucedida
 // retorna erro se acesso não for possível, por um erro de tradução
 //   (ver tabpag_traduz) ou de memória (ver mem_escreve)
 // se o acesso for feito em modo supervisor, ou se a mmu não tiver tabela de
@@ -58,4 +117,12 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
 //   à memória sem tradução
 err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo);
 
+// coloca em '*pendfis' o endereço físico correspondente ao endereço virtual
+//   'endvirt', para um acesso de leitura (marca a página como acessada)
+// retorna erro se a tradução não for possível (ver tabpag_traduz)
+// em modo supervisor ou sem tabela de páginas, o endereço não é traduzido
+// não verifica se o endereço físico existe na memória
+// serve para a CPU buscar instruções sem ler a memória (ver cpu.c)
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo);
+
 #endif // MMU_H
@@ -5,6 +5,7 @@
 
 // INCLUDES {{{1
 #include "instrucao.h"
+#include "maqbin.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,24 +35,38 @@ bool tem_numero(char *s, int *num)
   return false;
 }
 
+// garante que o vetor 'vet', com '*pcap' elementos de 'tam' bytes, tenha
+//   espaço para pelo menos 'n' elementos, dobrando a capacidade se precisar
+// retorna o vetor, que pode ter mudado de lugar
+void *garante_capacidade(void *vet, int *pcap, int n, size_t tam)
+{
+  if (n <= *pcap) return vet;
+  int cap = *pcap == 0 ? 1024 : *pcap;
+  while (cap < n) cap *= 2;
+  vet = realloc(vet, cap * tam);
+  if (vet == NULL) erro_brabo("sem memória");
+  *pcap = cap;
+  return vet;
+}
+
 // MEMÓRIA DE SAÍDA {{{1
 
 // representa a memória do programa -- a saída do montador é colocada aqui
+// cresce conforme o programa precisa
 
-#define MEM_TAM 10000    // aumentar para programas maiores
-int mem[MEM_TAM];
+int *mem;
+int mem_cap;            // número de posições alocadas em mem
 int mem_pos = 0;        // próxima posição livre da memória
 int mem_min = -1;       // menor endereço preenchido
 int mem_max = -1;       // maior endereço preenchido
 
 char *nome_fonte;   // nome do arquivo fonte a montar
+bool saida_binaria; // gera o .maq no formato binário (ver maqbin.h)
 
 // coloca um valor no final da memória
 void mem_insere(int val)
 {
-  if (mem_pos >= MEM_TAM-1) {
-    erro_brabo("programa muito grande! Aumente MEM_TAM no montador.");
-  }
+  mem = garante_capacidade(mem, &mem_cap, mem_pos + 1, sizeof(*mem));
   if (mem_min == -1 || mem_pos < mem_min) mem_min = mem_pos;
   if (mem_max == -1 || mem_pos > mem_max) mem_max = mem_pos;
   mem[mem_pos++] = val;
@@ -66,7 +81,40 @@ void mem_altera(int pos, int val)
   mem[pos] = val;
 }
 
+// tabela de relocação -- endereços da memória que contêm o endereço de um
+//   rótulo, em ordem crescente; para carregar o programa em outro endereço,
+//   basta corrigir essas posições
+
+int *reloc;
+int reloc_cap;
+int reloc_num;
+
+void reloc_nova(int endereco)
+{
+  reloc = garante_capacidade(reloc, &reloc_cap, reloc_num + 1,
+                             sizeof(*reloc));
+  reloc[reloc_num++] = endereco;
+}
+
+// tabela de linhas -- para cada linha do fonte que gera alguma coisa na
+//   memória, o endereço onde começa o que ela gerou (em ordem crescente)
+
+maqbin_linha_t *linhas;
+int linhas_cap;
+int linhas_num;
+
+void linha_nova(int endereco, int linha)
+{
+  linhas = garante_capacidade(linhas, &linhas_cap, linhas_num + 1,
+                              sizeof(*linhas));
+  linhas[linhas_num].endereco = endereco;
+  linhas[linhas_num].linha = linha;
+  linhas_num++;
+}
+
 // imprime o conteúdo da memória
+// a tabela de relocação vai no final, com "REL n" seguido de linhas
+//   "R = end, end,"
 void mem_imprime(void)
 {
   printf("MAQ %d %d\n", mem_max - mem_min + 1, mem_min);
@@ -77,44 +125,103 @@ void mem_imprime(void)
     }
     printf("\n");
   }
+  printf("REL %d\n", reloc_num);
+  for (int i = 0; i < reloc_num; i+=10) {
+    printf("R =");
+    for (int j = i; j < i+10 && j < reloc_num; j++) {
+      printf(" %d,", reloc[j]);
+    }
+    printf("\n");
+  }
 }
 
 // SÍMBOLOS {{{1
 
 // tabela com os símbolos (labels) já definidos pelo programa, e o valor (endereço) deles
+// os símbolos ficam em um vetor, na ordem em que foram definidos; para
+//   encontrar um símbolo pelo nome tem um hash com endereçamento aberto,
+//   com o índice do símbolo no vetor (-1 nas entradas vazias)
 
-#define SIMB_TAM 1000
-struct {
+struct simbolo_t {
   char *nome;
   int valor;
-} simbolo[SIMB_TAM];
+  bool rotulo;    // false se definido com 'define'
+} *simbolo;
+int simb_cap;
 int simb_num;             // número d símbolos na tabela
 
+int *simb_hash;
+int simb_hash_tam;        // potência de 2, pelo menos o dobro de simb_num
+
+// FNV-1a
+unsigned simb_espalha(char *nome)
+{
+  unsigned h = 2166136261u;
+  for (; *nome != '\0'; nome++) {
+    h = (h ^ (unsigned char)*nome) * 16777619u;
+  }
+  return h;
+}
+
+// retorna a posição do hash onde está o símbolo, ou a posição vazia onde
+//   ele deve ser colocado
+int simb_posicao_hash(char *nome)
+{
+  int mascara = simb_hash_tam - 1;
+  int pos = simb_espalha(nome) & mascara;
+  while (simb_hash[pos] != -1 && strcmp(simbolo[simb_hash[pos]].nome, nome) != 0) {
+    pos = (pos + 1) & mascara;
+  }
+  return pos;
+}
+
+// dobra o tamanho do hash e recoloca todos os símbolos
+void simb_aumenta_hash(void)
+{
+  free(simb_hash);
+  simb_hash_tam = simb_hash_tam == 0 ? 1024 : 2 * simb_hash_tam;
+  simb_hash = malloc(simb_hash_tam * sizeof(*simb_hash));
+  if (simb_hash == NULL) erro_brabo("sem memória");
+  for (int i = 0; i < simb_hash_tam; i++) simb_hash[i] = -1;
+  for (int i = 0; i < simb_num; i++) {
+    simb_hash[simb_posicao_hash(simbolo[i].nome)] = i;
+  }
+}
+
+// retorna o símbolo com esse nome, ou NULL se não existir na tabela
+struct simbolo_t *simb_procura(char *nome)
+{
+  if (simb_num == 0) return NULL;
+  int i = simb_hash[simb_posicao_hash(nome)];
+  return i == -1 ? NULL : &simbolo[i];
+}
+
 // retorna o valor de um símbolo, ou -1 se não existir na tabela
 int simb_valor(char *nome)
 {
-  for (int i=0; i<simb_num; i++) {
-    if (strcmp(nome, simbolo[i].nome) == 0) {
-      return simbolo[i].valor;
-    }
-  }
-  return -1;
+  struct simbolo_t *simb = simb_procura(nome);
+  return simb == NULL ? -1 : simb->valor;
 }
 
 // insere um novo símbolo na tabela
-void simb_novo(char *nome, int valor)
+void simb_novo(char *nome, int valor, bool rotulo)
 {
   if (nome == NULL) return;
-  if (simb_valor(nome) != -1) {
+  if (simb_procura(nome) != NULL) {
     fprintf(stderr, "ERRO: redefinicao do simbolo '%s'\n", nome);
     return;
   }
-  if (simb_num >= SIMB_TAM) {
-    erro_brabo("Excesso de símbolos. Aumente SIMB_TAM no montador.");
-  }
+  simbolo = garante_capacidade(simbolo, &simb_cap, simb_num + 1,
+                               sizeof(*simbolo));
   simbolo[simb_num].nome = strdup(nome);
   simbolo[simb_num].valor = valor;
+  simbolo[simb_num].rotulo = rotulo;
   simb_num++;
+  if (2 * simb_num > simb_hash_tam) {
+    simb_aumenta_hash();
+  } else {
+    simb_hash[simb_posicao_hash(nome)] = simb_num - 1;
+  }
 }
 
 
@@ -123,21 +230,19 @@ void simb_novo(char *nome, int valor)
 // tabela com referências a símbolos
 //   contém a linha e o endereço correspondente onde o símbolo foi referenciado
 
-#define REF_TAM 1000
 struct {
   char *nome;
   int linha;
   int endereco;
-} ref[REF_TAM];
+} *ref;
+int ref_cap;
 int ref_num;      // numero de referências criadas
 
 // insere uma nova referência na tabela
 void ref_nova(char *nome, int linha, int endereco)
 {
   if (nome == NULL) return;
-  if (ref_num >= REF_TAM) {
-    erro_brabo("excesso de referências. Aumente REF_TAM no montador.");
-  }
+  ref = garante_capacidade(ref, &ref_cap, ref_num + 1, sizeof(*ref));
   ref[ref_num].nome = strdup(nome);
   ref[ref_num].linha = linha;
   ref[ref_num].endereco = endereco;
@@ -146,16 +251,22 @@ void ref_nova(char *nome, int linha, int endereco)
 
 // resolve as referências -- para cada referência, coloca o valor do símbolo
 //   no endereço onde ele é referenciado
+// as referências a rótulos entram na tabela de relocação; as referências
+//   estão na ordem em que aparecem no programa, então a tabela fica ordenada
 void ref_resolve(void)
 {
   for (int i=0; i<ref_num; i++) {
-    int valor = simb_valor(ref[i].nome);
-    if (valor == -1) {
+    struct simbolo_t *simb = simb_procura(ref[i].nome);
+    int valor = -1;
+    if (simb == NULL) {
       fprintf(stderr, 
               "ERRO: simbolo '%s' referenciado na linha %d não foi definido\n",
               ref[i].nome, ref[i].linha);
+    } else {
+      valor = simb->valor;
     }
     mem_altera(ref[i].endereco, valor);
+    if (simb != NULL && simb->rotulo) reloc_nova(ref[i].endereco);
   }
 }
 
@@ -219,7 +330,7 @@ void monta_define(int linha, char *label, char *arg)
     fprintf(stderr, "ERRO: linha %d 'DEFINE' exige valor numérico\n", linha);
   } else {
     // tudo OK, define o símbolo
-    simb_novo(label, argn);
+    simb_novo(label, argn, false);
   }
 }
 
@@ -236,7 +347,7 @@ void monta_linha(int linha, char *label, char *instrucao, char *arg)
   
   // cria símbolo correspondente ao label, se for o caso
   if (label != NULL) {
-    simb_novo(label, mem_pos);
+    simb_novo(label, mem_pos, true);
   }
   
   // verifica a existência de instrução e número correto de argumentos
@@ -258,7 +369,9 @@ void monta_linha(int linha, char *label, char *instrucao, char *arg)
     return;
   }
   // tudo OK, monta a instrução
+  int pos = mem_pos;
   monta_instrucao(linha, opcode, arg);
+  if (mem_pos > pos) linha_nova(pos, linha);
 }
 
 // retorna true se o caractere for um espaço (ou tab)
@@ -371,6 +484,113 @@ void monta_arquivo(char *nome)
   ref_resolve();
 }
 
+// SAÍDA BINÁRIA {{{1
+
+// sequências de zeros com pelo menos esse tamanho viram seções MAQBIN_ZEROS
+#define MIN_ZEROS 32
+
+// retorna o tamanho da sequência de zeros que começa em 'pos'
+int conta_zeros(int pos)
+{
+  int n = 0;
+  while (pos + n <= mem_max && mem[pos + n] == 0) n++;
+  return n;
+}
+
+// divide a memória em seções; preenche 'secao' (se não for NULL) e
+//   retorna o número de seções
+// os deslocamentos dos dados começam em 'desl'
+int monta_secoes(maqbin_secao_t *secao, int desl)
+{
+  int n = 0;
+  int pos = mem_min;
+  while (pos <= mem_max) {
+    int zeros = conta_zeros(pos);
+    int tipo = zeros >= MIN_ZEROS ? MAQBIN_ZEROS : MAQBIN_DADOS;
+    int tam = zeros;
+    if (tipo == MAQBIN_DADOS) {
+      // a seção de dados vai até a próxima sequência grande de zeros
+      tam = 0;
+      while (pos + tam <= mem_max) {
+        zeros = conta_zeros(pos + tam);
+        if (zeros >= MIN_ZEROS) break;
+        tam += zeros > 0 ? zeros : 1;
+      }
+    }
+    if (secao != NULL) {
+      secao[n].tipo = tipo;
+      secao[n].endereco = pos;
+      secao[n].tamanho = tam;
+      secao[n].deslocamento = tipo == MAQBIN_DADOS ? desl : 0;
+    }
+    if (tipo == MAQBIN_DADOS) desl += tam * sizeof(int32_t);
+    pos += tam;
+    n++;
+  }
+  return n;
+}
+
+void escreve(void *dados, size_t tam)
+{
+  if (fwrite(dados, 1, tam, stdout) != tam) {
+    erro_brabo("erro na escrita da saída");
+  }
+}
+
+// grava a memória no formato binário
+void mem_grava_binario(void)
+{
+  maqbin_cabecalho_t cab;
+  memcpy(cab.magica, MAQBIN_MAGICA, sizeof(cab.magica));
+  cab.versao = MAQBIN_VERSAO;
+  cab.carga = mem_min;
+  cab.tamanho = mem_max - mem_min + 1;
+  cab.inicio = mem_min;
+  cab.flags = MAQBIN_RELOCAVEL;
+  cab.n_secoes = monta_secoes(NULL, 0);
+  cab.n_simbolos = simb_num;
+
+  int desl_dados = sizeof(cab) + cab.n_secoes * sizeof(maqbin_secao_t);
+  maqbin_secao_t secao[cab.n_secoes];
+  monta_secoes(secao, desl_dados);
+  cab.desl_simbolos = desl_dados;
+  for (int i = 0; i < cab.n_secoes; i++) {
+    if (secao[i].tipo == MAQBIN_DADOS) {
+      cab.desl_simbolos += secao[i].tamanho * sizeof(int32_t);
+    }
+  }
+  cab.n_relocacoes = reloc_num;
+  cab.desl_relocacoes = cab.desl_simbolos + simb_num * sizeof(maqbin_simbolo_t);
+  cab.n_linhas = linhas_num;
+  cab.desl_linhas = cab.desl_relocacoes + reloc_num * sizeof(int32_t);
+  cab.desl_fonte = cab.desl_linhas + linhas_num * sizeof(maqbin_linha_t);
+
+  escreve(&cab, sizeof(cab));
+  escreve(secao, sizeof(secao));
+  for (int i = 0; i < cab.n_secoes; i++) {
+    if (secao[i].tipo != MAQBIN_DADOS) continue;
+    for (int pos = secao[i].endereco; pos < secao[i].endereco + secao[i].tamanho; pos++) {
+      int32_t v = mem[pos];
+      escreve(&v, sizeof(v));
+    }
+  }
+  for (int i = 0; i < simb_num; i++) {
+    maqbin_simbolo_t simb;
+    memset(&simb, 0, sizeof(simb));
+    simb.valor = simbolo[i].valor;
+    simb.tipo = simbolo[i].rotulo ? MAQBIN_ROTULO : MAQBIN_CONSTANTE;
+    // nomes muito grandes são truncados
+    strncpy(simb.nome, simbolo[i].nome, MAQBIN_TAM_NOME - 1);
+    escreve(&simb, sizeof(simb));
+  }
+  for (int i = 0; i < reloc_num; i++) {
+    int32_t end = reloc[i];
+    escreve(&end, sizeof(end));
+  }
+  escreve(linhas, linhas_num * sizeof(*linhas));
+  escreve(nome_fonte, strlen(nome_fonte) + 1);
+}
+
 // MAIN {{{1
 
 void verifica_args(int argc, char *argv[argc])
@@ -388,12 +608,14 @@ void verifica_args(int argc, char *argv[argc])
         fprintf(stderr, "ERRO: endereço inválido: '%s'\n", argv[argi]);
         exit(1);
       }
+    } else if (strcmp(argv[argi], "-b") == 0) {
+      saida_binaria = true;
     } else {
       nome_fonte = argv[argi];
     }
   }
   if (nome_fonte == NULL) {
-    fprintf(stderr, "ERRO: chame como '%s [-e end.inicial] nome_do_arquivo'\n",
+    fprintf(stderr, "ERRO: chame como '%s [-b] [-e end.inicial] nome_do_arquivo'\n",
             argv[0]);
     exit(1);
   }
@@ -403,7 +625,11 @@ int main(int argc, char *argv[argc])
 {
   verifica_args(argc, argv);
   monta_arquivo(nome_fonte);
-  mem_imprime();
+  if (saida_binaria) {
+    mem_grava_binario();
+  } else {
+    mem_imprime();
+  }
   return 0;
 }
 
@@ -15,6 +15,7 @@ SO_ESCR        define 2
 SO_CRIA_PROC   define 7
 SO_MATA_PROC   define 8
 SO_ESPERA_PROC define 9
+SO_ESCR_BLOCO  define 11
 
 main
          chama impr_inicio
@@ -24,6 +25,7 @@ main
          para
 
 morre    espaco 1
+         chama descarrega
          cargi 0
          trax
          cargi SO_MATA_PROC
@@ -75,20 +77,58 @@ impstr1
          desv impstr1
 impstrf  ret impstr
 
-; função que chama o SO para imprimir o caractere em A
-; retorna em A o código de erro do SO
+; função que coloca o caractere em A no buffer de saída
+; o buffer é escrito com uma chamada ao SO quando recebe um fim de linha ou
+;   quando enche (ver descarrega)
 ; não altera o valor de X
 impch    espaco 1
          trax
-         armm impch_X
-         cargi SO_ESCR
-         chamas
-         trax
-         cargm impch_X
+         armm impch_X     ; salva o X e coloca o caractere em X
+         cargm sai_n
+         trax             ; A = caractere, X = caracteres no buffer
+         armx sai_buf
+         incx
+         trax             ; A = caracteres no buffer, X = caractere
+         armm sai_n
+         sub sai_tam
+         desvz impch_d
+         cpxa
+         sub fim_linha
+         desvnz impch_f
+impch_d  chama descarrega
+impch_f  cargm impch_X
          trax
          ret impch
 impch_X  espaco 1 ; para salvar o valor de X
 
+; escreve o buffer de saída com uma chamada ao SO e esvazia o buffer
+; não altera o valor de X
+descarrega espaco 1
+         cpxa
+         armm desc_X
+         cargm sai_n
+         desvz desc_f
+         armm sai_par_n
+         cargi sai_buf
+         armm sai_par
+         cargi sai_par
+         trax
+         cargi SO_ESCR_BLOCO
+         chamas
+         cargi 0
+         armm sai_n
+desc_f   cargm desc_X
+         trax
+         ret descarrega
+desc_X   espaco 1
+; parâmetros de SO_ESCR_BLOCO: endereço do buffer e número de caracteres
+sai_par  espaco 1
+sai_par_n espaco 1
+sai_n    valor 0
+sai_tam  valor 80
+fim_linha valor 10
+sai_buf  espaco 80
+
 ; escreve o valor de A no terminal, em decimal
 impnum  espaco 1
         ; ei_num = A
@@ -0,0 +1,364 @@
+// perfil.c
+// perfilador das instruções executadas pela CPU
+// simulador de computador
+// so24b
+
+#include "perfil.h"
+#include "programa.h"
+#include "instrucao.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// nó do grafo de chamadas de um programa
+// cada nó representa uma pilha de chamadas: a função 'funcao' (endereço do
+//   rótulo chamado por CHAMA) chamada a partir da pilha do nó pai; a raiz
+//   representa o código fora de qualquer função
+typedef struct no_t no_t;
+struct no_t {
+  int funcao;
+  // instruções executadas com exatamente essa pilha
+  long contagem;
+  no_t *pai;
+  no_t *filhos;
+  no_t *irmao;
+};
+
+// contagens de um programa, indexadas pelo endereço no programa montado
+typedef struct {
+  char *nome;
+  // NULL se não foi possível ler o arquivo
+  programa_t *prog;
+  int carga;
+  int tam;
+  long *execucoes;
+  long *faltas;
+  long *chamadas_sistema;
+  // alocada à parte, porque os processos apontam para os nós e o vetor de
+  //   programas muda de lugar quando cresce
+  no_t *raiz;
+} perfil_prog_t;
+
+// um processo, executando um programa
+typedef struct {
+  // índice em programas, -1 se o pid não corresponde a um processo
+  int programa;
+  // diferença entre o endereço no programa montado e o endereço em que o
+  //   programa foi carregado
+  int deslocamento;
+  // pilha de chamadas corrente
+  no_t *no;
+} perfil_proc_t;
+
+struct perfil_t {
+  long por_opcode[N_OPCODE];
+  perfil_prog_t *programas;
+  int n_programas;
+  // processos, indexados pelo pid
+  perfil_proc_t *processos;
+  int n_processos;
+  // processo em execução (NULL antes do primeiro), e o que executa em modo
+  //   supervisor
+  perfil_proc_t *corrente;
+  perfil_proc_t supervisor;
+};
+
+perfil_t *perfil_cria(void)
+{
+  perfil_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  memset(self->por_opcode, 0, sizeof(self->por_opcode));
+  self->programas = NULL;
+  self->n_programas = 0;
+  self->processos = NULL;
+  self->n_processos = 0;
+  self->corrente = NULL;
+  self->supervisor.programa = -1;
+  return self;
+}
+
+static void perfil_libera_no(no_t *no)
+{
+  while (no->filhos != NULL) {
+    no_t *filho = no->filhos;
+    no->filhos = filho->irmao;
+    perfil_libera_no(filho);
+    free(filho);
+  }
+}
+
+void perfil_destroi(perfil_t *self)
+{
+  for (int i = 0; i < self->n_programas; i++) {
+    perfil_prog_t *p = &self->programas[i];
+    free(p->nome);
+    if (p->prog != NULL) prog_destroi(p->prog);
+    free(p->execucoes);
+    free(p->faltas);
+    free(p->chamadas_sistema);
+    perfil_libera_no(p->raiz);
+    free(p->raiz);
+  }
+  free(self->programas);
+  free(self->processos);
+  free(self);
+}
+
+// PROGRAMAS E PROCESSOS
+
+// retorna o índice do programa com esse nome, incluindo se não tiver
+static int perfil_programa(perfil_t *self, char *nome)
+{
+  for (int i = 0; i < self->n_programas; i++) {
+    if (strcmp(self->programas[i].nome, nome) == 0) return i;
+  }
+  self->programas = realloc(self->programas,
+                            (self->n_programas + 1) * sizeof(*self->programas));
+  assert(self->programas != NULL);
+  perfil_prog_t *p = &self->programas[self->n_programas];
+  p->nome = strdup(nome);
+  assert(p->nome != NULL);
+  p->prog = prog_cria(nome);
+  p->carga = p->prog == NULL ? 0 : prog_end_carga(p->prog);
+  p->tam = p->prog == NULL ? 0 : prog_tamanho(p->prog);
+  p->execucoes = calloc(p->tam + 1, sizeof(long));
+  p->faltas = calloc(p->tam + 1, sizeof(long));
+  p->chamadas_sistema = calloc(p->tam + 1, sizeof(long));
+  assert(p->execucoes != NULL && p->faltas != NULL && p->chamadas_sistema != NULL);
+  p->raiz = calloc(1, sizeof(*p->raiz));
+  assert(p->raiz != NULL);
+  p->raiz->funcao = -1;
+  return self->n_programas++;
+}
+
+static void perfil_inicia_proc(perfil_t *self, perfil_proc_t *proc,
+                               char *programa, int entrada)
+{
+  proc->programa = perfil_programa(self, programa);
+  perfil_prog_t *p = &self->programas[proc->programa];
+  proc->deslocamento = 0;
+  if (p->prog != NULL) proc->deslocamento = prog_end_inicio(p->prog) - entrada;
+  proc->no = p->raiz;
+}
+
+void perfil_define_supervisor(perfil_t *self, char *programa, int entrada)
+{
+  perfil_inicia_proc(self, &self->supervisor, programa, entrada);
+}
+
+void perfil_novo_processo(perfil_t *self, int pid, char *programa, int entrada)
+{
+  if (pid < 0) return;
+  if (pid >= self->n_processos) {
+    int n = self->n_processos == 0 ? 16 : self->n_processos;
+    while (n <= pid) n *= 2;
+    // 'corrente' aponta para o vetor que vai mudar de lugar
+    int corrente = self->corrente == NULL ? -1 : self->corrente - self->processos;
+    self->processos = realloc(self->processos, n * sizeof(*self->processos));
+    assert(self->processos != NULL);
+    for (int i = self->n_processos; i < n; i++) self->processos[i].programa = -1;
+    self->n_processos = n;
+    if (corrente != -1) self->corrente = &self->processos[corrente];
+  }
+  perfil_inicia_proc(self, &self->processos[pid], programa, entrada);
+}
+
+void perfil_fim_processo(perfil_t *self, int pid)
+{
+  if (pid < 0 || pid >= self->n_processos) return;
+  if (self->corrente == &self->processos[pid]) self->corrente = NULL;
+  self->processos[pid].programa = -1;
+}
+
+void perfil_muda_processo(perfil_t *self, int pid)
+{
+  self->corrente = NULL;
+  if (pid < 0 || pid >= self->n_processos) return;
+  if (self->processos[pid].programa == -1) return;
+  self->corrente = &self->processos[pid];
+}
+
+// CONTAGEM
+
+// nó filho de 'no' para a função 'funcao', criado se não existir
+static no_t *perfil_filho(no_t *no, int funcao)
+{
+  for (no_t *f = no->filhos; f != NULL; f = f->irmao) {
+    if (f->funcao == funcao) return f;
+  }
+  no_t *f = calloc(1, sizeof(*f));
+  assert(f != NULL);
+  f->funcao = funcao;
+  f->pai = no;
+  f->irmao = no->filhos;
+  no->filhos = f;
+  return f;
+}
+
+void perfil_instrucao(perfil_t *self, int pc, cpu_modo_t modo, int opcode,
+                      err_t erro, int novo_pc)
+{
+  perfil_proc_t *proc = modo == supervisor ? &self->supervisor : self->corrente;
+  if (opcode >= 0 && erro != ERR_PAG_AUSENTE) self->por_opcode[opcode]++;
+  if (proc == NULL || proc->programa == -1) return;
+  perfil_prog_t *p = &self->programas[proc->programa];
+
+  // endereço no programa montado; o que cai fora do programa é contado na
+  //   posição extra, no final dos vetores
+  int ender = pc + proc->deslocamento - p->carga;
+  if (ender < 0 || ender >= p->tam) ender = p->tam;
+
+  if (erro == ERR_PAG_AUSENTE) {
+    p->faltas[ender]++;
+    return;
+  }
+  if (opcode < 0) return;
+  p->execucoes[ender]++;
+  proc->no->contagem++;
+  if (erro != ERR_OK) return;
+  switch (opcode) {
+    case CHAMAS:
+      p->chamadas_sistema[ender]++;
+      break;
+    case CHAMA:
+      // CHAMA desvia para o endereço seguinte ao rótulo chamado
+      proc->no = perfil_filho(proc->no, novo_pc - 1 + proc->deslocamento);
+      break;
+    case RET:
+      if (proc->no->pai != NULL) proc->no = proc->no->pai;
+      break;
+  }
+}
+
+// SAÍDA
+
+// coloca em 'nome' o nome da função no endereço 'ender' do programa: o
+//   rótulo com esse valor, se tiver, ou o endereço
+static void perfil_nome_funcao(perfil_prog_t *p, int ender, char *nome, int tam)
+{
+  if (p->prog != NULL) {
+    for (int i = 0; i < prog_n_simbolos(p->prog); i++) {
+      int valor;
+      bool rotulo;
+      char *simb = prog_simbolo(p->prog, i, &valor, &rotulo);
+      if (rotulo && valor == ender) {
+        snprintf(nome, tam, "%s", simb);
+        return;
+      }
+    }
+  }
+  snprintf(nome, tam, "end_%d", ender);
+}
+
+// grava as pilhas a partir do nó 'no', cuja pilha está em 'pilha'
+static void perfil_grava_pilhas(FILE *arq, perfil_prog_t *p, no_t *no,
+                                char *pilha, int tam)
+{
+  int n = strlen(pilha);
+  if (no->funcao != -1) {
+    char nome[40];
+    perfil_nome_funcao(p, no->funcao, nome, sizeof(nome));
+    snprintf(pilha + n, tam - n, ";%s", nome);
+  }
+  if (no->contagem > 0) fprintf(arq, "%s %ld\n", pilha, no->contagem);
+  for (no_t *f = no->filhos; f != NULL; f = f->irmao) {
+    perfil_grava_pilhas(arq, p, f, pilha, tam);
+  }
+  pilha[n] = '\0';
+}
+
+// grava o fonte do programa com as contagens somadas por linha
+// retorna false se o programa não tiver tabela de linhas ou o fonte não
+//   puder ser lido
+static bool perfil_grava_fonte(FILE *arq, perfil_prog_t *p)
+{
+  if (p->prog == NULL || prog_fonte(p->prog) == NULL) return false;
+  FILE *fonte = fopen(prog_fonte(p->prog), "r");
+  if (fonte == NULL) return false;
+
+  // soma as contagens de cada linha
+  int n_linhas = 0;
+  for (int e = 0; e < p->tam; e++) {
+    int l = prog_linha(p->prog, e + p->carga);
+    if (l > n_linhas) n_linhas = l;
+  }
+  long (*por_linha)[3] = calloc(n_linhas + 1, sizeof(*por_linha));
+  assert(por_linha != NULL);
+  for (int e = 0; e < p->tam; e++) {
+    int l = prog_linha(p->prog, e + p->carga);
+    if (l < 0) continue;
+    por_linha[l][0] += p->execucoes[e];
+    por_linha[l][1] += p->faltas[e];
+    por_linha[l][2] += p->chamadas_sistema[e];
+  }
+
+  fprintf(arq, "fonte: %s\n", prog_fonte(p->prog));
+  // "execuções" tem 2 bytes a mais que caracteres
+  fprintf(arq, "%12s %7s %7s |\n", "execuções", "faltas", "chamas");
+  char *linha = NULL;
+  size_t tam_lin;
+  int l = 1;
+  while (getline(&linha, &tam_lin, fonte) != -1) {
+    if (l <= n_linhas && (por_linha[l][0] || por_linha[l][1] || por_linha[l][2])) {
+      fprintf(arq, "%10ld %7ld %7ld | %s",
+              por_linha[l][0], por_linha[l][1], por_linha[l][2], linha);
+    } else {
+      fprintf(arq, "%10s %7s %7s | %s", "", "", "", linha);
+    }
+    l++;
+  }
+  free(linha);
+  free(por_linha);
+  fclose(fonte);
+  return true;
+}
+
+// grava as contagens de cada endereço que tem alguma
+static void perfil_grava_enderecos(FILE *arq, perfil_prog_t *p)
+{
+  fprintf(arq, "%6s %12s %7s %7s\n", "end", "execuções", "faltas", "chamas");
+  for (int e = 0; e <= p->tam; e++) {
+    if (p->execucoes[e] == 0 && p->faltas[e] == 0) continue;
+    char end[10];
+    if (e == p->tam) {
+      strcpy(end, "fora");
+    } else {
+      snprintf(end, sizeof(end), "%d", e + p->carga);
+    }
+    fprintf(arq, "%6s %10ld %7ld %7ld\n",
+            end, p->execucoes[e], p->faltas[e], p->chamadas_sistema[e]);
+  }
+}
+
+bool perfil_grava(perfil_t *self, char *prefixo)
+{
+  char nome[200];
+  snprintf(nome, sizeof(nome), "%s.pilhas", prefixo);
+  FILE *arq = fopen(nome, "w");
+  if (arq == NULL) return false;
+  for (int i = 0; i < self->n_programas; i++) {
+    perfil_prog_t *p = &self->programas[i];
+    char pilha[1000];
+    snprintf(pilha, sizeof(pilha), "%s", p->nome);
+    perfil_grava_pilhas(arq, p, p->raiz, pilha, sizeof(pilha));
+  }
+  fclose(arq);
+
+  snprintf(nome, sizeof(nome), "%s.txt", prefixo);
+  arq = fopen(nome, "w");
+  if (arq == NULL) return false;
+  fprintf(arq, "EXECUÇÕES POR OPCODE\n");
+  for (int op = 0; op < N_OPCODE; op++) {
+    if (self->por_opcode[op] == 0) continue;
+    fprintf(arq, "  %-8s %10ld\n", instrucao_nome(op), self->por_opcode[op]);
+  }
+  for (int i = 0; i < self->n_programas; i++) {
+    perfil_prog_t *p = &self->programas[i];
+    fprintf(arq, "\nPROGRAMA %s\n", p->nome);
+    if (!perfil_grava_fonte(arq, p)) perfil_grava_enderecos(arq, p);
+  }
+  fclose(arq);
+  return true;
+}
@@ -0,0 +1,70 @@
+// perfil.h
+// perfilador das instruções executadas pela CPU
+// simulador de computador
+// so24b
+
+#ifndef PERFIL_H
+#define PERFIL_H
+
+// conta, para cada programa, quantas vezes cada instrução foi executada,
+//   quantas faltas de página e chamadas de sistema aconteceram em cada
+//   endereço, e monta o grafo de chamadas a partir das instruções CHAMA e RET
+// conta também as execuções de cada opcode, no total
+// a CPU informa cada instrução executada (perfil_instrucao); o SO informa
+//   qual programa cada processo executa e qual processo está executando,
+//   para que os endereços sejam atribuídos ao programa certo
+// as instruções executadas em modo supervisor são atribuídas ao programa
+//   definido com perfil_define_supervisor
+// os endereços são convertidos para os do programa montado, então o perfil
+//   de um programa relocado fica igual ao de um carregado no endereço em
+//   que foi montado
+// no final, grava:
+//   - 'prefixo.pilhas': as pilhas de chamadas no formato "colapsado" (uma
+//     linha "programa;função;função contagem" por pilha), que é o formato
+//     de entrada das ferramentas de flamegraph
+//   - 'prefixo.txt': as contagens por opcode e, para cada programa, a
+//     listagem do fonte anotada com as contagens de cada linha (se o
+//     programa tiver tabela de linhas, ver maqbin.h), ou as contagens de
+//     cada endereço
+
+#include "cpu.h"
+#include "err.h"
+
+typedef struct perfil_t perfil_t;
+
+// cria um perfilador sem nenhuma contagem
+// mata o programa em caso de erro (malloc)
+perfil_t *perfil_cria(void);
+
+// destrói o perfilador
+void perfil_destroi(perfil_t *self);
+
+// define o programa executado em modo supervisor (o tratador de
+//   interrupção), cuja execução inicia em 'entrada'
+void perfil_define_supervisor(perfil_t *self, char *programa, int entrada);
+
+// informa que o processo 'pid' executa o programa do arquivo 'programa',
+//   que foi carregado para iniciar a execução no endereço 'entrada'
+void perfil_novo_processo(perfil_t *self, int pid, char *programa, int entrada);
+
+// informa que o processo 'pid' terminou
+void perfil_fim_processo(perfil_t *self, int pid);
+
+// informa que o processo 'pid' vai executar (a partir do próximo retorno de
+//   interrupção)
+void perfil_muda_processo(perfil_t *self, int pid);
+
+// informa que a CPU executou a instrução 'opcode' no endereço 'pc', no modo
+//   'modo'; 'erro' é o estado da CPU após a execução e 'novo_pc' o valor do
+//   PC após a execução
+// se 'erro' for ERR_PAG_AUSENTE, a instrução não foi executada (vai ser
+//   executada de novo quando a página estiver na memória), só é contada a
+//   falta de página; 'opcode' é -1 se nem a instrução foi lida
+void perfil_instrucao(perfil_t *self, int pc, cpu_modo_t modo, int opcode,
+                      err_t erro, int novo_pc);
+
+// grava os arquivos 'prefixo.pilhas' e 'prefixo.txt'
+// retorna false em caso de erro
+bool perfil_grava(perfil_t *self, char *prefixo);
+
+#endif // PERFIL_H
@@ -52,7 +52,7 @@ int proc_get_dispositivo_saida_ok(const processo_t *proc) {
 
 // Dispositivo de entrada
 void proc_set_dispositivo_entrada(processo_t *proc, int dispositivo_entrada) {
-	proc->dispositivo_entrada = dispositivo_entrada - 2;
+	proc->dispositivo_entrada = dispositivo_entrada;
 }
 
 int proc_get_dispositivo_entrada(const processo_t *proc) {
@@ -91,9 +91,10 @@ motivo_bloqueio_t proc_get_motivo_bloqueio(const processo_t *proc) {
 }
 
 // Estado
-void proc_set_estado(processo_t *proc, estado_processo_t estado) {
+void proc_set_estado(processo_t *proc, estado_processo_t estado, int agora) {
 	if (proc == NULL || proc->estado == estado) return;
 
+	proc_contabiliza_tempo(proc, agora);
 	proc->estado = estado;
 
 	switch (estado) {
@@ -111,6 +112,25 @@ void proc_set_estado(processo_t *proc, estado_processo_t estado) {
 	}
 }
 
+void proc_contabiliza_tempo(processo_t *proc, int agora) {
+	int tempo = agora - proc->desde;
+	proc->desde = agora;
+
+	switch (proc->estado) {
+		case EXECUTANDO:
+			proc->metricas.tempo_executando += tempo;
+			break;
+		case PRONTO:
+			proc->metricas.tempo_pronto += tempo;
+			break;
+		case BLOQUEADO:
+			proc->metricas.tempo_bloqueado += tempo;
+			break;
+		default:
+			break;
+	}
+}
+
 estado_processo_t proc_get_estado(const processo_t *proc) {
 	return proc->estado;
 }
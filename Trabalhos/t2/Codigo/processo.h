@@ -1,6 +1,10 @@
 #ifndef PROCESSO_H
 #define PROCESSO_H
 
+#include "tabpag.h"
+#include "fila.h"
+#include <stdbool.h>
+
 // Definições de tipos
 typedef enum {
 	KERNEL = 0,
@@ -18,7 +22,8 @@ typedef enum {
 typedef enum {
 	ESCRITA = 3, // Esperando dispositivo de saída
 	LEITURA,     // Esperando outro processo
-	ESPERA
+	ESPERA,
+	PAGINACAO    // Esperando uma página vir do disco
 } motivo_bloqueio_t;
 
 typedef struct proc_metricas_t {
@@ -31,9 +36,14 @@ typedef struct proc_metricas_t {
 	int tempo_total;
 	int preempcoes;
 	double tempo_medio_de_resposta;
+	long tlb_acertos;
+	long tlb_faltas;
+	int faltas_de_pagina;      // páginas trazidas da memória secundária
+	int paginas_substituidas;  // páginas do processo tiradas da memória principal
+	int paginas_gravadas;      // páginas alteradas copiadas de volta na substituição
 } proc_metricas_t;
 
-typedef struct {
+typedef struct processo_t {
 	int pid;
 	int pc;
 	int a;
@@ -41,7 +51,37 @@ typedef struct {
 	int dispositivo_saida;
 	int dispositivo_entrada;
 	int pid_esperado;
+	// caracteres já transferidos na chamada de E/S em bloco em andamento
+	//   (-1 se não tem), para continuar quando a chamada for refeita
+	int bloco_feito;
+	// parâmetros da chamada em andamento (endereço do buffer e número de
+	//   caracteres), lidos só na primeira vez: ao refazer a chamada, a página
+	//   com eles não precisa estar na memória junto com a do buffer
+	int bloco_ender;
+	int bloco_n;
 	double prioridade;
+	int nivel;            // nível na fila multinível (ESCALONADOR_MLFQ)
+	// memória virtual: tabela de páginas e localização da imagem do processo
+	//   no disco (n_paginas páginas a partir de end_disco)
+	tabpag_t *tabpag;
+	int end_disco;
+	int n_paginas;
+	int pagina_faltante;  // página esperada, se bloqueado por PAGINACAO
+	int n_quadros;        // quadros ocupados pelo processo (inclusive em transferência)
+	// ordem de carga (ver so.c) das duas últimas páginas trazidas do disco
+	//   para o processo; a instrução que causou a falta pode precisar delas
+	//   junto com a próxima, então não são substituídas
+	int ultima_carga;
+	int penultima_carga;
+	// encadeamento na fila de prontos ou de espera em que o processo está
+	//   (ver fila.h)
+	struct processo_t *fila_anterior;
+	struct processo_t *fila_proximo;
+	fila_t *fila;
+	// processos bloqueados esperando este terminar (SO_ESPERA_PROC)
+	fila_t esperando;
+	int indice_tabela;    // posição entre os processos em uso (ver tabproc.h)
+	int desde;            // hora da última mudança de estado (ver proc_set_estado)
 	proc_metricas_t metricas;
 	motivo_bloqueio_t motivo_bloqueio;
 	estado_processo_t estado;
@@ -85,7 +125,11 @@ void proc_set_motivo_bloqueio(processo_t *proc, motivo_bloqueio_t motivo);
 motivo_bloqueio_t proc_get_motivo_bloqueio(const processo_t *proc);
 
 // Declarações de funções para estado
-void proc_set_estado(processo_t *proc, estado_processo_t estado);
+// ao mudar de estado, o tempo desde a mudança anterior ('agora' é a hora do
+//   relógio) é somado ao tempo do processo no estado que ele deixa
+void proc_set_estado(processo_t *proc, estado_processo_t estado, int agora);
+// soma o tempo desde a última mudança ao estado atual, sem mudar de estado
+void proc_contabiliza_tempo(processo_t *proc, int agora);
 estado_processo_t proc_get_estado(const processo_t *proc);
 
 // Declarações de funções para modo
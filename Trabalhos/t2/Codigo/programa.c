@@ -4,16 +4,46 @@
 // so24b
 
 #include "programa.h"
+#include "maqbin.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 struct programa_t {
   int carga;
   int tamanho;
+  int inicio;
+  // formato texto: os dados são lidos para cá
   int *dados;
+  // formato binário: o arquivo fica mapeado na memória, e os dados são
+  //   acessados diretamente nas seções
+  void *mapa;
+  size_t tam_mapa;
+  maqbin_secao_t *secoes;
+  int n_secoes;
+  maqbin_simbolo_t *simbolos;
+  int n_simbolos;
+  // endereços das posições a corrigir quando o programa é carregado em
+  //   outro endereço, em ordem crescente (alocada no formato texto, no
+  //   mapa no binário)
+  bool relocavel;
+  int32_t *relocacoes;
+  int n_relocacoes;
+  // só no formato binário, se o montador gerou
+  maqbin_linha_t *linhas;
+  int n_linhas;
+  char *fonte;
 };
 
+// FORMATO TEXTO
+
 // lê os dados do cabeçalho do arquivo (1ª linha)
 // tem "MAQ" seguido do tamanho e endereço inicial do programa
 static programa_t *pega_cabecalho(char *lin)
@@ -29,6 +59,14 @@ static programa_t *pega_cabecalho(char *lin)
   }
   prog->tamanho = tam;
   prog->carga = carga;
+  prog->inicio = carga;
+  prog->mapa = NULL;
+  prog->n_simbolos = 0;
+  prog->relocavel = false;
+  prog->relocacoes = NULL;
+  prog->n_relocacoes = 0;
+  prog->n_linhas = 0;
+  prog->fonte = NULL;
   return prog;
 }
 
@@ -50,27 +88,209 @@ static void pega_dados(programa_t *self, char *lin)
   }
 }
 
-programa_t *prog_cria(char *nome)
+// lê a tabela de relocação
+// tem uma linha "REL n", com o número de relocações, seguida de linhas
+//   "R =" com os endereços, cada um seguido por vírgula
+// '*pcap' tem o número de relocações que cabem na tabela
+// retorna false em caso de erro
+static bool pega_relocacoes(programa_t *self, char *lin, int *pcap)
+{
+  int n, pos = 0, p;
+  if (sscanf(lin, "REL %d", &n) == 1) {
+    if (n < 0 || self->relocavel) return false;
+    self->relocacoes = malloc(n * sizeof(*self->relocacoes) + 1);
+    if (self->relocacoes == NULL) return false;
+    self->relocavel = true;
+    *pcap = n;
+    return true;
+  }
+  sscanf(lin, " R =%n", &pos);
+  if (pos == 0) return true;
+  if (!self->relocavel) return false;
+  int ender;
+  while (sscanf(lin+pos, "%d ,%n", &ender, &p) == 1) {
+    if (self->n_relocacoes >= *pcap) return false;
+    self->relocacoes[self->n_relocacoes++] = ender;
+    pos += p;
+  }
+  return true;
+}
+
+static programa_t *prog_cria_texto(FILE *arq)
 {
-  FILE *arq = fopen(nome, "r");
-  if (arq == NULL) return NULL;
   char *linha = NULL;
   size_t tam_lin;
   programa_t *prog = NULL;
   if (getline(&linha, &tam_lin, arq) == -1) goto fim;
   prog = pega_cabecalho(linha);
   if (prog == NULL) goto fim;
+  int cap_relocacoes = 0;
   while (getline(&linha, &tam_lin, arq) != -1) {
     pega_dados(prog, linha);
+    if (!pega_relocacoes(prog, linha, &cap_relocacoes)) {
+      prog_destroi(prog);
+      prog = NULL;
+      break;
+    }
   }
 fim:
   free(linha);
+  return prog;
+}
+
+// FORMATO BINÁRIO
+
+// retorna true se o trecho de 'n' elementos de 'tam' bytes que começa em
+//   'desl' está dentro do arquivo
+static bool dentro_do_mapa(programa_t *self, int desl, int n, size_t tam)
+{
+  if (desl < 0 || n < 0) return false;
+  return desl + n * tam <= self->tam_mapa;
+}
+
+// confere o cabeçalho e as tabelas de um arquivo binário já mapeado;
+//   não olha os dados, então o custo não depende do tamanho do programa
+static bool prog_valida_binario(programa_t *self)
+{
+  maqbin_cabecalho_t *cab = self->mapa;
+  if (self->tam_mapa < sizeof(*cab) || cab->versao != MAQBIN_VERSAO) return false;
+  // as contas são feitas em 64 bits, para um arquivo malfeito não causar
+  //   overflow; o programa inteiro tem que caber em um int
+  int64_t fim_programa = (int64_t)cab->carga + cab->tamanho;
+  if (cab->carga < 0 || cab->tamanho < 0 || fim_programa > INT_MAX) return false;
+  if (!dentro_do_mapa(self, sizeof(*cab), cab->n_secoes, sizeof(maqbin_secao_t))) {
+    return false;
+  }
+  if (!dentro_do_mapa(self, cab->desl_simbolos, cab->n_simbolos,
+                      sizeof(maqbin_simbolo_t))
+      || cab->desl_simbolos % sizeof(int32_t) != 0) {
+    return false;
+  }
+  maqbin_secao_t *secoes = (maqbin_secao_t *)(cab + 1);
+  int64_t fim_anterior = cab->carga;
+  for (int i = 0; i < cab->n_secoes; i++) {
+    maqbin_secao_t *s = &secoes[i];
+    if (s->tipo != MAQBIN_DADOS && s->tipo != MAQBIN_ZEROS) return false;
+    if (s->endereco < fim_anterior || s->tamanho < 0
+        || (int64_t)s->endereco + s->tamanho > fim_programa) {
+      return false;
+    }
+    if (s->tipo == MAQBIN_DADOS
+        && (!dentro_do_mapa(self, s->deslocamento, s->tamanho, sizeof(int32_t))
+            || s->deslocamento % sizeof(int32_t) != 0)) {
+      return false;
+    }
+    fim_anterior = (int64_t)s->endereco + s->tamanho;
+  }
+  self->carga = cab->carga;
+  self->tamanho = cab->tamanho;
+  self->inicio = cab->inicio;
+  self->secoes = secoes;
+  self->n_secoes = cab->n_secoes;
+  self->simbolos = (maqbin_simbolo_t *)((char *)self->mapa + cab->desl_simbolos);
+  self->n_simbolos = cab->n_simbolos;
+  for (int i = 0; i < self->n_simbolos; i++) {
+    if (self->simbolos[i].nome[MAQBIN_TAM_NOME - 1] != '\0') return false;
+  }
+  self->relocavel = (cab->flags & MAQBIN_RELOCAVEL) != 0;
+  self->relocacoes = NULL;
+  self->n_relocacoes = 0;
+  if (self->relocavel) {
+    if (!dentro_do_mapa(self, cab->desl_relocacoes, cab->n_relocacoes, sizeof(int32_t))
+        || cab->desl_relocacoes % sizeof(int32_t) != 0) {
+      return false;
+    }
+    self->relocacoes = (int32_t *)((char *)self->mapa + cab->desl_relocacoes);
+    self->n_relocacoes = cab->n_relocacoes;
+  }
+  if (!dentro_do_mapa(self, cab->desl_linhas, cab->n_linhas, sizeof(maqbin_linha_t))
+      || cab->desl_linhas % sizeof(int32_t) != 0) {
+    return false;
+  }
+  self->linhas = (maqbin_linha_t *)((char *)self->mapa + cab->desl_linhas);
+  self->n_linhas = cab->n_linhas;
+  self->fonte = NULL;
+  if (cab->desl_fonte >= 0 && cab->desl_fonte < self->tam_mapa) {
+    // o nome tem que terminar dentro do arquivo
+    char *fonte = (char *)self->mapa + cab->desl_fonte;
+    if (memchr(fonte, '\0', self->tam_mapa - cab->desl_fonte) == NULL) return false;
+    self->fonte = fonte;
+  }
+  return true;
+}
+
+static programa_t *prog_cria_binario(FILE *arq)
+{
+  struct stat st;
+  if (fstat(fileno(arq), &st) != 0 || st.st_size == 0) return NULL;
+  void *mapa = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(arq), 0);
+  if (mapa == MAP_FAILED) return NULL;
+  programa_t *prog = malloc(sizeof(*prog));
+  if (prog == NULL) {
+    munmap(mapa, st.st_size);
+    return NULL;
+  }
+  prog->dados = NULL;
+  prog->relocacoes = NULL;
+  prog->mapa = mapa;
+  prog->tam_mapa = st.st_size;
+  if (!prog_valida_binario(prog)) {
+    prog_destroi(prog);
+    return NULL;
+  }
+  return prog;
+}
+
+// valor na posição 'ender' (já sem o endereço de carga) de um programa binário
+// as seções estão em ordem de endereço, a busca é binária
+static int prog_dado_binario(programa_t *self, int ender)
+{
+  ender += self->carga;
+  int ini = 0;
+  int fim = self->n_secoes - 1;
+  while (ini <= fim) {
+    int meio = (ini + fim) / 2;
+    maqbin_secao_t *s = &self->secoes[meio];
+    if (ender < s->endereco) {
+      fim = meio - 1;
+    } else if (ender >= s->endereco + s->tamanho) {
+      ini = meio + 1;
+    } else {
+      if (s->tipo != MAQBIN_DADOS) return 0;
+      int32_t *dados = (int32_t *)((char *)self->mapa + s->deslocamento);
+      return dados[ender - s->endereco];
+    }
+  }
+  return 0;
+}
+
+// PROGRAMA
+
+programa_t *prog_cria(char *nome)
+{
+  FILE *arq = fopen(nome, "r");
+  if (arq == NULL) return NULL;
+  // o formato é escolhido pelos primeiros bytes do arquivo
+  char magica[4];
+  programa_t *prog = NULL;
+  if (fread(magica, 1, sizeof(magica), arq) == sizeof(magica)
+      && memcmp(magica, MAQBIN_MAGICA, sizeof(magica)) == 0) {
+    prog = prog_cria_binario(arq);
+  } else {
+    rewind(arq);
+    prog = prog_cria_texto(arq);
+  }
   fclose(arq);
   return prog;
 }
 
 void prog_destroi(programa_t *self)
 {
+  if (self->mapa != NULL) {
+    munmap(self->mapa, self->tam_mapa);
+  } else {
+    free(self->relocacoes);
+  }
   free(self->dados);
   free(self);
 }
@@ -87,11 +307,82 @@ int prog_end_carga(programa_t *self)
 
 int prog_end_inicio(programa_t *self)
 {
-  return self->carga;
+  return self->inicio;
 }
 
 int prog_dado(programa_t *self, int ender)
 {
   if (ender < self->carga || ender >= self->carga + self->tamanho) return -1;
+  if (self->mapa != NULL) return prog_dado_binario(self, ender - self->carga);
   return self->dados[ender - self->carga];
 }
+
+bool prog_relocavel(programa_t *self)
+{
+  return self->relocavel;
+}
+
+// retorna true se a posição 'ender' está na tabela de relocação (busca
+//   binária, a tabela é ordenada)
+static bool prog_posicao_relocada(programa_t *self, int ender)
+{
+  int ini = 0;
+  int fim = self->n_relocacoes - 1;
+  while (ini <= fim) {
+    int meio = (ini + fim) / 2;
+    if (self->relocacoes[meio] == ender) return true;
+    if (self->relocacoes[meio] < ender) {
+      ini = meio + 1;
+    } else {
+      fim = meio - 1;
+    }
+  }
+  return false;
+}
+
+int prog_dado_relocado(programa_t *self, int ender, int base)
+{
+  int dado = prog_dado(self, ender);
+  if (self->relocavel && prog_posicao_relocada(self, ender)) {
+    dado += base - self->carga;
+  }
+  return dado;
+}
+
+char *prog_fonte(programa_t *self)
+{
+  return self->fonte;
+}
+
+int prog_linha(programa_t *self, int ender)
+{
+  // busca a última entrada com endereço <= ender
+  int ini = 0;
+  int fim = self->n_linhas - 1;
+  int achou = -1;
+  while (ini <= fim) {
+    int meio = (ini + fim) / 2;
+    if (self->linhas[meio].endereco <= ender) {
+      achou = meio;
+      ini = meio + 1;
+    } else {
+      fim = meio - 1;
+    }
+  }
+  if (achou == -1) return -1;
+  return self->linhas[achou].linha;
+}
+
+int prog_n_simbolos(programa_t *self)
+{
+  return self->n_simbolos;
+}
+
+char *prog_simbolo(programa_t *self, int i, int *pvalor, bool *protulo)
+{
+  if (i < 0 || i >= self->n_simbolos) return NULL;
+  maqbin_simbolo_t *simb = &self->simbolos[i];
+  *pvalor = simb->valor;
+  *protulo = simb->tipo == MAQBIN_ROTULO;
+  return simb->nome;
+}
@@ -7,6 +7,11 @@
 #define PROGRAMA_H
 
 // TAD para representar um programa lido de um arquivo '.maq'
+// o arquivo pode estar no formato texto ou no binário (ver maqbin.h); o
+//   binário é mapeado na memória em vez de lido, e pode ter tabela de símbolos
+// o montador gera os dois formatos com tabela de relocação
+
+#include <stdbool.h>
 
 typedef struct programa_t programa_t;
 
@@ -31,4 +36,31 @@ int prog_end_inicio(programa_t *self);
 // valor a colocar na posição 'ender' da memória
 int prog_dado(programa_t *self, int ender);
 
+// retorna true se o programa tem tabela de relocação, e pode ser carregado
+//   em um endereço diferente de prog_end_carga
+bool prog_relocavel(programa_t *self);
+
+// valor a colocar na posição de memória correspondente a 'ender' quando o
+//   programa é carregado a partir do endereço 'base' em vez de prog_end_carga
+//   (a posição 'ender' vai para 'ender - prog_end_carga + base')
+// as posições que contêm endereços de rótulos são corrigidas; se o programa
+//   não for relocável, é igual a prog_dado
+int prog_dado_relocado(programa_t *self, int ender, int base);
+
+// nome do arquivo fonte do programa, ou NULL se o arquivo não tiver
+char *prog_fonte(programa_t *self);
+
+// número da linha do fonte que gerou o conteúdo do endereço 'ender', ou -1
+//   se o arquivo não tiver tabela de linhas
+int prog_linha(programa_t *self, int ender);
+
+// número de símbolos do programa (0 se o arquivo não tem tabela de símbolos)
+int prog_n_simbolos(programa_t *self);
+
+// retorna o nome do símbolo 'i' (entre 0 e prog_n_simbolos-1), e coloca em
+//   '*pvalor' o valor dele e em '*protulo' se é um rótulo (o valor é um
+//   endereço) ou uma constante
+// retorna NULL se não existir o símbolo
+char *prog_simbolo(programa_t *self, int i, int *pvalor, bool *protulo);
+
 #endif // PROGRAMA_H
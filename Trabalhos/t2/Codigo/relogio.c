@@ -4,6 +4,7 @@
 // so24b
 
 #include "relogio.h"
+#include "estado.h"
 
 #include <stdlib.h>
 #include <time.h>
@@ -25,6 +26,8 @@ relogio_t *relogio_cria(void)
   assert(self != NULL);
 
   self->agora = 0;
+  self->t_ate_interrupcao = 0;
+  self->interrupcao = 0;
 
   return self;
 }
@@ -36,12 +39,19 @@ void relogio_destroi(relogio_t *self)
 
 void relogio_tictac(relogio_t *self)
 {
-  self->agora++;
+  relogio_avanca(self, 1);
+}
+
+void relogio_avanca(relogio_t *self, int n)
+{
+  self->agora += n;
   // vê se tem que gerar interrupção
   if (self->t_ate_interrupcao != 0) {
-    self->t_ate_interrupcao--;
-    if (self->t_ate_interrupcao == 0) {
+    if (n >= self->t_ate_interrupcao) {
+      self->t_ate_interrupcao = 0;
       self->interrupcao = 1;
+    } else {
+      self->t_ate_interrupcao -= n;
     }
   }
 }
@@ -51,6 +61,18 @@ int relogio_agora(relogio_t *self)
   return self->agora;
 }
 
+int relogio_proximo_evento(relogio_t *self)
+{
+  if (self->t_ate_interrupcao <= 0) return -1;
+  return self->agora + self->t_ate_interrupcao;
+}
+
+bool relogio_tem_interrupcao(void *disp)
+{
+  relogio_t *self = disp;
+  return self->interrupcao != 0;
+}
+
 err_t relogio_leitura(void *disp, int id, int *pvalor)
 {
   relogio_t *self = disp;
@@ -90,3 +112,13 @@ err_t relogio_escrita(void *disp, int id, int pvalor)
   }
   return err;
 }
+
+bool relogio_grava_estado(relogio_t *self, FILE *arq)
+{
+  return ESTADO_GRAVA(arq, *self);
+}
+
+bool relogio_le_estado(relogio_t *self, FILE *arq)
+{
+  return ESTADO_LE(arq, *self);
+}
@@ -10,6 +10,8 @@
 // registra a passagem do tempo
 
 #include "err.h"
+#include <stdio.h>
+#include <stdbool.h>
 
 typedef struct relogio_t relogio_t;
 
@@ -24,9 +26,25 @@ void relogio_destroi(relogio_t *self);
 // esta função é chamada pelo controlador após a execução de cada instrução
 void relogio_tictac(relogio_t *self);
 
+// registra a passagem de 'n' unidades de tempo, como 'n' chamadas a tictac
+// é usada pelo controlador após a execução de um lote de instruções
+void relogio_avanca(relogio_t *self, int n);
+
 // retorna a hora atual do sistema, em unidades de tempo
 int relogio_agora(relogio_t *self);
 
+// retorna a hora (em unidades de tempo) em que o timer vai gerar a próxima
+//   interrupção, ou -1 se o timer não estiver programado
+// permite ao controlador executar até esse momento sem consultar o relógio,
+//   e pular direto para ele quando a CPU estiver parada
+int relogio_proximo_evento(relogio_t *self);
+
+// retorna true se o relógio está pedindo interrupção (o mesmo que o
+//   dispositivo 3)
+// segue o protocolo f_linha_int_t de controlador_int.h, para o controlador
+//   de interrupções consultar o relógio
+bool relogio_tem_interrupcao(void *disp);
+
 // Funções para acessar o relógio como dispositivo de E/S, com id:
 //   '0' para ler o relógio local (contador de instruções)
 //   '1' para ler o tempo de CPU consumido pelo simulador (em ms)
@@ -36,4 +54,9 @@ int relogio_agora(relogio_t *self);
 err_t relogio_leitura(void *disp, int id, int *pvalor);
 err_t relogio_escrita(void *disp, int id, int pvalor);
 
+// grava no arquivo o estado do relógio, ou lê o estado gravado (ver estado.h)
+// retornam false em caso de erro
+bool relogio_grava_estado(relogio_t *self, FILE *arq);
+bool relogio_le_estado(relogio_t *self, FILE *arq);
+
 #endif // RELOGIO_H
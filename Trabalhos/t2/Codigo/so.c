@@ -8,66 +8,200 @@
 #include "dispositivos.h"
 #include "irq.h"
 #include "programa.h"
+#include "cache_prog.h"
+#include "perfil.h"
 #include "instrucao.h"
 #include "processo.h"
+#include "fila.h"
+#include "tabproc.h"
+#include "disco.h"
+#include "estado.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
 
+// valores padrão dos parâmetros (ver so_param_t)
 #define INTERVALO_INTERRUPCAO 50
 #define INTERVALO_QUANTUM     10
-#define MAX_PROCESSOS         10
+#define ARQUIVO_METRICAS      "metricas_processos.txt"
+// prioridades das interrupções no controlador de interrupções: os terminais
+//   são atendidos antes, para que os processos interativos sejam acordados
+//   logo que o dispositivo fica pronto
+#define PRIORIDADE_IRQ_TERMINAL 3
+#define PRIORIDADE_IRQ_DISCO    2
+#define PRIORIDADE_IRQ_RELOGIO  1
 #define PID_NENHUM            -1
 
-typedef enum {
-  ESCALONADOR_NORMAL,
-  ESCALONADOR_ROUND_ROBIN,
-  ESCALONADOR_ROUND_ROBIN_PRIORIDADE
-} escalonador_t;
+// fila multinível com realimentação (ESCALONADOR_MLFQ)
+// número de níveis; o nível 0 é o de maior prioridade
+#define MLFQ_NIVEIS           4
+// a cada tantas interrupções do relógio, todos os processos voltam para o
+//   nível 0, para que os dos níveis baixos não morram de fome
+#define MLFQ_PERIODO_REFORCO  100
+
+// a memória física abaixo deste endereço é do SO (estado da CPU salvo na
+//   interrupção e o tratador de interrupção), não é usada para páginas
+#define END_INICIO_USUARIO    100
+// endereço virtual onde é carregada a imagem dos processos; os programas
+//   relocáveis são carregados aqui, independente do endereço em que foram
+//   montados, os outros no endereço em que foram montados
+#define END_VIRTUAL_CARGA     0
+// valor padrão do número máximo de quadros da memória principal usados para
+//   páginas (0 para usar toda a memória disponível)
+// t2: pode ser alterado (so_param_t) para comparar as políticas de
+//   substituição com pouca memória, mas não para menos de
+//   MIN_QUADROS_POR_PROCESSO (ver so.h)
+#define MAX_QUADROS           0
+// idade (em instruções) a partir da qual uma página não acessada é
+//   considerada fora do conjunto de trabalho, no WSClock
+#define WSCLOCK_TAU           200
+// memória máxima ocupada pelos programas já lidos, guardados para criar
+//   outros processos com o mesmo executável sem ler o arquivo de novo
+#define CACHE_PROG_MAX_BYTES  (64 * 1024)
+
+// quantum de cada nível da MLFQ, em interrupções do relógio; um processo
+//   que usa todo o quantum desce um nível
+static const int mlfq_quantum[MLFQ_NIVEIS] = { 2, 4, 8, 16 };
+
+// nomes dos valores de escalonador_t e substituicao_t, na ordem da
+//   enumeração, para os parâmetros (so_param_altera) e as métricas
+static char *nomes_escalonador[] = { "normal", "rr", "rrp", "mlfq" };
+static char *nomes_substituicao[] = {
+  "fifo", "segunda_chance", "envelhecimento", "wsclock"
+};
+#define N_NOMES(v) ((int)(sizeof(v) / sizeof(v[0])))
 
-typedef struct no {
-  processo_t *processo;
-  struct no *proximo;
-  struct no *anterior;
-} no_t;
+// descritor de um quadro da memória principal usado para páginas
+typedef struct {
+  // processo dono da página que está no quadro (NULL se o quadro está livre)
+  processo_t *dono;
+  int pagina;
+  // ordem em que a página foi carregada (FIFO)
+  int ordem_carga;
+  // contador de envelhecimento, 8 bits (ENVELHECIMENTO)
+  int idade;
+  // última vez que a página foi vista acessada (WSCLOCK)
+  int ultimo_uso;
+  // a página está sendo trazida do disco; o quadro não pode ser escolhido
+  //   para substituição
+  bool em_transito;
+} quadro_t;
+
+// uma transferência de página entre o disco e a memória principal
+// as transferências são feitas uma por vez, na ordem em que foram pedidas,
+//   então a leitura de uma página sempre acontece depois da gravação da
+//   versão alterada dela
+typedef struct {
+  int comando;      // DISCO_CMD_LE ou DISCO_CMD_ESCREVE
+  int end_disco;
+  int quadro;       // índice em quadros
+} transferencia_t;
 
+// trecho livre do disco, deixado por um processo que terminou
 typedef struct {
-  no_t *inicio;
-  no_t *fim;
-} fila_t;
+  int inicio;
+  int tam;
+} area_disco_t;
 
 struct so_t {
   cpu_t *cpu;
   mem_t *mem;
+  mmu_t *mmu;
   es_t *es;
   console_t *console;
-  processo_t tabela_processos[MAX_PROCESSOS];
+  so_param_t param;
+  tabproc_t *tabela_processos;
   processo_t *processo_corrente;
-  fila_t *fila_processos;
+  fila_t fila_processos;
+  // cada processo bloqueado está em uma fila de espera, conforme o motivo:
+  // - E/S: em espera_dispositivo[d], d é o registrador de estado do
+  //   dispositivo; o bit d de dispositivos_esperados diz se a fila pode
+  //   ter processo; as filas só são atendidas depois de uma interrupção
+  //   de teclado ou de tela (terminais_mudaram)
+  // - término de outro processo: na fila 'esperando' do descritor dele
+  // - página sendo lida do disco: em espera_pagina
+  // - quadro para poder pedir a página: em espera_quadro, tentam de novo
+  //   quando quadros_mudaram
+  fila_t espera_dispositivo[N_DISPOSITIVOS];
+  uint64_t dispositivos_esperados;
+  bool terminais_mudaram;
+  fila_t espera_pagina;
+  fila_t espera_quadro;
+  bool quadros_mudaram;
 
   escalonador_t escalonador;
+  // filas da MLFQ; o bit i de mlfq_ocupados indica se o nível i tem processo
+  fila_t mlfq[MLFQ_NIVEIS];
+  unsigned mlfq_ocupados;
+  int mlfq_tics_ate_reforco;
+
+  // memória virtual
+  // a imagem de cada processo fica no disco; as páginas são copiadas para
+  //   quadros da memória principal quando acessadas
+  int disco_livre;
+  int disco_tam;
+  // tamanho das páginas, definido pela MMU
+  int tam_pagina;
+  // áreas do disco liberadas por processos que terminaram, para reuso
+  area_disco_t *areas_livres;
+  int n_areas_livres;
+  int max_areas_livres;
+  // fila circular de transferências com o disco; a primeira está em andamento
+  // cada quadro tem no máximo uma gravação e uma leitura pendentes
+  transferencia_t *transferencias;
+  int max_transf;
+  int transf_inicio;
+  int n_transf;
+  substituicao_t substituicao;
+  // quadros[i] descreve o quadro físico primeiro_quadro + i
+  quadro_t *quadros;
+  int primeiro_quadro;
+  int n_quadros;
+  // pilha com os índices dos quadros livres
+  int *quadros_livres;
+  int n_quadros_livres;
+  // posição do ponteiro do relógio (SEGUNDA_CHANCE e WSCLOCK)
+  int ponteiro_relogio;
+  int contador_carga;
+  // processo para o qual está sendo escolhida uma vítima
+  processo_t *faltante;
+  // programas lidos dos arquivos '.maq'
+  cache_prog_t *cache_programas;
+  // informado sobre os processos, se não for NULL
+  perfil_t *perfil;
 
   int quantidade_processos;
   int quantum;
   int relogio;
   int contador_pid;
   bool erro_interno;
+  // se as métricas finais já foram calculadas e gravadas (ver so_encerra)
+  bool desligado;
 
   int ultimo_relogio;
   int tempo_execucao;
   int tempo_ocioso;
   int preempcoes_totais;
   int *interrupcoes;
+  // métricas de cada processo criado, indexadas pelo pid; são copiadas do
+  //   descritor quando o processo termina
+  proc_metricas_t *metricas_pid;
+  int max_metricas_pid;
+  // contadores da TLB na última interrupção, para calcular quanto cada
+  //   processo usou
+  long tlb_acertos;
+  long tlb_faltas;
 };
 
-/*
-  Atualiza as metricas dos processos percorrendo a tabela e adicionando o tempo decorrido
-  bem como increvemnta a estrutura das interrupcoes com o seu respectivo tipo.
-*/
-void atualiza_metricas(so_t *self, int irq) {
-  self->interrupcoes[irq]++;
-
+// lê o relógio; o tempo decorrido desde a leitura anterior é contado como
+//   ocioso se não tinha processo executando
+static void so_le_relogio(so_t *self)
+{
   int ultimo_relogio = self->ultimo_relogio;
   if(es_le(self->es, D_RELOGIO_INSTRUCOES, &self->ultimo_relogio) != ERR_OK)
   {
@@ -80,117 +214,203 @@ void atualiza_metricas(so_t *self, int irq) {
   if (self->processo_corrente == NULL) {
     self->tempo_ocioso += tempo_decorrido;
   }
+}
 
-  for (int i = 0; i < self->quantidade_processos; i++)
-  {
-    processo_t *proc = &self->tabela_processos[i];
-    if(proc != NULL) {
-      switch (proc_get_estado(proc)) {
-        case EXECUTANDO:
-          proc->metricas.tempo_executando += tempo_decorrido;
-          break;
-        case PRONTO:
-          proc->metricas.tempo_pronto += tempo_decorrido;
-          break;
-        case BLOQUEADO:
-          proc->metricas.tempo_bloqueado += tempo_decorrido;
-          break;
-        default:
-          break;
-      }
-    }
-  }
+/*
+  Conta a interrupção e lê o relógio (ver so_le_relogio).
+  O tempo de cada processo em cada estado não é contado aqui, mas quando o
+  processo muda de estado (ver proc_set_estado), com a hora lida aqui: todas
+  as mudanças acontecem durante o atendimento de uma interrupção.
+*/
+void atualiza_metricas(so_t *self, int irq) {
+  self->interrupcoes[irq]++;
+  so_le_relogio(self);
 }
 
 // função de tratamento de interrupção (entrada no SO)
 static int so_trata_interrupcao(void *argC, int reg_A);
 
 // funções auxiliares
-// carrega o programa contido no arquivo na memória do processador; retorna end. inicial
-static int so_carrega_programa(so_t *self, char *nome_do_executavel);
-// copia para str da memória do processador, até copiar um 0 (retorna true) ou tam bytes
-static bool copia_str_da_mem(int tam, char str[tam], mem_t *mem, int ender);
+// carrega o programa contido no arquivo na memória do processador, em 'base'
+//   se for relocável; retorna end. inicial
+static int so_carrega_programa(so_t *self, char *nome_do_executavel, int base);
+// carrega o programa na memória secundária, como imagem do processo; retorna end. inicial
+static int so_carrega_processo(so_t *self, processo_t *proc, char *nome_do_executavel);
+// copia para str da memória do processo, até copiar um 0 (retorna ERR_OK) ou tam bytes
+static err_t copia_str_do_proc(so_t *self, processo_t *proc, int tam, char str[tam], int ender);
+// acesso à memória dos processos pelo SO (ver ACESSO À MEMÓRIA DOS PROCESSOS)
+static err_t so_le_mem_proc(so_t *self, processo_t *proc, int ender, int *pvalor);
+static err_t so_traduz_end_proc(so_t *self, processo_t *proc, int ender, int *pendfis);
+// inicializa o gerenciamento de quadros da memória principal
+static void so_inicializa_memoria(so_t *self);
+// libera os quadros e a tabela de páginas de um processo que terminou
+static void so_libera_memoria(so_t *self, processo_t *proc);
+// devolve a área do disco com a imagem de um processo que terminou
+static void so_libera_area_disco(so_t *self, processo_t *proc);
+// bloqueia o processo até que a página 'pagina' seja trazida do disco
+// retorna false (sem bloquear) se a página não pertence ao processo
+static bool so_trata_falta_de_pagina(so_t *self, processo_t *proc, int pagina);
+// tenta começar a trazer do disco a página que o processo espera
+static void so_inicia_falta_de_pagina(so_t *self, processo_t *proc);
+// atualiza os contadores de envelhecimento com os bits de acesso
+static void so_envelhece_paginas(so_t *self);
+
+// PARÂMETROS {{{1
+
+void so_param_padrao(so_param_t *param)
+{
+  param->escalonador = ESCALONADOR_ROUND_ROBIN_PRIORIDADE;
+  param->substituicao = SUBST_SEGUNDA_CHANCE;
+  param->intervalo_interrupcao = INTERVALO_INTERRUPCAO;
+  param->quantum = INTERVALO_QUANTUM;
+  param->max_quadros = MAX_QUADROS;
+  param->arquivo_metricas = ARQUIVO_METRICAS;
+}
+
+// retorna a posição de 'valor' em 'nomes', ou -1
+static int so_param_procura_nome(int n, char *nomes[n], char *valor)
+{
+  for (int i = 0; i < n; i++) {
+    if (strcmp(nomes[i], valor) == 0) return i;
+  }
+  return -1;
+}
+
+// coloca em '*pnum' o valor de 'valor', que deve ser um número maior ou
+//   igual a 'min'
+static bool so_param_numero(char *valor, int *pnum, int min)
+{
+  char *fim;
+  long num = strtol(valor, &fim, 0);
+  if (*valor == '\0' || *fim != '\0' || num < min || num > INT_MAX) return false;
+  *pnum = num;
+  return true;
+}
+
+bool so_param_altera(so_param_t *param, char *nome, char *valor)
+{
+  if (strcmp(nome, "escalonador") == 0) {
+    int i = so_param_procura_nome(N_NOMES(nomes_escalonador), nomes_escalonador, valor);
+    if (i < 0) return false;
+    param->escalonador = i;
+  } else if (strcmp(nome, "substituicao") == 0) {
+    int i = so_param_procura_nome(N_NOMES(nomes_substituicao), nomes_substituicao, valor);
+    if (i < 0) return false;
+    param->substituicao = i;
+  } else if (strcmp(nome, "intervalo_interrupcao") == 0) {
+    return so_param_numero(valor, &param->intervalo_interrupcao, 1);
+  } else if (strcmp(nome, "quantum") == 0) {
+    return so_param_numero(valor, &param->quantum, 1);
+  } else if (strcmp(nome, "max_quadros") == 0) {
+    int max_quadros;
+    if (!so_param_numero(valor, &max_quadros, 0)) return false;
+    if (max_quadros > 0 && max_quadros < MIN_QUADROS_POR_PROCESSO) return false;
+    param->max_quadros = max_quadros;
+  } else if (strcmp(nome, "arquivo_metricas") == 0) {
+    param->arquivo_metricas = valor;
+  } else {
+    return false;
+  }
+  return true;
+}
 
 // CRIAÇÃO {{{1
 
-// Inicializa a tabela de processos do SO
-static void so_inicializa_tabela_processos(so_t *self) {
-	for (int i = 0; i < MAX_PROCESSOS; i++) {
-		self->tabela_processos[i].pid = PID_NENHUM;
-		self->tabela_processos[i].pc = 0;
-		self->tabela_processos[i].a = 0;
-		self->tabela_processos[i].x = 0;
-		self->tabela_processos[i].estado = PARADO;
-		self->tabela_processos[i].modo = KERNEL;
-		self->tabela_processos[i].pid_esperado = 0;
-		self->tabela_processos[i].motivo_bloqueio = 0;
-		self->tabela_processos[i].prioridade = 0;
-
-		// Inicializa métricas
-		self->tabela_processos[i].metricas.vezes_pronto = 0;
-		self->tabela_processos[i].metricas.vezes_executando = 0;
-		self->tabela_processos[i].metricas.vezes_bloqueado = 0;
-		self->tabela_processos[i].metricas.tempo_pronto = 0;
-		self->tabela_processos[i].metricas.tempo_executando = 0;
-		self->tabela_processos[i].metricas.tempo_bloqueado = 0;
-		self->tabela_processos[i].metricas.tempo_total = 0;
-		self->tabela_processos[i].metricas.tempo_medio_de_resposta = 0;
-		self->tabela_processos[i].metricas.preempcoes = 0;
-	}
+// Inicializa um descritor de processo recém alocado na tabela
+static void so_inicializa_processo(processo_t *proc) {
+	proc->pid = PID_NENHUM;
+	proc->pc = 0;
+	proc->a = 0;
+	proc->x = 0;
+	proc->estado = PARADO;
+	proc->modo = KERNEL;
+	proc->pid_esperado = 0;
+	proc->bloco_feito = -1;
+	proc->bloco_ender = 0;
+	proc->bloco_n = 0;
+	proc->motivo_bloqueio = 0;
+	proc->prioridade = 0;
+	proc->nivel = 0;
+	proc->fila_anterior = NULL;
+	proc->fila_proximo = NULL;
+	proc->fila = NULL;
+	fila_inicializa(&proc->esperando);
+
+	// Inicializa métricas
+	proc->metricas.vezes_pronto = 0;
+	proc->metricas.vezes_executando = 0;
+	proc->metricas.vezes_bloqueado = 0;
+	proc->metricas.tempo_pronto = 0;
+	proc->metricas.tempo_executando = 0;
+	proc->metricas.tempo_bloqueado = 0;
+	proc->desde = 0;
+	proc->metricas.tempo_total = 0;
+	proc->metricas.tempo_medio_de_resposta = 0;
+	proc->metricas.preempcoes = 0;
+	proc->metricas.tlb_acertos = 0;
+	proc->metricas.tlb_faltas = 0;
+	proc->metricas.faltas_de_pagina = 0;
+	proc->metricas.paginas_substituidas = 0;
+	proc->metricas.paginas_gravadas = 0;
+	proc->tabpag = NULL;
+	proc->end_disco = 0;
+	proc->pagina_faltante = -1;
+	proc->n_quadros = 0;
+	proc->ultima_carga = -1;
+	proc->penultima_carga = -1;
+	proc->n_paginas = 0;
 }
 
 
 // Configura o timer do SO
 static void so_configura_timer(so_t *self) {
-  if (es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO) != ERR_OK) {
+  if (es_escreve(self->es, D_RELOGIO_TIMER, self->param.intervalo_interrupcao) != ERR_OK) {
     console_printf("SO: problema na programação do timer\n");
     self->erro_interno = true;
   }
 }
 
-fila_t *cira_fila() { 
-  fila_t *self = (fila_t *)malloc(sizeof(fila_t));
-  
-  self->inicio = NULL;
-  self->fim = NULL;
-  
-  return self;
-}
-
-void remove_fila (fila_t *self, processo_t *proc) {
-  for (no_t *no = self->inicio; no != NULL; no = no->proximo) {
-    if (no->processo != proc) {
-      continue;
-    }
-
-    if (no->anterior != NULL) {
-      no->anterior->proximo = no->proximo;
-    } else {
-      self->inicio = no->proximo;
-    }
-
-    if (no->proximo != NULL) {
-      no->proximo->anterior = no->anterior;
-    } else {
-      self->fim = no->anterior;
+// Configura o controlador de interrupções: prioridades e interrupções
+// habilitadas
+static void so_configura_interrupcoes(so_t *self) {
+  int prioridades[][2] = {
+    { IRQ_RELOGIO, PRIORIDADE_IRQ_RELOGIO  },
+    { IRQ_DISCO,   PRIORIDADE_IRQ_DISCO    },
+    { IRQ_TECLADO, PRIORIDADE_IRQ_TERMINAL },
+    { IRQ_TELA,    PRIORIDADE_IRQ_TERMINAL },
+  };
+  int habilitadas = 0;
+  for (int i = 0; i < sizeof(prioridades) / sizeof(prioridades[0]); i++) {
+    int irq = prioridades[i][0];
+    if (es_escreve(self->es, D_INT_IRQ, irq) != ERR_OK
+        || es_escreve(self->es, D_INT_PRIORIDADE, prioridades[i][1]) != ERR_OK) {
+      console_printf("SO: problema na programação do controlador de interrupções");
+      self->erro_interno = true;
+      return;
     }
-
-    free(no);
-
-    break;
+    habilitadas |= 1 << irq;
+  }
+  if (es_escreve(self->es, D_INT_HABILITADAS, habilitadas) != ERR_OK) {
+    console_printf("SO: problema na programação do controlador de interrupções");
+    self->erro_interno = true;
   }
 }
 
-so_t *so_cria(cpu_t *cpu, mem_t *mem, es_t *es, console_t *console) {
+so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu, es_t *es, console_t *console,
+              so_param_t *param) {
   so_t *self = malloc(sizeof(*self));
   if (self == NULL) return NULL;
 
   // Inicializa os componentes do SO
   self->cpu = cpu;
   self->mem = mem;
+  self->mmu = mmu;
   self->es = es;
   self->console = console;
+  self->param = *param;
+  self->tam_pagina = mmu_tam_pagina(mmu);
   self->erro_interno = false;
+  self->desligado = false;
   self->quantidade_processos = 0;
   self->contador_pid = 0;             // Inicializa o contador de PIDs  OBS: Pode ser qualquer valor exemplo 10,100,123,7,10000
   self->processo_corrente = NULL;
@@ -201,21 +421,43 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, es_t *es, console_t *console) {
   self->tempo_execucao = 0;
   self->tempo_ocioso = 0;
   self->preempcoes_totais = 0;
-  self->escalonador = ESCALONADOR_ROUND_ROBIN_PRIORIDADE;  //Exemplo com o ESCALONADOR_ROUND_ROBIN_PRIORIDADE
-  self->interrupcoes = (int *)malloc(6 * sizeof(int));     //Coloquei o 6 pois é a quantidade de tipos de interrupcoes que tem
+  self->tlb_acertos = 0;
+  self->tlb_faltas = 0;
+  self->substituicao = param->substituicao;
+  self->escalonador = param->escalonador;
+  self->interrupcoes = (int *)calloc(N_IRQ, sizeof(int));
 
 
   // Inicializa a tabela de processos e a fila de processos
-  self->fila_processos = cira_fila();
-  so_inicializa_tabela_processos(self);
+  fila_inicializa(&self->fila_processos);
+  for (int i = 0; i < MLFQ_NIVEIS; i++) {
+    fila_inicializa(&self->mlfq[i]);
+  }
+  self->mlfq_ocupados = 0;
+  self->mlfq_tics_ate_reforco = MLFQ_PERIODO_REFORCO;
+  self->tabela_processos = tabproc_cria();
+  for (int i = 0; i < N_DISPOSITIVOS; i++) {
+    fila_inicializa(&self->espera_dispositivo[i]);
+  }
+  self->dispositivos_esperados = 0;
+  self->terminais_mudaram = false;
+  fila_inicializa(&self->espera_pagina);
+  fila_inicializa(&self->espera_quadro);
+  self->quadros_mudaram = false;
+  self->metricas_pid = NULL;
+  self->max_metricas_pid = 0;
+  so_inicializa_memoria(self);
+  self->cache_programas = cache_prog_cria(CACHE_PROG_MAX_BYTES);
+  self->perfil = NULL;
 
   cpu_define_chamaC(self->cpu, so_trata_interrupcao, self);
-  int ender = so_carrega_programa(self, "trata_int.maq");
+  int ender = so_carrega_programa(self, "trata_int.maq", IRQ_END_TRATADOR);
   if (ender != IRQ_END_TRATADOR) {
     console_printf("SO: problema na carga do programa de tratamento de interrupção");
     self->erro_interno = true;
   }
 
+  so_configura_interrupcoes(self);
   so_configura_timer(self);
   return self;
 }
@@ -223,10 +465,30 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, es_t *es, console_t *console) {
 void so_destroi(so_t *self)
 {
   cpu_define_chamaC(self->cpu, NULL, NULL);
+  for (int i = 0; i < tabproc_n_processos(self->tabela_processos); i++) {
+    so_libera_memoria(self, tabproc_processo(self->tabela_processos, i));
+  }
+  tabproc_destroi(self->tabela_processos);
+  cache_prog_destroi(self->cache_programas);
+  free(self->metricas_pid);
+  free(self->interrupcoes);
+  free(self->quadros);
+  free(self->quadros_livres);
+  free(self->transferencias);
+  free(self->areas_livres);
   free(self);
 }
 
+void so_define_perfil(so_t *self, perfil_t *perfil)
+{
+  self->perfil = perfil;
+  if (perfil != NULL) {
+    perfil_define_supervisor(perfil, "trata_int.maq", IRQ_END_TRATADOR);
+  }
+}
+
 static void so_salva_estado_da_cpu(so_t *self);
+static void so_contabiliza_tlb(so_t *self);
 static void so_trata_irq(so_t *self, int irq);
 static void so_trata_pendencias(so_t *self);
 static void so_escalona(so_t *self);
@@ -235,7 +497,7 @@ static int so_despacha(so_t *self);
 
 //Funcao para imprimir as metricas no aquivo "metricas_processos.txt"
 void so_imprime_metricas(so_t *self) {
-	const char *nome_arquivo = "metricas_processos.txt";
+	const char *nome_arquivo = self->param.arquivo_metricas;
 
 	FILE *arquivo = fopen(nome_arquivo, "w");
 	if (arquivo == NULL) {
@@ -245,7 +507,12 @@ void so_imprime_metricas(so_t *self) {
 
 	fprintf(arquivo, "============================== MÉTRICAS DO SISTEMA ===============================\n\n");
 
-	fprintf(arquivo, "  Escalonador                : %d\n\n", self->escalonador);
+	fprintf(arquivo, "  Escalonador                : %s\n", nomes_escalonador[self->escalonador]);
+	fprintf(arquivo, "  Quantum                    : %d\n", self->param.quantum);
+	fprintf(arquivo, "  Intervalo de interrupção   : %d\n", self->param.intervalo_interrupcao);
+	fprintf(arquivo, "  Substituição de páginas    : %s\n", nomes_substituicao[self->substituicao]);
+	fprintf(arquivo, "  Tamanho da página          : %d\n", self->tam_pagina);
+	fprintf(arquivo, "  Quadros para páginas       : %d\n\n", self->n_quadros);
 
 	fprintf(arquivo, "GERAL:\n");
 	fprintf(arquivo, "  Processos criados          : %d\n", self->quantidade_processos);
@@ -257,8 +524,13 @@ void so_imprime_metricas(so_t *self) {
 	fprintf(arquivo, "  IRQ_ERR_CPU                : %d\n", self->interrupcoes[IRQ_ERR_CPU]);
 	fprintf(arquivo, "  IRQ_SISTEMA                : %d\n", self->interrupcoes[IRQ_SISTEMA]);
 	fprintf(arquivo, "  IRQ_RELOGIO                : %d\n", self->interrupcoes[IRQ_RELOGIO]);
+	fprintf(arquivo, "  IRQ_DISCO                  : %d\n", self->interrupcoes[IRQ_DISCO]);
 	fprintf(arquivo, "  IRQ_TECLADO                : %d\n", self->interrupcoes[IRQ_TECLADO]);
 	fprintf(arquivo, "  IRQ_TELA                   : %d\n", self->interrupcoes[IRQ_TELA]);
+	fprintf(arquivo, "\nCACHE DE PROGRAMAS:\n");
+	fprintf(arquivo, "  Acertos                    : %ld\n", cache_prog_acertos(self->cache_programas));
+	fprintf(arquivo, "  Faltas                     : %ld\n", cache_prog_faltas(self->cache_programas));
+	fprintf(arquivo, "  Descartes                  : %ld\n", cache_prog_descartes(self->cache_programas));
 
 	fprintf(arquivo, "\n============================ MÉTRICAS DOS PROCESSOS ============================\n\n");
 
@@ -267,16 +539,16 @@ void so_imprime_metricas(so_t *self) {
 	fprintf(arquivo, "| PID | Tempo Exec. | Tempo Pronto | Tempo Bloq. | Tempo Retorno | Resp. Médio |\n");
 	fprintf(arquivo, "|-----|-------------|--------------|-------------|---------------|-------------|\n");
 
-	for (int i = 0; i < self->quantidade_processos; i++) {
-		processo_t *proc = &self->tabela_processos[i];
+	for (int pid = 0; pid < self->contador_pid; pid++) {
+		proc_metricas_t *m = &self->metricas_pid[pid];
 		fprintf(arquivo,
 			"| %-3d | %-11d | %-12d | %-11d | %-13d | %-11.2f |\n",
-			proc_get_pid(proc),
-			proc_get_tempo_executando(proc),
-			proc_get_tempo_pronto(proc),
-			proc_get_tempo_bloqueado(proc),
-			proc_get_tempo_total(proc),
-			proc_get_tempo_medio_de_resposta(proc));
+			pid,
+			m->tempo_executando,
+			m->tempo_pronto,
+			m->tempo_bloqueado,
+			m->tempo_total,
+			(float)m->tempo_medio_de_resposta);
 	}
 
 	fprintf(arquivo, "\n------------- TABELA DE VEZES -------------\n");
@@ -284,15 +556,46 @@ void so_imprime_metricas(so_t *self) {
 	fprintf(arquivo, "|-----|-----------|------------|--------------|-------------|\n");
 
 	// Tabela de vezes
-	for (int i = 0; i < self->quantidade_processos; i++) {
-		processo_t *proc = &self->tabela_processos[i];
+	for (int pid = 0; pid < self->contador_pid; pid++) {
+		proc_metricas_t *m = &self->metricas_pid[pid];
 		fprintf(arquivo,
 			"| %-3d | %-9d | %-10d | %-12d | %-11d |\n",
-			proc_get_pid(proc),
-			proc_get_vezes_executando(proc),
-			proc_get_preempcoes(proc),
-			proc_get_vezes_pronto(proc),
-			proc_get_vezes_bloqueado(proc));
+			pid,
+			m->vezes_executando,
+			m->preempcoes,
+			m->vezes_pronto,
+			m->vezes_bloqueado);
+	}
+
+	fprintf(arquivo, "\n------------- TABELA DE TLB -------------\n");
+	fprintf(arquivo, "| PID | Acertos    | Faltas     | Taxa de acerto |\n");
+	fprintf(arquivo, "|-----|------------|------------|----------------|\n");
+
+	// Tabela de TLB
+	for (int pid = 0; pid < self->contador_pid; pid++) {
+		proc_metricas_t *m = &self->metricas_pid[pid];
+		long acessos = m->tlb_acertos + m->tlb_faltas;
+		fprintf(arquivo,
+			"| %-3d | %-10ld | %-10ld | %13.2f%% |\n",
+			pid,
+			m->tlb_acertos,
+			m->tlb_faltas,
+			acessos == 0 ? 0.0 : 100.0 * m->tlb_acertos / acessos);
+	}
+
+	fprintf(arquivo, "\n------------- TABELA DE PAGINAÇÃO -------------\n");
+	fprintf(arquivo, "| PID | Faltas     | Substituídas | Gravadas   |\n");
+	fprintf(arquivo, "|-----|------------|--------------|------------|\n");
+
+	// Tabela de paginação
+	for (int pid = 0; pid < self->contador_pid; pid++) {
+		proc_metricas_t *m = &self->metricas_pid[pid];
+		fprintf(arquivo,
+			"| %-3d | %-10d | %-12d | %-10d |\n",
+			pid,
+			m->faltas_de_pagina,
+			m->paginas_substituidas,
+			m->paginas_gravadas);
 	}
 
 	fprintf(arquivo, "\n================================================================================\n");
@@ -305,23 +608,25 @@ void so_imprime_metricas(so_t *self) {
 //Funcao que verefica se o SO possui algum processo rodando, caso o contrairo o SO vai poder desligar
 static bool so_ocupado(so_t *self)
 {
-  for (int i = 0; i < self->quantidade_processos; i++) {
-    if (self->tabela_processos[i].estado != FINALIZADO) {
-      return true;
-    }
-  }
-
-  return false;
+  // os processos que terminam saem da tabela
+  return tabproc_n_processos(self->tabela_processos) > 0;
 }
 
 void calcula_metricas_final(so_t *self) {
-  for (int i = 0; i < self->quantidade_processos; i++) {
-    processo_t *proc = &self->tabela_processos[i];
-    self->tempo_execucao += proc->metricas.tempo_executando;
-    self->preempcoes_totais += proc->metricas.preempcoes;
+  // os processos que terminaram já têm as métricas em metricas_pid; os que
+  //   ainda existem têm que ter contado o tempo no estado atual
+  for (int i = 0; i < tabproc_n_processos(self->tabela_processos); i++) {
+    processo_t *proc = tabproc_processo(self->tabela_processos, i);
+    proc_contabiliza_tempo(proc, self->ultimo_relogio);
+    self->metricas_pid[proc->pid] = proc->metricas;
+  }
+  for (int pid = 0; pid < self->contador_pid; pid++) {
+    proc_metricas_t *m = &self->metricas_pid[pid];
+    self->tempo_execucao += m->tempo_executando;
+    self->preempcoes_totais += m->preempcoes;
 
-    proc->metricas.tempo_total = proc->metricas.tempo_executando + proc->metricas.tempo_bloqueado + proc->metricas.tempo_pronto;
-    proc->metricas.tempo_medio_de_resposta = (double)proc->metricas.tempo_pronto / proc->metricas.vezes_pronto;
+    m->tempo_total = m->tempo_executando + m->tempo_bloqueado + m->tempo_pronto;
+    m->tempo_medio_de_resposta = (double)m->tempo_pronto / m->vezes_pronto;
   }
 }
 
@@ -339,10 +644,38 @@ static int so_desliga(so_t *self)
 
   calcula_metricas_final(self);
   so_imprime_metricas(self);
+  self->desligado = true;
 
   return 1;
 }
 
+void so_encerra(so_t *self)
+{
+  if (self->desligado) return;
+  // conta o tempo desde a última interrupção e o uso da TLB pelo processo
+  //   que estava executando
+  so_le_relogio(self);
+  so_contabiliza_tlb(self);
+  calcula_metricas_final(self);
+  so_imprime_metricas(self);
+  self->desligado = true;
+}
+
+// os contadores da MMU são globais; o que mudou desde a última interrupção
+//   foi causado pelo processo que estava executando
+static void so_contabiliza_tlb(so_t *self)
+{
+  long acertos, faltas;
+  mmu_estatisticas_tlb(self->mmu, &acertos, &faltas);
+  processo_t *proc = self->processo_corrente;
+  if (proc != NULL && proc->estado == EXECUTANDO) {
+    proc->metricas.tlb_acertos += acertos - self->tlb_acertos;
+    proc->metricas.tlb_faltas += faltas - self->tlb_faltas;
+  }
+  self->tlb_acertos = acertos;
+  self->tlb_faltas = faltas;
+}
+
 static int so_trata_interrupcao(void *argC, int reg_A)
 {
   so_t *self = argC;
@@ -352,6 +685,8 @@ static int so_trata_interrupcao(void *argC, int reg_A)
 
   // esse print polui bastante, recomendo tirar quando estiver com mais confiança
   console_printf("SO: recebi IRQ %d (%s)", irq, irq_nome(irq));
+  // contabiliza o uso da TLB pelo processo que foi interrompido
+  so_contabiliza_tlb(self);
   // salva o estado da cpu no descritor do processo que foi interrompido
   so_salva_estado_da_cpu(self);
   // faz o atendimento da interrupção
@@ -370,60 +705,93 @@ static int so_trata_interrupcao(void *argC, int reg_A)
 }
 
 
-/*
-Funcao que retorna o índice correspondente ao PID, dado que o PID e o seu indice
-na tabela de processos nao são correspondentes
-*/
-static int so_busca_indice_por_pid(so_t *self, int pid) {
-  for (int i = 0; i < MAX_PROCESSOS; i++) {
-    if (self->tabela_processos[i].pid == pid) {
-      return i;
-    }
-  }
-  return -1;
+// retorna true se o pid já foi de um processo que terminou
+// os pids não são reaproveitados, então um pid já distribuído que não está
+//   mais na tabela é de processo que terminou
+static bool so_pid_terminou(so_t *self, int pid) {
+  return pid >= 0 && pid < self->contador_pid
+    && tabproc_busca(self->tabela_processos, pid) == NULL;
 }
 
-void fila_insere(fila_t *self, processo_t *proc)
-{
-  no_t *no = (no_t *)malloc(sizeof(no_t));
-  no->processo = proc;
-  no->anterior = NULL;
-  no->proximo = NULL;
+// FILA MULTINÍVEL {{{1
 
-  // Caso a fila esteja vazia
-  if (self->inicio == NULL) {
-    self->inicio = self->fim = no;
-    return;
+// retorna o índice do bit menos significativo ligado em 'mapa', que não
+//   pode ser 0 (o nível não vazio de maior prioridade, para a MLFQ)
+static int primeiro_bit(uint64_t mapa)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(mapa);
+#else
+  int bit = 0;
+  while ((mapa & 1) == 0) {
+    mapa >>= 1;
+    bit++;
   }
+  return bit;
+#endif
+}
+
+// coloca o processo no fim da fila do seu nível
+static void mlfq_insere(so_t *self, processo_t *proc)
+{
+  fila_insere_fim(&self->mlfq[proc->nivel], proc);
+  self->mlfq_ocupados |= 1u << proc->nivel;
+}
 
-  no_t *atual = self->inicio;
+// tira o processo da fila do seu nível, se ele estiver lá
+static void mlfq_remove(so_t *self, processo_t *proc)
+{
+  fila_t *fila = &self->mlfq[proc->nivel];
+  fila_remove(fila, proc);
+  if (fila_vazia(fila)) self->mlfq_ocupados &= ~(1u << proc->nivel);
+}
 
-  // Percorre a fila até encontrar a posição correta
-  while (atual != NULL && atual->processo->prioridade >= proc->prioridade) {
-    atual = atual->proximo;
-  }
+// retira e retorna o primeiro processo do nível de maior prioridade, ou NULL
+static processo_t *mlfq_retira(so_t *self)
+{
+  if (self->mlfq_ocupados == 0) return NULL;
+  int nivel = primeiro_bit(self->mlfq_ocupados);
+  processo_t *proc = fila_primeiro(&self->mlfq[nivel]);
+  mlfq_remove(self, proc);
+  return proc;
+}
 
-  // Se o novo nó deve ser inserido no final
-  if (atual == NULL) {
-    no->anterior = self->fim;
-    self->fim->proximo = no;
-    self->fim = no;
+// coloca todos os processos no nível 0, mantendo a ordem relativa
+static void mlfq_reforca(so_t *self)
+{
+  for (int nivel = 1; nivel < MLFQ_NIVEIS; nivel++) {
+    processo_t *proc;
+    while ((proc = fila_primeiro(&self->mlfq[nivel])) != NULL) {
+      mlfq_remove(self, proc);
+      proc->nivel = 0;
+      mlfq_insere(self, proc);
+    }
   }
-  // Se o novo nó deve ser inserido no início
-  else if (atual == self->inicio) {
-    no->proximo = self->inicio;
-    self->inicio->anterior = no;
-    self->inicio = no;
+  // os que não estão prontos voltam para o nível 0 quando ficarem
+  for (int i = 0; i < tabproc_n_processos(self->tabela_processos); i++) {
+    tabproc_processo(self->tabela_processos, i)->nivel = 0;
   }
-  // Se o novo nó deve ser inserido no meio
-  else {
-    no->proximo = atual;
-    no->anterior = atual->anterior;
-    atual->anterior->proximo = no;
-    atual->anterior = no;
+}
+
+// coloca o processo entre os prontos, na estrutura do escalonador em uso
+static void so_insere_pronto(so_t *self, processo_t *proc)
+{
+  if (self->escalonador == ESCALONADOR_MLFQ) {
+    mlfq_insere(self, proc);
+  } else {
+    fila_insere(&self->fila_processos, proc);
   }
 }
 
+// tira o processo dos prontos, se estiver lá
+static void so_remove_pronto(so_t *self, processo_t *proc)
+{
+  if (self->escalonador == ESCALONADOR_MLFQ) {
+    mlfq_remove(self, proc);
+  } else {
+    fila_remove(&self->fila_processos, proc);
+  }
+}
 
 static void so_salva_estado_da_cpu(so_t *self) {
   if (self->processo_corrente == NULL || self->processo_corrente->estado != EXECUTANDO) {
@@ -437,90 +805,81 @@ static void so_salva_estado_da_cpu(so_t *self) {
   mem_le(self->mem, IRQ_END_X, &proc_atual->x);
 }
 
-// Função para tratar bloqueio por escrita
-static void trata_bloqueio_escrita(so_t *self, processo_t *proc) {
-  int estado;
-  es_le(self->es, proc_get_dispositivo_saida_ok(proc), &estado);
-  if (estado != 0) {
-    es_escreve(self->es, proc_get_dispositivo_saida(proc), proc_get_x(proc));
-    proc_set_estado(proc, PRONTO);
-    fila_insere(self->fila_processos, proc);
-    proc_set_a(proc, 0);
-  }
-}
-
-// Função para tratar bloqueio por leitura
-static void trata_bloqueio_leitura(so_t *self, processo_t *proc) {
-  int estado;
-  es_le(self->es, proc_get_dispositivo_entrada_ok(proc), &estado);
-  if (estado != 0) {
-    int dado;
-    es_le(self->es, proc_get_dispositivo_entrada(proc), &dado);
-    proc_set_a(proc, dado);
-    proc_set_estado(proc, PRONTO);
-    fila_insere(self->fila_processos, proc);
-  }
+// tira o processo da fila de espera e coloca entre os prontos
+static void so_desbloqueia(so_t *self, processo_t *proc) {
+  fila_remove(fila_do_processo(proc), proc);
+  proc_set_estado(proc, PRONTO, self->ultimo_relogio);
+  so_insere_pronto(self, proc);
 }
 
-
-// Função para tratar bloqueio por espera
-static void trata_bloqueio_espera(so_t *self, processo_t *proc) {
-  for (int i = 0; i < MAX_PROCESSOS; i++) {
-    processo_t *processo_esperado = &self->tabela_processos[i];
-      if (processo_esperado->pid == proc->pid_esperado && processo_esperado->estado == FINALIZADO) {
-          proc_set_estado(proc,PRONTO);
-          fila_insere(self->fila_processos,proc);
-          console_printf("SO: Processo PID=%d desbloqueado após término do processo PID=%d.\n", proc->pid, processo_esperado->pid);
-          return;
-      }
+// Atende os processos bloqueados esperando o dispositivo com registrador de
+// estado 'disp', na ordem em que bloquearam, enquanto ele estiver pronto
+static void so_atende_dispositivo(so_t *self, int disp) {
+  fila_t *fila = &self->espera_dispositivo[disp];
+  processo_t *proc;
+  while ((proc = fila_primeiro(fila)) != NULL) {
+    int estado;
+    es_le(self->es, disp, &estado);
+    if (estado == 0) return;
+    if (proc->bloco_feito >= 0) {
+      // E/S em bloco: o processo refaz a chamada, que faz a transferência
+      so_desbloqueia(self, proc);
+      continue;
+    }
+    if (proc->motivo_bloqueio == ESCRITA) {
+      es_escreve(self->es, proc_get_dispositivo_saida(proc), proc_get_x(proc));
+      proc_set_a(proc, 0);
+    } else {
+      int dado;
+      es_le(self->es, proc_get_dispositivo_entrada(proc), &dado);
+      proc_set_a(proc, dado);
+    }
+    so_desbloqueia(self, proc);
   }
 }
 
-// Função principal para tratar o bloqueio do processo
-static void so_trata_bloqueio(so_t *self, processo_t *proc) {
-  // Verifica o motivo do bloqueio do processo
-  switch (proc->motivo_bloqueio) {
-    case ESCRITA:
-          trata_bloqueio_escrita(self, proc);
-          break;
-
-    case LEITURA:
-          trata_bloqueio_leitura(self, proc);
-          break;
-
-    case ESPERA:
-          trata_bloqueio_espera(self, proc);
-          break;
-
-    default:
-          console_printf("SO: Motivo de bloqueio desconhecido para o processo PID=%d.\n", proc->pid);
-          break;
+// Tenta de novo pedir a página dos processos que não conseguiram quadro
+static void so_tenta_quadros(so_t *self) {
+  processo_t *proc = fila_primeiro(&self->espera_quadro);
+  while (proc != NULL) {
+    // se conseguir, o processo muda para espera_pagina
+    processo_t *proximo = fila_proximo(proc);
+    so_inicia_falta_de_pagina(self, proc);
+    proc = proximo;
   }
 }
 
-//Percorre a tabela de processos a procura de um bloqueado, se encontrou trata o bloqueio
+// Trata as pendências dos processos bloqueados
+// Só são visitadas as filas de espera que podem ter mudado: a dos
+// dispositivos com processo esperando, se chegou interrupção de terminal,
+// e a de quem espera quadro se algum quadro foi liberado; o término de um
+// processo e a chegada de uma página desbloqueiam os processos diretamente
 static void so_trata_pendencias(so_t *self) {
-  
-  for (int i = 0; i < MAX_PROCESSOS; i++) {
-    processo_t *proc = &self->tabela_processos[i];
-
-    if (proc->estado == BLOQUEADO) {
-      so_trata_bloqueio(self, proc);
+  // o estado dos terminais só muda quando o controlador avisa; não precisa
+  //   consultar os registradores de estado a cada interrupção
+  uint64_t mapa = self->terminais_mudaram ? self->dispositivos_esperados : 0;
+  self->terminais_mudaram = false;
+  while (mapa != 0) {
+    int disp = primeiro_bit(mapa);
+    mapa &= mapa - 1;
+    so_atende_dispositivo(self, disp);
+    if (fila_vazia(&self->espera_dispositivo[disp])) {
+      self->dispositivos_esperados &= ~((uint64_t)1 << disp);
     }
   }
+  if (self->quadros_mudaram) {
+    self->quadros_mudaram = false;
+    so_tenta_quadros(self);
+  }
 }
 
 static void calcula_prioridade(so_t *self, processo_t *processo) {
-  processo->prioridade = (processo->prioridade + (INTERVALO_QUANTUM - self->quantum) / (float)INTERVALO_QUANTUM) / 2;
+  processo->prioridade = (processo->prioridade + (self->param.quantum - self->quantum) / (float)self->param.quantum) / 2;
 }
 
 processo_t *proximo_processo(so_t *self) {
-    if (self->fila_processos->inicio == NULL) {
-        return NULL; // Nenhum processo na fila
-    }
-
-    // Retorna o processo no início da fila
-    return self->fila_processos->inicio->processo;
+    // Retorna o processo no início da fila (NULL se vazia)
+    return fila_primeiro(&self->fila_processos);
 }
 
 static bool necessita_escalonar(so_t *self) {
@@ -549,9 +908,8 @@ static void escalonador_normal(so_t *self) {
 	self->processo_corrente = NULL;
 
 	// Busca o próximo processo pronto
-	for (int i = 0; i < self->quantidade_processos; i++) {
-		processo_t *proc = &self->tabela_processos[i]; // Obtem o processo da tabela
-		if (proc != NULL && proc_get_estado(proc) == PRONTO) {
+	for (processo_t *proc = fila_primeiro(&self->fila_processos); proc != NULL; proc = fila_proximo(proc)) {
+		if (proc_get_estado(proc) == PRONTO) {
 			self->processo_corrente = proc; // Define como o próximo processo corrente
 			return;
 		}
@@ -559,20 +917,20 @@ static void escalonador_normal(so_t *self) {
 }
 
 processo_t *proximo_processo_com_maior_prioridade(so_t *self) {
-    if (self->fila_processos->inicio == NULL) {
+    if (fila_vazia(&self->fila_processos)) {
         return NULL; // Nenhum processo na fila
     }
 
     // Inicializa o processo com maior prioridade
-    processo_t *processo_maior_prioridade = self->fila_processos->inicio->processo;
-    no_t *no_atual = self->fila_processos->inicio->proximo;
+    processo_t *processo_maior_prioridade = fila_primeiro(&self->fila_processos);
+    processo_t *atual = fila_proximo(processo_maior_prioridade);
 
     // Percorre a fila para encontrar o processo com maior prioridade
-    while (no_atual != NULL) {
-        if (no_atual->processo->prioridade < processo_maior_prioridade->prioridade) {
-            processo_maior_prioridade = no_atual->processo;
+    while (atual != NULL) {
+        if (atual->prioridade < processo_maior_prioridade->prioridade) {
+            processo_maior_prioridade = atual;
         }
-        no_atual = no_atual->proximo;
+        atual = fila_proximo(atual);
     }
 
     return processo_maior_prioridade;
@@ -580,10 +938,11 @@ processo_t *proximo_processo_com_maior_prioridade(so_t *self) {
 
 
 static void escalonador_ROUND_ROBIN(so_t *self) {
-  if(self->quantum == 0){
+  if(self->quantum == 0 && self->processo_corrente != NULL
+     && proc_get_estado(self->processo_corrente) == EXECUTANDO){
 
-    remove_fila(self->fila_processos,self->processo_corrente);
-    fila_insere(self->fila_processos, self->processo_corrente);
+    so_remove_pronto(self, self->processo_corrente);
+    so_insere_pronto(self, self->processo_corrente);
 
     self->processo_corrente->metricas.preempcoes++;
   }
@@ -595,7 +954,7 @@ static void escalonador_ROUND_ROBIN(so_t *self) {
     self->processo_corrente = proc;
     return;
   }else {
-    self->quantum = INTERVALO_QUANTUM;
+    self->quantum = self->param.quantum;
     self->processo_corrente = proc;
   }
 }
@@ -624,11 +983,47 @@ static void escalonador_round_robin_PRIORIDADE(so_t *self) {
 
   // Se mudou o processo em execução, reseta o quantum
   if (self->processo_corrente != proc_prev) {
-    self->quantum = INTERVALO_QUANTUM;
+    self->quantum = self->param.quantum;
     self->processo_corrente->metricas.preempcoes++;
   }
 }
 
+// fila multinível com realimentação
+// o processo em execução só perde a CPU quando acaba o quantum do seu nível
+//   (e desce um nível) ou quando aparece processo pronto em nível mais alto
+//   (e continua no mesmo nível); o processo que bloqueia antes de acabar o
+//   quantum não muda de nível
+// os processos prontos ficam fora da fila enquanto executam
+static void escalonador_mlfq(so_t *self) {
+  processo_t *corrente = self->processo_corrente;
+
+  if (self->mlfq_tics_ate_reforco <= 0) {
+    self->mlfq_tics_ate_reforco = MLFQ_PERIODO_REFORCO;
+    mlfq_reforca(self);
+  }
+
+  if (corrente != NULL && proc_get_estado(corrente) == EXECUTANDO) {
+    bool esgotou = self->quantum <= 0;
+    bool tem_mais_prioritario = self->mlfq_ocupados != 0
+      && primeiro_bit(self->mlfq_ocupados) < corrente->nivel;
+    if (!esgotou && !tem_mais_prioritario) return;
+    if (esgotou && corrente->nivel < MLFQ_NIVEIS - 1) corrente->nivel++;
+    proc_set_estado(corrente, PRONTO, self->ultimo_relogio);
+    mlfq_insere(self, corrente);
+  }
+
+  self->processo_corrente = mlfq_retira(self);
+  if (self->processo_corrente == NULL) {
+    self->quantum = 0;
+    return;
+  }
+  if (self->processo_corrente != corrente && corrente != NULL
+      && proc_get_estado(corrente) == PRONTO) {
+    corrente->metricas.preempcoes++;
+  }
+  self->quantum = mlfq_quantum[self->processo_corrente->nivel];
+}
+
 static void so_escalona(so_t *self) {
   
   switch (self->escalonador) {
@@ -644,6 +1039,10 @@ static void so_escalona(so_t *self) {
 			escalonador_round_robin_PRIORIDADE(self);
 			break;
 
+		case ESCALONADOR_MLFQ:
+			escalonador_mlfq(self);
+			break;
+
 		default:
 			console_printf("SO: Escalonador desconhecido! Nenhuma ação será realizada.\n");
 			break;
@@ -662,11 +1061,14 @@ static int so_despacha(so_t *self) {
   mem_escreve(self->mem, IRQ_END_modo, proc_get_modo(proc));    // Configura o modo de operação
   mem_escreve(self->mem, IRQ_END_A,       proc_get_a(proc));    // Configura o registrador A
   mem_escreve(self->mem, IRQ_END_X,       proc_get_x(proc));    // Configura o registrador X
+  mmu_define_tabpag(self->mmu, proc->tabpag);                    // Espaço de endereçamento do processo
+  if (self->perfil != NULL) perfil_muda_processo(self->perfil, proc->pid);
+  mem_escreve(self->mem, IRQ_END_erro,              ERR_OK);    // O erro que interrompeu já foi tratado
 
   if (self->erro_interno) {
     return 1;
   } else {
-    proc_set_estado(proc, EXECUTANDO);
+    proc_set_estado(proc, EXECUTANDO, self->ultimo_relogio);
     return 0;
   }
 }
@@ -676,6 +1078,8 @@ static void so_trata_irq_reset(so_t *self);
 static void so_trata_irq_chamada_sistema(so_t *self);
 static void so_trata_irq_err_cpu(so_t *self);
 static void so_trata_irq_relogio(so_t *self);
+static void so_trata_irq_disco(so_t *self);
+static void so_trata_irq_terminal(so_t *self);
 static void so_trata_irq_desconhecida(so_t *self, int irq);
 
 static void so_trata_irq(so_t *self, int irq) {
@@ -692,21 +1096,29 @@ static void so_trata_irq(so_t *self, int irq) {
     case IRQ_RELOGIO:
       so_trata_irq_relogio(self);
       break;
+    case IRQ_DISCO:
+      so_trata_irq_disco(self);
+      break;
+    case IRQ_TECLADO:
+    case IRQ_TELA:
+      so_trata_irq_terminal(self);
+      break;
     default:
       so_trata_irq_desconhecida(self, irq);
   }
 }
 
 // Função para configurar o novo processo
-static void configura_novo_processo(processo_t *novo_proc, int pid, int ender_carga) {
+static void configura_novo_processo(so_t *self, processo_t *novo_proc, int pid, int ender_carga) {
   proc_set_pid(novo_proc, pid);
   proc_set_pc(novo_proc, ender_carga);
   proc_set_a(novo_proc, 0);
   proc_set_x(novo_proc, 0);
-  proc_set_estado(novo_proc, PRONTO);
+  proc_set_estado(novo_proc, PRONTO, self->ultimo_relogio);
   proc_set_modo(novo_proc, USUARIO);
   proc_set_pid_esperado(novo_proc, 0);
   proc_set_prioridade(novo_proc, 0.5);
+  novo_proc->nivel = 0;
 
   // Inicializa as métricas utilizando os setters
   proc_set_tempo_pronto(novo_proc, 0);
@@ -715,66 +1127,93 @@ static void configura_novo_processo(processo_t *novo_proc, int pid, int ender_ca
   proc_set_preempcoes(novo_proc, 0);
 }
 
-// Função para definir o dispositivo de saída com base no PID
-static void define_dispositivos(processo_t *novo_proc) {
-	switch (proc_get_pid(novo_proc) % 4) {
-		case 0:
-			proc_set_dispositivo_saida(novo_proc, D_TERM_A_TELA);
-      proc_set_dispositivo_entrada(novo_proc, D_TERM_A_TECLADO);
-			break;
-		case 1:
-			proc_set_dispositivo_saida(novo_proc, D_TERM_B_TELA);
-      proc_set_dispositivo_entrada(novo_proc, D_TERM_B_TECLADO);
+// Função para definir o terminal do processo com base no PID
+static void define_dispositivos(so_t *self, processo_t *novo_proc) {
+	int terminal = proc_get_pid(novo_proc) % console_n_terminais(self->console);
+	proc_set_dispositivo_saida(novo_proc, dispositivo_terminal(terminal, 2));
+	proc_set_dispositivo_entrada(novo_proc, dispositivo_terminal(terminal, 0));
+}
 
-			break;
-		case 2:
-			proc_set_dispositivo_saida(novo_proc, D_TERM_C_TELA);
-      proc_set_dispositivo_entrada(novo_proc, D_TERM_C_TECLADO);
+// retorna um descritor livre da tabela de processos, inicializado
+static processo_t *so_aloca_processo(so_t *self) {
+  processo_t *proc = tabproc_aloca(self->tabela_processos);
+  so_inicializa_processo(proc);
+  return proc;
+}
 
-			break;
-		case 3:
-			proc_set_dispositivo_saida(novo_proc, D_TERM_D_TELA);
-      proc_set_dispositivo_entrada(novo_proc, D_TERM_D_TECLADO);
-			break;
-	}
+// coloca o processo (já com o pid definido) no índice da tabela, e reserva
+//   espaço para guardar suas métricas quando ele terminar
+static void so_registra_processo(so_t *self, processo_t *proc) {
+  tabproc_indexa(self->tabela_processos, proc);
+  if (proc->pid >= self->max_metricas_pid) {
+    int max = self->max_metricas_pid == 0 ? 16 : 2 * self->max_metricas_pid;
+    while (max <= proc->pid) max *= 2;
+    self->metricas_pid = realloc(self->metricas_pid, max * sizeof(*self->metricas_pid));
+    assert(self->metricas_pid != NULL);
+    self->max_metricas_pid = max;
+  }
 }
 
 // Interrupção gerada uma única vez, quando a CPU inicializa
 static void so_trata_irq_reset(so_t *self) {
+  // se a criação do SO falhou, não cria o init; sem processo nenhum, o SO
+  //   desliga no final desta interrupção, e a simulação para
+  if (self->erro_interno) {
+    console_printf("SO: erro na inicialização, desligando");
+    return;
+  }
   self->quantidade_processos++;
   // Cria e inicializa o processo init
-  processo_t *init_proc = &self->tabela_processos[0];
-  int ender = so_carrega_programa(self, "init.maq");
+  processo_t *init_proc = so_aloca_processo(self);
+  int ender = so_carrega_processo(self, init_proc, "init.maq");
   if (ender < 0) {
     console_printf("SO: problema na carga do programa inicial\n");
+    tabproc_libera(self->tabela_processos, init_proc);
     self->erro_interno = true;
     return;
   }
 
-  configura_novo_processo(init_proc, self->contador_pid++, ender);
+  configura_novo_processo(self, init_proc, self->contador_pid++, ender);
+  if (self->perfil != NULL) {
+    perfil_novo_processo(self->perfil, init_proc->pid, "init.maq", ender);
+  }
+  so_registra_processo(self, init_proc);
   
-  define_dispositivos(init_proc);
+  define_dispositivos(self, init_proc);
 
-  fila_insere(self->fila_processos,init_proc);
+  so_insere_pronto(self, init_proc);
 
   self->processo_corrente = init_proc;
 }
 
+static void so_mata_processo(so_t *self, processo_t *proc);
+
 // interrupção gerada quando a CPU identifica um erro
 static void so_trata_irq_err_cpu(so_t *self)
 {
   // Ocorreu um erro interno na CPU
-  // O erro está codificado em IRQ_END_erro
-  // Em geral, causa a morte do processo que causou o erro
-  // Ainda não temos processos, causa a parada da CPU
-  int err_int;
-  // t1: com suporte a processos, deveria pegar o valor do registrador erro
-  //   no descritor do processo corrente, e reagir de acordo com esse erro
-  //   (em geral, matando o processo)
+  // O erro está codificado em IRQ_END_erro, o endereço que causou o erro
+  //   em IRQ_END_complemento
+  // Falta de página bloqueia o processo até a página ser trazida do disco,
+  //   e depois ele volta a executar a mesma instrução; os outros erros
+  //   causam a morte do processo
+  int err_int, complemento;
   mem_le(self->mem, IRQ_END_erro, &err_int);
+  mem_le(self->mem, IRQ_END_complemento, &complemento);
   err_t err = err_int;
-  console_printf("SO: IRQ não tratada -- erro na CPU: %s", err_nome(err));
-  self->erro_interno = true;
+  processo_t *proc = self->processo_corrente;
+  if (proc == NULL || proc->estado != EXECUTANDO) {
+    console_printf("SO: erro na CPU sem processo: %s", err_nome(err));
+    self->erro_interno = true;
+    return;
+  }
+  if (err == ERR_PAG_AUSENTE && complemento >= 0
+      && so_trata_falta_de_pagina(self, proc, complemento / self->tam_pagina)) {
+    return;
+  }
+  console_printf("SO: processo %d morto -- erro na CPU: %s (%d)",
+                 proc->pid, err_nome(err), complemento);
+  so_mata_processo(self, proc);
 }
 
 // interrupção gerada quando o timer expira
@@ -783,7 +1222,7 @@ static void so_trata_irq_relogio(so_t *self)
   // rearma o interruptor do relógio e reinicializa o timer para a próxima interrupção
   err_t e1, e2;
   e1 = es_escreve(self->es, D_RELOGIO_INTERRUPCAO, 0); // desliga o sinalizador de interrupção
-  e2 = es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO);
+  e2 = es_escreve(self->es, D_RELOGIO_TIMER, self->param.intervalo_interrupcao);
   if (e1 != ERR_OK || e2 != ERR_OK) {
     console_printf("SO: problema da reinicialização do timer");
     self->erro_interno = true;
@@ -791,7 +1230,21 @@ static void so_trata_irq_relogio(so_t *self)
   if (self->quantum > 0) {
     self->quantum--;
   }
-    
+  if (self->escalonador == ESCALONADOR_MLFQ) {
+    self->mlfq_tics_ate_reforco--;
+  }
+  if (self->substituicao == SUBST_ENVELHECIMENTO) {
+    so_envelhece_paginas(self);
+  }
+}
+
+// interrupção gerada quando um teclado recebe caractere ou uma tela volta a
+// aceitar escrita
+// o controlador não diz qual terminal foi, as filas de espera dos
+// dispositivos são atendidas em so_trata_pendencias
+static void so_trata_irq_terminal(so_t *self)
+{
+  self->terminais_mudaram = true;
 }
 
 // foi gerada uma interrupção para a qual o SO não está preparado
@@ -809,6 +1262,9 @@ static void so_chamada_escr(so_t *self);
 static void so_chamada_cria_proc(so_t *self);
 static void so_chamada_mata_proc(so_t *self);
 static void so_chamada_espera_proc(so_t *self);
+static void so_chamada_le_bloco(so_t *self);
+static void so_chamada_escr_bloco(so_t *self);
+static void so_chamada_le_linha(so_t *self);
 
 static void so_trata_irq_chamada_sistema(so_t *self)
 {
@@ -837,6 +1293,15 @@ static void so_trata_irq_chamada_sistema(so_t *self)
     case SO_ESPERA_PROC:
       so_chamada_espera_proc(self);
       break;
+    case SO_LE_BLOCO:
+      so_chamada_le_bloco(self);
+      break;
+    case SO_ESCR_BLOCO:
+      so_chamada_escr_bloco(self);
+      break;
+    case SO_LE_LINHA:
+      so_chamada_le_linha(self);
+      break;
     default:
       console_printf("SO: chamada de sistema desconhecida (%d)", id_chamada);
       // t1: deveria matar o processo
@@ -847,15 +1312,34 @@ static void so_trata_irq_chamada_sistema(so_t *self)
 //Funcao usada para bloquear processos
 static void bloqueia_processo(so_t *self, motivo_bloqueio_t MOTIVO)
 {
-  remove_fila(self->fila_processos,self->processo_corrente);
+  processo_t *proc = self->processo_corrente;
+  so_remove_pronto(self, proc);
 
-  proc_set_estado      (self->processo_corrente, BLOQUEADO);
-  proc_set_motivo_bloqueio(self->processo_corrente, MOTIVO);
+  proc_set_estado      (proc, BLOQUEADO, self->ultimo_relogio);
+  proc_set_motivo_bloqueio(proc, MOTIVO);
 
-  //Tem esse IF pois a funcao espera precisa retornar o x para ser usado no desbloqueio do processo
-  if (MOTIVO == ESPERA){
-    proc_set_pid_esperado(self->processo_corrente, proc_get_x(self->processo_corrente));
+  // Coloca o processo na fila de espera correspondente ao motivo
+  int disp;
+  switch (MOTIVO) {
+    case ESCRITA:
+    case LEITURA:
+      disp = MOTIVO == ESCRITA ? proc_get_dispositivo_saida_ok(proc)
+                               : proc_get_dispositivo_entrada_ok(proc);
+      fila_insere_fim(&self->espera_dispositivo[disp], proc);
+      self->dispositivos_esperados |= (uint64_t)1 << disp;
+      break;
+    case ESPERA:
+      //A funcao espera precisa guardar o x para ser usado no desbloqueio do processo
+      proc_set_pid_esperado(proc, proc_get_x(proc));
+      fila_insere_fim(&tabproc_busca(self->tabela_processos, proc->pid_esperado)->esperando, proc);
+      break;
+    case PAGINACAO:
+      // vai para espera_pagina quando a leitura da página for pedida
+      fila_insere_fim(&self->espera_quadro, proc);
+      return;
   }
+  // quem espera quadro pode suspender este processo (ver so_suspende)
+  if (proc->n_quadros > 0) self->quadros_mudaram = true;
 }
 
 // Implementação da chamada de sistema SO_LE
@@ -863,11 +1347,11 @@ static void bloqueia_processo(so_t *self, motivo_bloqueio_t MOTIVO)
 static void so_chamada_le(so_t *self)
 {
   int estado;
-  es_le(self->es, proc_get_dispositivo_entrada(self->processo_corrente), &estado);
+  es_le(self->es, proc_get_dispositivo_entrada_ok(self->processo_corrente), &estado);
 
   if (estado != 0) {
     int dado;
-    es_le(self->es, proc_get_dispositivo_entrada(self->processo_corrente) + 1, &dado);
+    es_le(self->es, proc_get_dispositivo_entrada(self->processo_corrente), &dado);
     mem_escreve(self->mem, IRQ_END_A, dado);
   } else {
     bloqueia_processo(self, LEITURA);
@@ -890,45 +1374,182 @@ static void so_chamada_escr(so_t *self) {
 }
 
 
-// Função para ler o nome do processo da memória
-static void le_nome_do_processso(so_t *self, int ender_proc, char *nome) {
-  copia_str_da_mem(sizeof(nome), nome, self->mem, ender_proc);
+// Funções auxiliares das chamadas de E/S em bloco
+// Uma chamada que não pode continuar (dispositivo não pronto ou página do
+// buffer fora da memória) bloqueia o processo com o PC de volta na
+// instrução CHAMAS; quando ele for desbloqueado, a chamada é refeita e
+// continua a partir de proc->bloco_feito
+
+static void so_refaz_chamada(processo_t *proc) {
+  proc_set_pc(proc, proc_get_pc(proc) - 1);
+}
+
+static void so_termina_bloco(processo_t *proc, int retorno) {
+  proc->bloco_feito = -1;
+  proc_set_a(proc, retorno);
 }
 
-// Função para encontrar um índice livre na tabela de processos
-static int encontra_indice_livre(so_t *self) {
-  for (int i = 0; i < MAX_PROCESSOS; i++) {
-    if (self->tabela_processos[i].pid == PID_NENHUM) {
-      return i;
+// Lê os parâmetros da chamada (endereço do buffer e número de caracteres)
+// Só na primeira vez; quando a chamada é refeita, usa os guardados no
+// descritor do processo
+// Retorna false se a chamada não deve continuar agora: o processo foi
+// bloqueado esperando página ou a chamada terminou com erro
+static bool so_le_parametros_bloco(so_t *self, processo_t *proc, int *pender, int *pn) {
+  if (proc->bloco_feito >= 0) {
+    *pender = proc->bloco_ender;
+    *pn = proc->bloco_n;
+    return true;
+  }
+  err_t err = so_le_mem_proc(self, proc, proc_get_x(proc), pender);
+  if (err == ERR_OK) err = so_le_mem_proc(self, proc, proc_get_x(proc) + 1, pn);
+  if (err == ERR_PAG_AUSENTE) {
+    so_refaz_chamada(proc);
+    return false;
+  }
+  if (err != ERR_OK || *pn < 0) {
+    so_termina_bloco(proc, -1);
+    return false;
+  }
+  proc->bloco_ender = *pender;
+  proc->bloco_n = *pn;
+  proc->bloco_feito = 0;
+  return true;
+}
+
+// Trata o erro 'err' no acesso ao buffer; retorna true se teve erro
+static bool so_erro_no_buffer(processo_t *proc, err_t err) {
+  if (err == ERR_OK) return false;
+  if (err == ERR_PAG_AUSENTE) {
+    so_refaz_chamada(proc);
+  } else {
+    so_termina_bloco(proc, -1);
+  }
+  return true;
+}
+
+static bool so_dispositivo_pronto(so_t *self, int disp) {
+  int estado;
+  return es_le(self->es, disp, &estado) == ERR_OK && estado != 0;
+}
+
+// Implementação da chamada de sistema SO_ESCR_BLOCO
+static void so_chamada_escr_bloco(so_t *self) {
+  processo_t *proc = self->processo_corrente;
+  int ender, n;
+  if (!so_le_parametros_bloco(self, proc, &ender, &n)) return;
+  while (proc->bloco_feito < n) {
+    if (!so_dispositivo_pronto(self, proc_get_dispositivo_saida_ok(proc))) {
+      so_refaz_chamada(proc);
+      bloqueia_processo(self, ESCRITA);
+      return;
     }
+    int caractere;
+    err_t err = so_le_mem_proc(self, proc, ender + proc->bloco_feito, &caractere);
+    if (so_erro_no_buffer(proc, err)) return;
+    es_escreve(self->es, proc_get_dispositivo_saida(proc), caractere);
+    proc->bloco_feito++;
+  }
+  so_termina_bloco(proc, n);
+}
+
+// Implementação da chamada de sistema SO_LE_BLOCO
+static void so_chamada_le_bloco(so_t *self) {
+  processo_t *proc = self->processo_corrente;
+  int ender, n;
+  if (!so_le_parametros_bloco(self, proc, &ender, &n)) return;
+  while (proc->bloco_feito < n) {
+    if (!so_dispositivo_pronto(self, proc_get_dispositivo_entrada_ok(proc))) {
+      if (proc->bloco_feito > 0) break;
+      so_refaz_chamada(proc);
+      bloqueia_processo(self, LEITURA);
+      return;
+    }
+    // garante a página do buffer antes de tirar o caractere do dispositivo
+    int endfis;
+    err_t err = so_traduz_end_proc(self, proc, ender + proc->bloco_feito, &endfis);
+    if (so_erro_no_buffer(proc, err)) return;
+    int caractere;
+    es_le(self->es, proc_get_dispositivo_entrada(proc), &caractere);
+    mem_escreve(self->mem, endfis, caractere);
+    proc->bloco_feito++;
   }
-  return -1;  // Retorna -1 se não houver espaço livre
+  so_termina_bloco(proc, proc->bloco_feito);
+}
+
+// Implementação da chamada de sistema SO_LE_LINHA
+static void so_chamada_le_linha(so_t *self) {
+  processo_t *proc = self->processo_corrente;
+  int ender, n;
+  if (!so_le_parametros_bloco(self, proc, &ender, &n)) return;
+  if (n < 1) {
+    so_termina_bloco(proc, -1);
+    return;
+  }
+  // cada caractere é escrito no lugar do terminador, que avança junto
+  int endfis;
+  err_t err = so_traduz_end_proc(self, proc, ender + proc->bloco_feito, &endfis);
+  if (so_erro_no_buffer(proc, err)) return;
+  while (proc->bloco_feito < n - 1) {
+    if (!so_dispositivo_pronto(self, proc_get_dispositivo_entrada_ok(proc))) {
+      so_refaz_chamada(proc);
+      bloqueia_processo(self, LEITURA);
+      return;
+    }
+    int caractere;
+    es_le(self->es, proc_get_dispositivo_entrada(proc), &caractere);
+    if (caractere == '\n') break;
+    mem_escreve(self->mem, endfis, caractere);
+    proc->bloco_feito++;
+    err = so_traduz_end_proc(self, proc, ender + proc->bloco_feito, &endfis);
+    if (so_erro_no_buffer(proc, err)) return;
+  }
+  mem_escreve(self->mem, endfis, 0);
+  so_termina_bloco(proc, proc->bloco_feito);
+}
+
+// Função para ler o nome do processo da memória
+static err_t le_nome_do_processso(so_t *self, int ender_proc, int tam, char nome[tam]) {
+  return copia_str_do_proc(self, self->processo_corrente, tam, nome, ender_proc);
 }
 
 // Função principal da chamada de sistema SO_CRIA_PROC
 static void so_chamada_cria_proc(so_t *self) {
-  self->quantidade_processos++;
-
   char nome[100];
-  le_nome_do_processso(self, self->processo_corrente->x, nome);  // Lê o nome do processo
-
-  // Carrega o programa na memória
-  int ender_carga = so_carrega_programa(self, nome);
+  err_t err = le_nome_do_processso(self, self->processo_corrente->x, sizeof(nome), nome);
+  if (err == ERR_PAG_AUSENTE) {
+    // o processo ficou bloqueado esperando a página com o nome; volta o PC
+    //   para a instrução CHAMAS, para a chamada ser refeita quando ele
+    //   for desbloqueado
+    proc_set_pc(self->processo_corrente, proc_get_pc(self->processo_corrente) - 1);
+    return;
+  }
+  if (err != ERR_OK) {
+    proc_set_a(self->processo_corrente, -1);
+    return;
+  }
 
-  // Encontra um índice livre na tabela de processos
-  int indice_livre = encontra_indice_livre(self);
-  if (indice_livre == -1) {
-    return;  // Não há espaço para criar um novo processo
+  // Pega um descritor livre na tabela de processos (a tabela cresce se
+  //   precisar) e carrega o programa na memória secundária
+  processo_t *novo_proc = so_aloca_processo(self);
+  int ender_carga = so_carrega_processo(self, novo_proc, nome);
+  if (ender_carga < 0) {
+    tabproc_libera(self->tabela_processos, novo_proc);
+    proc_set_a(self->processo_corrente, -1);
+    return;
   }
+  self->quantidade_processos++;
 
   // Cria e configura o novo processo
-  processo_t *novo_proc = &self->tabela_processos[indice_livre];
-  configura_novo_processo(novo_proc, self->contador_pid++, ender_carga);
+  configura_novo_processo(self, novo_proc, self->contador_pid++, ender_carga);
+  if (self->perfil != NULL) {
+    perfil_novo_processo(self->perfil, novo_proc->pid, nome, ender_carga);
+  }
+  so_registra_processo(self, novo_proc);
   
   // Define o dispositivo de saída
-  define_dispositivos(novo_proc);
+  define_dispositivos(self, novo_proc);
 
-  fila_insere(self->fila_processos,novo_proc);
+  so_insere_pronto(self, novo_proc);
 
   // Define o PID do novo processo no registrador A do processo corrente
   proc_set_a(self->processo_corrente,proc_get_pid(novo_proc));
@@ -940,70 +1561,859 @@ static void so_chamada_mata_proc(so_t *self) {
   processo_t *proc = self->processo_corrente;
 
   if (proc->x != 0) {
-    int index = so_busca_indice_por_pid(self, proc_get_x(self->processo_corrente));
-    proc = &self->tabela_processos[index];
+    proc = tabproc_busca(self->tabela_processos, proc_get_x(self->processo_corrente));
+    if (proc == NULL) {
+      proc_set_a(self->processo_corrente, -1);
+      return;
+    }
+  }
+  so_mata_processo(self, proc);
+}
+
+// Termina o processo, liberando a memória que ele ocupa
+// as métricas são guardadas e o descritor volta para a tabela, para ser
+//   usado por outro processo
+static void so_mata_processo(so_t *self, processo_t *proc) {
+  if (proc_get_estado(proc) == BLOQUEADO) {
+    fila_remove(fila_do_processo(proc), proc);
+  } else {
+    so_remove_pronto(self, proc);
+  }
+  proc_set_estado(proc, FINALIZADO, self->ultimo_relogio);
+  // acorda quem estava esperando este processo terminar
+  processo_t *esperando;
+  while ((esperando = fila_primeiro(&proc->esperando)) != NULL) {
+    so_desbloqueia(self, esperando);
+    console_printf("SO: Processo PID=%d desbloqueado após término do processo PID=%d.\n", esperando->pid, proc->pid);
   }
-  proc_set_estado(proc,FINALIZADO);
-  remove_fila(self->fila_processos,proc);
+  so_libera_memoria(self, proc);
+  self->quadros_mudaram = true;
+  so_libera_area_disco(self, proc);
+  self->metricas_pid[proc->pid] = proc->metricas;
+  if (self->perfil != NULL) perfil_fim_processo(self->perfil, proc->pid);
+  if (self->processo_corrente == proc) {
+    self->processo_corrente = NULL;
+  }
+  tabproc_libera(self->tabela_processos, proc);
 }
 
 // Implementação da chamada de sistema SO_ESPERA_PROC
 // Bloqueia o processo chamador até que o processo com PID X termine.
+// Se o pid nunca foi de um processo, retorna erro sem bloquear; se o
+// processo já terminou, retorna sem bloquear.
 static void so_chamada_espera_proc(so_t *self) {
+  int pid = proc_get_x(self->processo_corrente);
+  if (pid < 0 || pid >= self->contador_pid) {
+    proc_set_a(self->processo_corrente, -1);
+    return;
+  }
+  if (so_pid_terminou(self, pid)) {
+    return;
+  }
   bloqueia_processo(self, ESPERA);
 }
 
 // CARGA DE PROGRAMA {{{1
 
-// carrega o programa na memória
-// retorna o endereço de carga ou -1
-static int so_carrega_programa(so_t *self, char *nome_do_executavel)
+// carrega o programa na memória, a partir de 'base' se ele for relocável ou
+//   no endereço em que foi montado se não for
+// retorna o endereço de início da execução ou -1
+static int so_carrega_programa(so_t *self, char *nome_do_executavel, int base)
 {
-  // programa para executar na nossa CPU
-  programa_t *prog = prog_cria(nome_do_executavel);
+  // programa para executar na nossa CPU (pertence ao cache, não é destruído)
+  programa_t *prog = cache_prog_pega(self->cache_programas, nome_do_executavel);
   if (prog == NULL) {
     console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
     return -1;
   }
 
-  int end_ini = prog_end_carga(prog);
+  int carga = prog_end_carga(prog);
+  if (!prog_relocavel(prog)) base = carga;
+  int end_ini = base;
   int end_fim = end_ini + prog_tamanho(prog);
 
   for (int end = end_ini; end < end_fim; end++) {
-    if (mem_escreve(self->mem, end, prog_dado(prog, end)) != ERR_OK) {
+    int dado = prog_dado_relocado(prog, end - base + carga, base);
+    if (mem_escreve(self->mem, end, dado) != ERR_OK) {
       console_printf("Erro na carga da memória, endereco %d\n", end);
       return -1;
     }
   }
 
-  prog_destroi(prog);
   console_printf("SO: carga de '%s' em %d-%d", nome_do_executavel, end_ini, end_fim);
-  return end_ini;
+  return prog_end_inicio(prog) - carga + base;
+}
+
+// retorna true se tem transferência na fila para o trecho do disco entre
+//   'inicio' e 'inicio + tam'
+static bool so_area_em_transferencia(so_t *self, int inicio, int tam)
+{
+  for (int i = 0; i < self->n_transf; i++) {
+    transferencia_t *t = &self->transferencias[(self->transf_inicio + i) % self->max_transf];
+    if (t->end_disco >= inicio && t->end_disco < inicio + tam) return true;
+  }
+  return false;
+}
+
+// reserva 'tam' palavras no disco para a imagem de um processo
+// usa a primeira área liberada que couber, desde que não tenha gravação
+//   pendente de um processo que já terminou (que estragaria a imagem nova);
+//   senão, aloca depois da última área usada
+// retorna o endereço no disco, ou -1 se não tiver espaço
+static int so_aloca_area_disco(so_t *self, int tam)
+{
+  for (int i = 0; i < self->n_areas_livres; i++) {
+    area_disco_t *area = &self->areas_livres[i];
+    if (area->tam < tam || so_area_em_transferencia(self, area->inicio, area->tam)) {
+      continue;
+    }
+    int inicio = area->inicio;
+    area->inicio += tam;
+    area->tam -= tam;
+    if (area->tam == 0) {
+      *area = self->areas_livres[--self->n_areas_livres];
+    }
+    return inicio;
+  }
+  if (self->disco_livre + tam > self->disco_tam) return -1;
+  int inicio = self->disco_livre;
+  self->disco_livre += tam;
+  return inicio;
+}
+
+static void so_libera_area_disco(so_t *self, processo_t *proc)
+{
+  int tam = proc->n_paginas * self->tam_pagina;
+  if (tam == 0) return;
+  if (self->n_areas_livres == self->max_areas_livres) {
+    self->max_areas_livres = self->max_areas_livres == 0 ? 16 : 2 * self->max_areas_livres;
+    self->areas_livres = realloc(self->areas_livres,
+                                 self->max_areas_livres * sizeof(*self->areas_livres));
+    assert(self->areas_livres != NULL);
+  }
+  self->areas_livres[self->n_areas_livres].inicio = proc->end_disco;
+  self->areas_livres[self->n_areas_livres].tam = tam;
+  self->n_areas_livres++;
+  proc->n_paginas = 0;
+}
+
+// carrega o programa no disco, como imagem do processo 'proc'
+// a imagem começa no endereço virtual 0; o programa fica a partir de
+//   END_VIRTUAL_CARGA se for relocável, ou no endereço em que foi montado
+// nenhuma página é colocada na memória principal, elas serão trazidas na
+//   primeira vez que forem acessadas
+// retorna o endereço de início da execução ou -1
+static int so_carrega_processo(so_t *self, processo_t *proc, char *nome_do_executavel)
+{
+  programa_t *prog = cache_prog_pega(self->cache_programas, nome_do_executavel);
+  if (prog == NULL) {
+    console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
+    return -1;
+  }
+
+  int carga = prog_end_carga(prog);
+  int base = prog_relocavel(prog) ? END_VIRTUAL_CARGA : carga;
+  int end_ini = base;
+  int end_fim = end_ini + prog_tamanho(prog);
+  int n_paginas = (end_fim + self->tam_pagina - 1) / self->tam_pagina;
+  int end_disco = end_ini < 0 ? -1 : so_aloca_area_disco(self, n_paginas * self->tam_pagina);
+  if (end_disco < 0) {
+    console_printf("Sem espaço no disco para o programa '%s'\n", nome_do_executavel);
+    return -1;
+  }
+
+  proc->end_disco = end_disco;
+  proc->n_paginas = n_paginas;
+  // a carga é feita pelo acesso direto do disco, sem latência
+  es_escreve(self->es, D_DISCO_END_DISCO, proc->end_disco);
+  for (int end = 0; end < n_paginas * self->tam_pagina; end++) {
+    int dado = 0;
+    if (end >= end_ini && end < end_fim) {
+      dado = prog_dado_relocado(prog, end - base + carga, base);
+    }
+    es_escreve(self->es, D_DISCO_DADO, dado);
+  }
+  proc->tabpag = tabpag_cria();
+
+  console_printf("SO: carga de '%s' em %d-%d (%d páginas)",
+                 nome_do_executavel, end_ini, end_fim, n_paginas);
+  return prog_end_inicio(prog) - carga + base;
+}
+
+// MEMÓRIA VIRTUAL {{{1
+
+int so_quadros_para_paginas(so_param_t *param, int tam_mem, int tam_pagina)
+{
+  int primeiro_quadro = (END_INICIO_USUARIO + tam_pagina - 1) / tam_pagina;
+  int n_quadros = tam_mem / tam_pagina - primeiro_quadro;
+  if (param->max_quadros > 0 && n_quadros > param->max_quadros) {
+    n_quadros = param->max_quadros;
+  }
+  return n_quadros > 0 ? n_quadros : 0;
+}
+
+static void so_inicializa_memoria(so_t *self)
+{
+  self->disco_livre = 0;
+  if (es_le(self->es, D_DISCO_TAMANHO, &self->disco_tam) != ERR_OK) {
+    console_printf("SO: problema no acesso ao disco");
+    self->erro_interno = true;
+    self->disco_tam = 0;
+  }
+  self->areas_livres = NULL;
+  self->n_areas_livres = 0;
+  self->max_areas_livres = 0;
+  self->transf_inicio = 0;
+  self->n_transf = 0;
+  self->primeiro_quadro = (END_INICIO_USUARIO + self->tam_pagina - 1) / self->tam_pagina;
+  self->n_quadros = so_quadros_para_paginas(&self->param, mem_tam(self->mem),
+                                            self->tam_pagina);
+  if (self->n_quadros < MIN_QUADROS_POR_PROCESSO) {
+    // a memória (ou a página) configurada não deixa espaço para processos
+    //   (o main não deveria ter deixado chegar aqui)
+    console_printf("SO: não sobra memória para quadros de página");
+    self->erro_interno = true;
+    self->n_quadros = 0;
+  }
+  self->quadros = malloc(self->n_quadros * sizeof(*self->quadros));
+  self->quadros_livres = malloc(self->n_quadros * sizeof(*self->quadros_livres));
+  self->max_transf = 2 * self->n_quadros;
+  self->transferencias = malloc(self->max_transf * sizeof(*self->transferencias));
+  assert(self->n_quadros == 0
+         || (self->quadros != NULL && self->quadros_livres != NULL
+             && self->transferencias != NULL));
+  // empilha ao contrário, para que os quadros sejam usados em ordem crescente
+  self->n_quadros_livres = 0;
+  for (int i = self->n_quadros - 1; i >= 0; i--) {
+    self->quadros[i].dono = NULL;
+    self->quadros[i].em_transito = false;
+    self->quadros_livres[self->n_quadros_livres++] = i;
+  }
+  self->ponteiro_relogio = 0;
+  self->contador_carga = 0;
+  self->faltante = NULL;
+}
+
+// zera o bit de acesso da página que está no quadro q
+// a TLB também é avisada, senão os próximos acessos não marcariam o bit
+static void so_zera_bit_acesso(so_t *self, quadro_t *q)
+{
+  tabpag_zera_bit_acesso(q->dono->tabpag, q->pagina);
+  mmu_invalida_pagina(self->mmu, q->dono->tabpag, q->pagina);
+}
+
+static bool so_bit_acesso(quadro_t *q)
+{
+  return tabpag_bit_acesso(q->dono->tabpag, q->pagina);
+}
+
+static bool so_bit_alteracao(quadro_t *q)
+{
+  return tabpag_bit_alteracao(q->dono->tabpag, q->pagina);
+}
+
+// um quadro pode ser escolhido para substituição se tiver uma página que
+//   não está sendo trazida do disco nem é uma das duas últimas trazidas para
+//   o dono, e se o dono continuar com pelo menos MIN_QUADROS_POR_PROCESSO
+//   quadros (contando o que o faltante vai ganhar, se for dele)
+static bool so_quadro_substituivel(so_t *self, quadro_t *q)
+{
+  if (q->dono == NULL || q->em_transito) return false;
+  if (q->ordem_carga >= q->dono->penultima_carga) return false;
+  if (q->dono == self->faltante) {
+    return q->dono->n_quadros >= MIN_QUADROS_POR_PROCESSO;
+  }
+  return q->dono->n_quadros > MIN_QUADROS_POR_PROCESSO;
+}
+
+// avança o ponteiro do relógio, retorna o quadro onde ele estava
+static int so_avanca_ponteiro(so_t *self)
+{
+  int q = self->ponteiro_relogio;
+  self->ponteiro_relogio = (q + 1) % self->n_quadros;
+  return q;
+}
+
+// as funções de escolha de vítima retornam o índice do quadro a ser
+//   substituído, ou -1 se nenhum quadro puder ser substituído agora
+
+// FIFO: a página que está há mais tempo na memória
+static int so_vitima_fifo(so_t *self)
+{
+  int vitima = -1;
+  for (int q = 0; q < self->n_quadros; q++) {
+    if (!so_quadro_substituivel(self, &self->quadros[q])) continue;
+    if (vitima == -1
+        || self->quadros[q].ordem_carga < self->quadros[vitima].ordem_carga) {
+      vitima = q;
+    }
+  }
+  return vitima;
+}
+
+// segunda chance: FIFO circular, mas páginas acessadas têm o bit zerado e
+//   são puladas
+static int so_vitima_segunda_chance(so_t *self)
+{
+  for (int i = 0; i < 2 * self->n_quadros; i++) {
+    int q = so_avanca_ponteiro(self);
+    if (!so_quadro_substituivel(self, &self->quadros[q])) continue;
+    if (!so_bit_acesso(&self->quadros[q])) return q;
+    so_zera_bit_acesso(self, &self->quadros[q]);
+  }
+  return -1;
+}
+
+// envelhecimento: a página com o menor contador (usada há mais tempo)
+static int so_vitima_envelhecimento(so_t *self)
+{
+  int vitima = -1;
+  for (int q = 0; q < self->n_quadros; q++) {
+    if (!so_quadro_substituivel(self, &self->quadros[q])) continue;
+    if (vitima == -1 || self->quadros[q].idade < self->quadros[vitima].idade) {
+      vitima = q;
+    }
+  }
+  return vitima;
+}
+
+// WSClock: no relógio, a primeira página fora do conjunto de trabalho (não
+//   acessada há mais de WSCLOCK_TAU) que não foi alterada; se não tiver,
+//   a primeira alterada fora do conjunto de trabalho; se não tiver, a usada
+//   há mais tempo
+// a gravação de uma página alterada é enfileirada antes da leitura que vai
+//   ocupar o quadro, então em vez de agendar gravações e continuar
+//   procurando, como no algoritmo original, a página alterada é escolhida
+static int so_vitima_wsclock(so_t *self)
+{
+  int agora = self->ultimo_relogio;
+  int alterada = -1;
+  for (int i = 0; i < 2 * self->n_quadros; i++) {
+    int q = so_avanca_ponteiro(self);
+    quadro_t *quadro = &self->quadros[q];
+    if (!so_quadro_substituivel(self, quadro)) continue;
+    if (so_bit_acesso(quadro)) {
+      so_zera_bit_acesso(self, quadro);
+      quadro->ultimo_uso = agora;
+    } else if (agora - quadro->ultimo_uso > WSCLOCK_TAU) {
+      if (!so_bit_alteracao(quadro)) return q;
+      if (alterada == -1) alterada = q;
+    }
+  }
+  if (alterada != -1) return alterada;
+  int vitima = -1;
+  for (int q = 0; q < self->n_quadros; q++) {
+    if (!so_quadro_substituivel(self, &self->quadros[q])) continue;
+    if (vitima == -1
+        || self->quadros[q].ultimo_uso < self->quadros[vitima].ultimo_uso) {
+      vitima = q;
+    }
+  }
+  return vitima;
+}
+
+static int so_escolhe_vitima_politica(so_t *self)
+{
+  switch (self->substituicao) {
+    case SUBST_FIFO:
+      return so_vitima_fifo(self);
+    case SUBST_SEGUNDA_CHANCE:
+      return so_vitima_segunda_chance(self);
+    case SUBST_ENVELHECIMENTO:
+      return so_vitima_envelhecimento(self);
+    case SUBST_WSCLOCK:
+      return so_vitima_wsclock(self);
+  }
+  return -1;
+}
+
+// escolhe o quadro para a página que falta ao processo 'proc'
+static int so_escolhe_vitima(so_t *self, processo_t *proc)
+{
+  self->faltante = proc;
+  int vitima = so_escolhe_vitima_politica(self);
+  self->faltante = NULL;
+  return vitima;
+}
+
+static void so_envelhece_paginas(so_t *self)
+{
+  for (int q = 0; q < self->n_quadros; q++) {
+    quadro_t *quadro = &self->quadros[q];
+    if (quadro->dono == NULL || quadro->em_transito) continue;
+    quadro->idade >>= 1;
+    if (so_bit_acesso(quadro)) {
+      quadro->idade |= 0x80;
+      so_zera_bit_acesso(self, quadro);
+    }
+  }
+}
+
+// TRANSFERÊNCIAS COM O DISCO {{{1
+
+// programa o disco para realizar a primeira transferência da fila
+static void so_disco_inicia(so_t *self)
+{
+  transferencia_t *t = &self->transferencias[self->transf_inicio];
+  int end_mem = (self->primeiro_quadro + t->quadro) * self->tam_pagina;
+  if (es_escreve(self->es, D_DISCO_END_DISCO, t->end_disco) != ERR_OK
+      || es_escreve(self->es, D_DISCO_END_MEM, end_mem) != ERR_OK
+      || es_escreve(self->es, D_DISCO_QUANT, self->tam_pagina) != ERR_OK
+      || es_escreve(self->es, D_DISCO_COMANDO, t->comando) != ERR_OK) {
+    console_printf("SO: problema na programação do disco");
+    self->erro_interno = true;
+  }
+}
+
+// coloca uma transferência na fila; se o disco estiver livre, inicia
+static void so_disco_enfileira(so_t *self, int comando, int end_disco, int quadro)
+{
+  assert(self->n_transf < self->max_transf);
+  int pos = (self->transf_inicio + self->n_transf) % self->max_transf;
+  self->transferencias[pos].comando = comando;
+  self->transferencias[pos].end_disco = end_disco;
+  self->transferencias[pos].quadro = quadro;
+  self->n_transf++;
+  if (self->n_transf == 1) so_disco_inicia(self);
+}
+
+// interrupção gerada quando o disco termina uma transferência
+// se foi a leitura de uma página, ela passa a ser válida na tabela do processo,
+//   que é desbloqueado
+static void so_trata_irq_disco(so_t *self)
+{
+  if (es_escreve(self->es, D_DISCO_INTERRUPCAO, 0) != ERR_OK) {
+    console_printf("SO: problema no acesso ao disco");
+    self->erro_interno = true;
+    return;
+  }
+  if (self->n_transf == 0) {
+    console_printf("SO: interrupção do disco sem transferência");
+    return;
+  }
+  transferencia_t *t = &self->transferencias[self->transf_inicio];
+  self->transf_inicio = (self->transf_inicio + 1) % self->max_transf;
+  self->n_transf--;
+  if (t->comando == DISCO_CMD_LE) {
+    quadro_t *quadro = &self->quadros[t->quadro];
+    quadro->em_transito = false;
+    if (quadro->dono == NULL) {
+      // o processo morreu enquanto a página era lida
+      self->quadros_livres[self->n_quadros_livres++] = t->quadro;
+    } else {
+      tabpag_define_quadro(quadro->dono->tabpag, quadro->pagina,
+                           self->primeiro_quadro + t->quadro);
+      // a página vai ser acessada assim que o processo voltar a executar;
+      //   sem isso, ela poderia ser escolhida como vítima antes
+      tabpag_marca_bit_acesso(quadro->dono->tabpag, quadro->pagina, false);
+      quadro->ultimo_uso = self->ultimo_relogio;
+      // desbloqueia o processo que esperava a página
+      processo_t *dono = quadro->dono;
+      if (fila_do_processo(dono) == &self->espera_pagina
+          && dono->pagina_faltante == quadro->pagina) {
+        dono->pagina_faltante = -1;
+        so_desbloqueia(self, dono);
+      }
+    }
+    // o quadro pode ser escolhido para substituição de novo
+    self->quadros_mudaram = true;
+  }
+  if (self->n_transf > 0) so_disco_inicia(self);
+}
+
+// FALTA DE PÁGINA {{{1
+
+// tira da memória principal a página que está no quadro q, enfileirando
+//   a gravação no disco se ela tiver sido alterada
+static void so_retira_pagina(so_t *self, int q)
+{
+  quadro_t *quadro = &self->quadros[q];
+  processo_t *dono = quadro->dono;
+  if (so_bit_alteracao(quadro)) {
+    so_disco_enfileira(self, DISCO_CMD_ESCREVE,
+                       dono->end_disco + quadro->pagina * self->tam_pagina, q);
+    dono->metricas.paginas_gravadas++;
+  }
+  dono->metricas.paginas_substituidas++;
+  tabpag_invalida_pagina(dono->tabpag, quadro->pagina);
+  mmu_invalida_pagina(self->mmu, dono->tabpag, quadro->pagina);
+  dono->n_quadros--;
+  quadro->dono = NULL;
+}
+
+// controle de carga: quando não tem quadro para a página que falta sem
+//   deixar algum processo com menos de MIN_QUADROS_POR_PROCESSO, em vez de
+//   trocar páginas entre processos que não vão conseguir executar, um
+//   processo é suspenso: todas as páginas dele saem da memória principal
+// um processo suspenso volta a ganhar quadros quando tiver uma falta de
+//   página e tiver MIN_QUADROS_POR_PROCESSO quadros livres (ou uma vítima)
+
+// tira da memória principal todas as páginas do processo
+static void so_suspende(so_t *self, processo_t *proc)
+{
+  for (int q = 0; q < self->n_quadros && proc->n_quadros > 0; q++) {
+    if (self->quadros[q].dono != proc) continue;
+    so_retira_pagina(self, q);
+    self->quadros_livres[self->n_quadros_livres++] = q;
+  }
+  self->quadros_mudaram = true;
+}
+
+// escolhe um processo bloqueado que não seja 'proc' para ser suspenso, ou
+//   NULL se não tiver; os que esperam página têm quadro em transferência
+static processo_t *so_escolhe_suspenso(so_t *self, processo_t *proc)
+{
+  for (int i = 0; i < tabproc_n_processos(self->tabela_processos); i++) {
+    processo_t *outro = tabproc_processo(self->tabela_processos, i);
+    if (outro == proc || outro->n_quadros == 0) continue;
+    if (proc_get_estado(outro) != BLOQUEADO) continue;
+    if (fila_do_processo(outro) == &self->espera_pagina) continue;
+    return outro;
+  }
+  return NULL;
+}
+
+// retorna um quadro livre para a página que falta a 'proc', ou -1 se não
+//   tiver como liberar um agora
+// um processo sem quadros (suspenso ou recém-criado) só usa os livres se
+//   puder chegar ao mínimo com eles
+static int so_obtem_quadro(so_t *self, processo_t *proc)
+{
+  for (;;) {
+    if (self->n_quadros_livres > 0
+        && (proc->n_quadros > 0
+            || self->n_quadros_livres >= MIN_QUADROS_POR_PROCESSO)) {
+      return self->quadros_livres[--self->n_quadros_livres];
+    }
+    int q = so_escolhe_vitima(self, proc);
+    if (q != -1) {
+      so_retira_pagina(self, q);
+      return q;
+    }
+    processo_t *suspenso = so_escolhe_suspenso(self, proc);
+    if (suspenso == NULL) return -1;
+    so_suspende(self, suspenso);
+  }
+}
+
+// o processo está em espera_quadro; se conseguir um quadro, pede a leitura
+//   da página e passa para espera_pagina
+// se não conseguir, os quadros que sobram são o mínimo de processos que
+//   podem executar, ou estão esperando o disco: o processo é suspenso e
+//   tenta de novo quando algum quadro for liberado
+static void so_inicia_falta_de_pagina(so_t *self, processo_t *proc)
+{
+  int q = so_obtem_quadro(self, proc);
+  if (q == -1) {
+    if (proc->n_quadros > 0) so_suspende(self, proc);
+    return;
+  }
+  quadro_t *quadro = &self->quadros[q];
+  quadro->dono = proc;
+  quadro->pagina = proc->pagina_faltante;
+  quadro->ordem_carga = self->contador_carga++;
+  quadro->idade = 0x80;
+  quadro->ultimo_uso = self->ultimo_relogio;
+  quadro->em_transito = true;
+  proc->n_quadros++;
+  proc->penultima_carga = proc->ultima_carga;
+  proc->ultima_carga = quadro->ordem_carga;
+  fila_remove(&self->espera_quadro, proc);
+  fila_insere_fim(&self->espera_pagina, proc);
+  so_disco_enfileira(self, DISCO_CMD_LE,
+                     proc->end_disco + quadro->pagina * self->tam_pagina, q);
+}
+
+static bool so_trata_falta_de_pagina(so_t *self, processo_t *proc, int pagina)
+{
+  if (pagina < 0 || pagina >= proc->n_paginas) return false;
+  proc->metricas.faltas_de_pagina++;
+  proc->pagina_faltante = pagina;
+  bloqueia_processo(self, PAGINACAO);
+  so_inicia_falta_de_pagina(self, proc);
+  return true;
+}
+
+static void so_libera_memoria(so_t *self, processo_t *proc)
+{
+  if (proc->tabpag == NULL) return;
+  for (int q = 0; q < self->n_quadros; q++) {
+    quadro_t *quadro = &self->quadros[q];
+    if (quadro->dono != proc) continue;
+    quadro->dono = NULL;
+    // se estiver esperando o disco, o quadro é liberado quando a leitura
+    //   terminar
+    if (!quadro->em_transito) {
+      self->quadros_livres[self->n_quadros_livres++] = q;
+    }
+  }
+  proc->n_quadros = 0;
+  mmu_invalida_tabpag(self->mmu, proc->tabpag);
+  mmu_define_tabpag(self->mmu, NULL);
+  tabpag_destroi(proc->tabpag);
+  proc->tabpag = NULL;
 }
 
 // ACESSO À MEMÓRIA DOS PROCESSOS {{{1
 
-// copia uma string da memória do simulador para o vetor str.
-// retorna false se erro (string maior que vetor, valor não char na memória,
-//   erro de acesso à memória)
-// T1: deveria verificar se a memória pertence ao processo
-static bool copia_str_da_mem(int tam, char str[tam], mem_t *mem, int ender)
+// traduz o endereço virtual 'ender' do processo 'proc' para o endereço
+//   físico, para uma escrita pelo SO (a página é marcada como alterada)
+// se a página não estiver na memória principal, o processo é bloqueado até
+//   ela ser trazida do disco, e retorna ERR_PAG_AUSENTE
+static err_t so_traduz_end_proc(so_t *self, processo_t *proc, int ender, int *pendfis)
+{
+  if (ender < 0 || proc->tabpag == NULL) return ERR_END_INV;
+  int pagina = ender / self->tam_pagina;
+  int quadro;
+  if (tabpag_traduz(proc->tabpag, pagina, &quadro) != ERR_OK) {
+    if (!so_trata_falta_de_pagina(self, proc, pagina)) return ERR_END_INV;
+    return ERR_PAG_AUSENTE;
+  }
+  tabpag_marca_bit_acesso(proc->tabpag, pagina, true);
+  *pendfis = quadro * self->tam_pagina + ender % self->tam_pagina;
+  return ERR_OK;
+}
+
+// lê o valor no endereço virtual 'ender' do processo 'proc' (a página é
+//   marcada como acessada, como em so_traduz_end_proc)
+// se a página não estiver na memória principal, o processo é bloqueado até
+//   ela ser trazida do disco, e retorna ERR_PAG_AUSENTE
+static err_t so_le_mem_proc(so_t *self, processo_t *proc, int ender, int *pvalor)
+{
+  if (ender < 0 || proc->tabpag == NULL) return ERR_END_INV;
+  int pagina = ender / self->tam_pagina;
+  int quadro;
+  if (tabpag_traduz(proc->tabpag, pagina, &quadro) != ERR_OK) {
+    if (!so_trata_falta_de_pagina(self, proc, pagina)) return ERR_END_INV;
+    return ERR_PAG_AUSENTE;
+  }
+  tabpag_marca_bit_acesso(proc->tabpag, pagina, false);
+  return mem_le(self->mem, quadro * self->tam_pagina + ender % self->tam_pagina, pvalor);
+}
+
+// copia uma string da memória do processo para o vetor str.
+// retorna erro se a string for maior que o vetor, tiver valor não char ou
+//   estiver fora da memória do processo, ou ERR_PAG_AUSENTE se uma página
+//   precisou ser pedida ao disco (ver so_le_mem_proc)
+static err_t copia_str_do_proc(so_t *self, processo_t *proc, int tam, char str[tam], int ender)
 {
   for (int indice_str = 0; indice_str < tam; indice_str++) {
     int caractere;
-    if (mem_le(mem, ender + indice_str, &caractere) != ERR_OK) {
-      return false;
+    err_t err = so_le_mem_proc(self, proc, ender + indice_str, &caractere);
+    if (err != ERR_OK) {
+      return err;
     }
     if (caractere < 0 || caractere > 255) {
-      return false;
+      return ERR_END_INV;
     }
     str[indice_str] = caractere;
     if (caractere == 0) {
-      return true;
+      return ERR_OK;
     }
   }
   // estourou o tamanho de str
-  return false;
+  return ERR_END_INV;
+}
+
+// CHECKPOINT {{{1
+
+// as filas são gravadas como o número de processos seguido dos pids, na
+//   ordem da fila; na leitura, os processos (já restaurados) são colocados
+//   na fila na mesma ordem
+static bool so_grava_fila(FILE *arq, fila_t *fila)
+{
+  int n = 0;
+  for (processo_t *p = fila_primeiro(fila); p != NULL; p = fila_proximo(p)) n++;
+  if (!ESTADO_GRAVA(arq, n)) return false;
+  for (processo_t *p = fila_primeiro(fila); p != NULL; p = fila_proximo(p)) {
+    if (!ESTADO_GRAVA(arq, p->pid)) return false;
+  }
+  return true;
+}
+
+static bool so_le_fila(so_t *self, FILE *arq, fila_t *fila)
+{
+  int n;
+  if (!ESTADO_LE(arq, n)) return false;
+  for (int i = 0; i < n; i++) {
+    int pid;
+    if (!ESTADO_LE(arq, pid)) return false;
+    processo_t *proc = tabproc_busca(self->tabela_processos, pid);
+    if (proc == NULL || proc->fila != NULL) return false;
+    fila_insere_fim(fila, proc);
+  }
+  return true;
+}
+
+// todas as filas do SO, na ordem em que são gravadas
+static bool so_estado_filas(so_t *self, FILE *arq, bool grava)
+{
+#define FILA(f) (grava ? so_grava_fila(arq, f) : so_le_fila(self, arq, f))
+  if (!FILA(&self->fila_processos)
+      || !FILA(&self->espera_pagina)
+      || !FILA(&self->espera_quadro)) {
+    return false;
+  }
+  for (int i = 0; i < N_DISPOSITIVOS; i++) {
+    if (!FILA(&self->espera_dispositivo[i])) return false;
+  }
+  for (int i = 0; i < MLFQ_NIVEIS; i++) {
+    if (!FILA(&self->mlfq[i])) return false;
+  }
+  for (int i = 0; i < tabproc_n_processos(self->tabela_processos); i++) {
+    processo_t *proc = tabproc_processo(self->tabela_processos, i);
+    if (!FILA(&proc->esperando)) return false;
+  }
+  return true;
+#undef FILA
+}
+
+// as variáveis simples do SO, gravadas e lidas na mesma ordem
+static bool so_estado_variaveis(so_t *self, FILE *arq, bool grava)
+{
+#define VAR(v) (grava ? ESTADO_GRAVA(arq, self->v) : ESTADO_LE(arq, self->v))
+  return VAR(dispositivos_esperados) && VAR(terminais_mudaram)
+      && VAR(quadros_mudaram) && VAR(escalonador)
+      && VAR(mlfq_ocupados) && VAR(mlfq_tics_ate_reforco)
+      && VAR(disco_livre) && VAR(disco_tam) && VAR(n_areas_livres)
+      && VAR(transf_inicio) && VAR(n_transf)
+      && VAR(substituicao) && VAR(n_quadros_livres)
+      && VAR(ponteiro_relogio) && VAR(contador_carga)
+      && VAR(quantidade_processos) && VAR(quantum) && VAR(relogio)
+      && VAR(contador_pid) && VAR(erro_interno) && VAR(desligado)
+      && VAR(ultimo_relogio) && VAR(tempo_execucao) && VAR(tempo_ocioso)
+      && VAR(preempcoes_totais) && VAR(max_metricas_pid)
+      && VAR(tlb_acertos) && VAR(tlb_faltas);
+#undef VAR
+}
+
+bool so_grava_estado(so_t *self, FILE *arq)
+{
+  // a configuração da memória tem que ser a mesma na leitura
+  if (!ESTADO_GRAVA(arq, self->n_quadros)
+      || !ESTADO_GRAVA(arq, self->primeiro_quadro)
+      || !so_estado_variaveis(self, arq, true)
+      || !estado_grava_bytes(arq, self->interrupcoes, N_IRQ * sizeof(int))
+      || !estado_grava_bytes(arq, self->transferencias,
+                             self->max_transf * sizeof(*self->transferencias))
+      || !estado_grava_bytes(arq, self->quadros_livres,
+                             self->n_quadros * sizeof(*self->quadros_livres))
+      || !estado_grava_bytes(arq, self->areas_livres,
+                             self->n_areas_livres * sizeof(*self->areas_livres))
+      || !estado_grava_bytes(arq, self->metricas_pid,
+                             self->contador_pid * sizeof(*self->metricas_pid))) {
+    return false;
+  }
+
+  // os processos, na ordem da tabela, com a tabela de páginas de cada um
+  // os ponteiros do descritor são gravados, mas não são usados na leitura
+  int n = tabproc_n_processos(self->tabela_processos);
+  if (!ESTADO_GRAVA(arq, n)) return false;
+  for (int i = 0; i < n; i++) {
+    processo_t *proc = tabproc_processo(self->tabela_processos, i);
+    bool tem_tabpag = proc->tabpag != NULL;
+    if (!ESTADO_GRAVA(arq, *proc) || !ESTADO_GRAVA(arq, tem_tabpag)) return false;
+    if (tem_tabpag && !tabpag_grava_estado(proc->tabpag, arq)) return false;
+  }
+  int corrente = self->processo_corrente == NULL ? PID_NENHUM
+                                                 : self->processo_corrente->pid;
+  if (!ESTADO_GRAVA(arq, corrente)) return false;
+
+  // os quadros, com o pid do dono no lugar do ponteiro
+  for (int i = 0; i < self->n_quadros; i++) {
+    quadro_t q = self->quadros[i];
+    int dono = q.dono == NULL ? PID_NENHUM : q.dono->pid;
+    q.dono = NULL;
+    if (!ESTADO_GRAVA(arq, dono) || !ESTADO_GRAVA(arq, q)) return false;
+  }
+
+  return so_estado_filas(self, arq, true);
+}
+
+bool so_le_estado(so_t *self, FILE *arq)
+{
+  int n_quadros, primeiro_quadro;
+  if (tabproc_n_processos(self->tabela_processos) != 0
+      || !ESTADO_LE(arq, n_quadros) || n_quadros != self->n_quadros
+      || !ESTADO_LE(arq, primeiro_quadro) || primeiro_quadro != self->primeiro_quadro
+      || !so_estado_variaveis(self, arq, false)
+      || self->n_areas_livres < 0 || self->contador_pid < 0
+      || self->contador_pid > self->max_metricas_pid) {
+    return false;
+  }
+  self->max_areas_livres = self->n_areas_livres;
+  self->areas_livres = realloc(self->areas_livres,
+                               self->max_areas_livres * sizeof(*self->areas_livres));
+  self->metricas_pid = realloc(self->metricas_pid,
+                               self->max_metricas_pid * sizeof(*self->metricas_pid));
+  assert(self->max_areas_livres == 0 || self->areas_livres != NULL);
+  assert(self->max_metricas_pid == 0 || self->metricas_pid != NULL);
+  if (!estado_le_bytes(arq, self->interrupcoes, N_IRQ * sizeof(int))
+      || !estado_le_bytes(arq, self->transferencias,
+                          self->max_transf * sizeof(*self->transferencias))
+      || !estado_le_bytes(arq, self->quadros_livres,
+                          self->n_quadros * sizeof(*self->quadros_livres))
+      || !estado_le_bytes(arq, self->areas_livres,
+                          self->n_areas_livres * sizeof(*self->areas_livres))
+      || !estado_le_bytes(arq, self->metricas_pid,
+                          self->contador_pid * sizeof(*self->metricas_pid))) {
+    return false;
+  }
+
+  // os processos são alocados na mesma ordem, e ficam nas mesmas posições
+  //   da tabela
+  int n;
+  if (!ESTADO_LE(arq, n)) return false;
+  for (int i = 0; i < n; i++) {
+    processo_t lido;
+    bool tem_tabpag;
+    if (!ESTADO_LE(arq, lido) || !ESTADO_LE(arq, tem_tabpag)) return false;
+    processo_t *proc = so_aloca_processo(self);
+    int indice = proc->indice_tabela;
+    *proc = lido;
+    proc->indice_tabela = indice;
+    proc->fila_anterior = NULL;
+    proc->fila_proximo = NULL;
+    proc->fila = NULL;
+    fila_inicializa(&proc->esperando);
+    proc->tabpag = NULL;
+    so_registra_processo(self, proc);
+    if (tem_tabpag) {
+      proc->tabpag = tabpag_le_estado(arq);
+      if (proc->tabpag == NULL) return false;
+    }
+  }
+  int corrente;
+  if (!ESTADO_LE(arq, corrente)) return false;
+  self->processo_corrente = tabproc_busca(self->tabela_processos, corrente);
+
+  for (int i = 0; i < self->n_quadros; i++) {
+    int dono;
+    quadro_t *q = &self->quadros[i];
+    if (!ESTADO_LE(arq, dono) || !ESTADO_LE(arq, *q)) return false;
+    q->dono = tabproc_busca(self->tabela_processos, dono);
+  }
+
+  return so_estado_filas(self, arq, false);
+}
+
+int so_id_tabpag(void *arg, tabpag_t *tabpag)
+{
+  so_t *self = arg;
+  if (tabpag == NULL) return PID_NENHUM;
+  for (int i = 0; i < tabproc_n_processos(self->tabela_processos); i++) {
+    processo_t *proc = tabproc_processo(self->tabela_processos, i);
+    if (proc->tabpag == tabpag) return proc->pid;
+  }
+  return PID_NENHUM;
+}
+
+tabpag_t *so_tabpag_do_id(void *arg, int id)
+{
+  so_t *self = arg;
+  if (id == PID_NENHUM) return NULL;
+  processo_t *proc = tabproc_busca(self->tabela_processos, id);
+  return proc == NULL ? NULL : proc->tabpag;
 }
 
-// vim: foldmethod=marker
\ No newline at end of file
+// vim: foldmethod=marker
@@ -13,11 +13,95 @@ typedef struct so_t so_t;
 #include "cpu.h"
 #include "es.h"
 #include "console.h" // só para uma gambiarra
+#include <stdio.h>
+#include <stdbool.h>
+
+// políticas de escalonamento
+typedef enum {
+  ESCALONADOR_NORMAL,
+  ESCALONADOR_ROUND_ROBIN,
+  ESCALONADOR_ROUND_ROBIN_PRIORIDADE,
+  ESCALONADOR_MLFQ
+} escalonador_t;
+
+// políticas de escolha da página a ser substituída quando falta quadro livre
+typedef enum {
+  SUBST_FIFO,
+  SUBST_SEGUNDA_CHANCE,
+  SUBST_ENVELHECIMENTO,
+  SUBST_WSCLOCK
+} substituicao_t;
+
+// parâmetros de funcionamento do SO, escolhidos na execução para poder
+//   comparar configurações diferentes sem recompilar
+typedef struct {
+  escalonador_t escalonador;
+  substituicao_t substituicao;
+  // número de instruções entre interrupções do relógio
+  int intervalo_interrupcao;
+  // número de interrupções do relógio que um processo executa antes de
+  //   perder a CPU, nos escalonadores round-robin (a MLFQ tem um por nível)
+  int quantum;
+  // número máximo de quadros da memória principal usados para páginas (0
+  //   para usar toda a memória que sobra do SO, senão pelo menos
+  //   MIN_QUADROS_POR_PROCESSO)
+  int max_quadros;
+  // arquivo onde são gravadas as métricas quando o SO termina
+  char *arquivo_metricas;
+} so_param_t;
+
+// coloca em 'param' os valores padrão dos parâmetros
+void so_param_padrao(so_param_t *param);
+
+// número de quadros que uma instrução pode precisar ao mesmo tempo (a
+//   instrução, o argumento em outra página e o dado acessado)
+// a substituição não deixa um processo com menos quadros que isso; sem essa
+//   garantia, com pouca memória os processos podem ficar roubando as páginas
+//   uns dos outros sem nunca executar a instrução; quando não tem quadro
+//   sobrando, um processo é suspenso (ver so_suspende em so.c)
+// é também o mínimo de quadros para páginas com que o SO aceita executar
+#define MIN_QUADROS_POR_PROCESSO 3
+
+// retorna quantos quadros ficam para páginas com uma memória principal de
+//   'tam_mem' palavras e páginas de 'tam_pagina' palavras, tirando a parte
+//   do SO e respeitando o máximo de 'param'
+int so_quadros_para_paginas(so_param_t *param, int tam_mem, int tam_pagina);
+
+// altera o parâmetro 'nome' (o nome do campo de so_param_t) para 'valor'
+// o escalonador é um de "normal", "rr", "rrp" (round-robin com prioridade)
+//   e "mlfq"; a substituição é um de "fifo", "segunda_chance",
+//   "envelhecimento" e "wsclock"; os outros são números positivos (max_quadros
+//   pode ser 0 ou pelo menos MIN_QUADROS_POR_PROCESSO), menos o arquivo, que não é copiado (a string deve
+//   continuar existindo)
+// retorna false se o nome ou o valor forem inválidos
+bool so_param_altera(so_param_t *param, char *nome, char *valor);
 
 so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu,
-              es_t *es, console_t *console);
+              es_t *es, console_t *console, so_param_t *param);
 void so_destroi(so_t *self);
 
+// calcula e grava as métricas finais, se o SO ainda não fez isso ao desligar
+//   (a simulação foi interrompida antes, pelo limite de instruções ou pelo
+//   comando de fim); deve ser chamada depois da última instrução executada
+void so_encerra(so_t *self);
+
+// define o perfilador que deve ser informado sobre os processos (qual
+//   programa cada um executa e qual está executando); NULL para não ter
+void so_define_perfil(so_t *self, perfil_t *perfil);
+
+// grava no arquivo o estado do SO (processos, filas, tabelas de páginas,
+//   quadros, área de troca e métricas), ou lê o estado gravado (ver estado.h)
+// a leitura deve ser feita em um SO recém criado, antes de executar
+// retornam false em caso de erro
+bool so_grava_estado(so_t *self, FILE *arq);
+bool so_le_estado(so_t *self, FILE *arq);
+
+// identificam as tabelas de páginas dos processos pelo pid, para a MMU
+//   gravar e ler seu estado (seguem mmu_f_id_tabpag_t e mmu_f_tabpag_t);
+//   'arg' é o SO
+int so_id_tabpag(void *arg, tabpag_t *tabpag);
+tabpag_t *so_tabpag_do_id(void *arg, int id);
+
 // Chamadas de sistema
 // Uma chamada de sistema é realizada colocando a identificação da
 //   chamada (um dos valores abaixo) no registrador A e executando a
@@ -46,6 +130,29 @@ void so_destroi(so_t *self);
 // #define SO_SEL_LE      5
 // #define SO_SEL_ESCR    6
 
+// Chamadas de E/S em bloco
+// Transferem vários caracteres entre a memória do processo e o dispositivo
+//   corrente em uma chamada só. Recebem em X o endereço, na memória do
+//   processo, de um bloco com dois parâmetros: o endereço do buffer e o
+//   número de caracteres (n).
+// O processo só é bloqueado quando o dispositivo não tem como continuar a
+//   transferência; quando for desbloqueado, a chamada continua de onde parou.
+
+// lê até n caracteres do dispositivo de entrada para o buffer
+// bloqueia só se não tiver nenhum caractere disponível
+// retorna em A: o número de caracteres lidos ou um código de erro negativo
+#define SO_LE_BLOCO    10
+
+// escreve os n caracteres do buffer no dispositivo de saída
+// retorna em A: n se OK ou um código de erro negativo
+#define SO_ESCR_BLOCO  11
+
+// lê uma linha do dispositivo de entrada para o buffer (modo canônico):
+//   lê até um '\n' ou até ler n-1 caracteres; o '\n' não é colocado no
+//   buffer, a linha é terminada por um 0
+// retorna em A: o número de caracteres na linha ou um código de erro negativo
+#define SO_LE_LINHA    12
+
 
 // Chamadas para gerenciamento de processos
 // O sistema cria um processo automaticamente na sua inicialização,
@@ -4,6 +4,7 @@
 // so24b
 
 #include "tabpag.h"
+#include "estado.h"
 #include <stdlib.h>
 #include <assert.h>
 
@@ -135,3 +136,27 @@ err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro)
   *pquadro = self->tabela[pagina].quadro;
   return ERR_OK;
 }
+
+bool tabpag_grava_estado(tabpag_t *self, FILE *arq)
+{
+  return ESTADO_GRAVA(arq, self->tam_tab)
+      && estado_grava_bytes(arq, self->tabela,
+                            self->tam_tab * sizeof(*self->tabela));
+}
+
+tabpag_t *tabpag_le_estado(FILE *arq)
+{
+  int tam_tab;
+  if (!ESTADO_LE(arq, tam_tab) || tam_tab < 0) return NULL;
+  tabpag_t *self = tabpag_cria();
+  if (tam_tab > 0) {
+    self->tabela = malloc(tam_tab * sizeof(*self->tabela));
+    assert(self->tabela != NULL);
+    self->tam_tab = tam_tab;
+    if (!estado_le_bytes(arq, self->tabela, tam_tab * sizeof(*self->tabela))) {
+      tabpag_destroi(self);
+      return NULL;
+    }
+  }
+  return self;
+}
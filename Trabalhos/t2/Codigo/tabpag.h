@@ -13,6 +13,7 @@
 // mantém para cada página mapeada um bit de acesso e um bit de alteração
 
 #include "err.h"
+#include <stdio.h>
 #include <stdbool.h>
 
 // tipo opaco que representa a tabela de páginas
@@ -61,4 +62,12 @@ bool tabpag_bit_alteracao(tabpag_t *self, int pagina);
 // retorna ERR_PAG_AUSENTE (e não altera '*pquadro') se a página for inválida
 err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro);
 
+// grava a tabela no arquivo (ver estado.h)
+// retorna false em caso de erro
+bool tabpag_grava_estado(tabpag_t *self, FILE *arq);
+
+// cria uma tabela com o conteúdo gravado por tabpag_grava_estado
+// retorna NULL em caso de erro
+tabpag_t *tabpag_le_estado(FILE *arq);
+
 #endif // TABPAG_H
@@ -0,0 +1,190 @@
+// tabproc.c
+// tabela de processos do SO
+// simulador de computador
+// so24b
+
+#include "tabproc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// tamanho inicial do índice por pid (potência de 2)
+#define HASH_TAM_INICIAL 32
+
+struct tabproc_t {
+  // placas de descritores
+  processo_t **placas;
+  int n_placas;
+  // pilha de descritores livres
+  processo_t **livres;
+  int n_livres;
+  // descritores em uso; em_uso[proc->indice_tabela] == proc
+  processo_t **em_uso;
+  int n_em_uso;
+  // índice por pid, com endereçamento aberto e sondagem linear
+  // hash_tam é potência de 2; entradas vazias são NULL
+  processo_t **hash;
+  int hash_tam;
+  int hash_n;
+};
+
+tabproc_t *tabproc_cria(void)
+{
+  tabproc_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->placas = NULL;
+  self->n_placas = 0;
+  self->livres = NULL;
+  self->n_livres = 0;
+  self->em_uso = NULL;
+  self->n_em_uso = 0;
+  self->hash_tam = HASH_TAM_INICIAL;
+  self->hash_n = 0;
+  self->hash = calloc(self->hash_tam, sizeof(*self->hash));
+  assert(self->hash != NULL);
+  return self;
+}
+
+void tabproc_destroi(tabproc_t *self)
+{
+  if (self == NULL) return;
+  for (int i = 0; i < self->n_placas; i++) {
+    free(self->placas[i]);
+  }
+  free(self->placas);
+  free(self->livres);
+  free(self->em_uso);
+  free(self->hash);
+  free(self);
+}
+
+// índice por pid {{{1
+
+static int tabproc__hash(tabproc_t *self, int pid)
+{
+  return ((unsigned)pid * 2654435761u) & (self->hash_tam - 1);
+}
+
+// retorna a posição do pid no índice, ou da entrada vazia onde ele estaria
+static int tabproc__posicao(tabproc_t *self, int pid)
+{
+  int pos = tabproc__hash(self, pid);
+  while (self->hash[pos] != NULL && self->hash[pos]->pid != pid) {
+    pos = (pos + 1) & (self->hash_tam - 1);
+  }
+  return pos;
+}
+
+// dobra o tamanho do índice, reinserindo as entradas
+static void tabproc__cresce_hash(tabproc_t *self)
+{
+  processo_t **velho = self->hash;
+  int velho_tam = self->hash_tam;
+  self->hash_tam *= 2;
+  self->hash = calloc(self->hash_tam, sizeof(*self->hash));
+  assert(self->hash != NULL);
+  for (int i = 0; i < velho_tam; i++) {
+    if (velho[i] != NULL) {
+      self->hash[tabproc__posicao(self, velho[i]->pid)] = velho[i];
+    }
+  }
+  free(velho);
+}
+
+void tabproc_indexa(tabproc_t *self, processo_t *proc)
+{
+  // mantém a ocupação do índice abaixo da metade
+  if (2 * (self->hash_n + 1) > self->hash_tam) {
+    tabproc__cresce_hash(self);
+  }
+  int pos = tabproc__posicao(self, proc->pid);
+  if (self->hash[pos] == NULL) self->hash_n++;
+  self->hash[pos] = proc;
+}
+
+// tira do índice a entrada na posição pos
+// as entradas seguintes no mesmo agrupamento são puxadas para trás quando
+//   necessário, para que a busca continue encontrando-as sem marcas de remoção
+static void tabproc__desindexa(tabproc_t *self, int pos)
+{
+  int mascara = self->hash_tam - 1;
+  self->hash[pos] = NULL;
+  self->hash_n--;
+  int livre = pos;
+  for (int j = (pos + 1) & mascara; self->hash[j] != NULL; j = (j + 1) & mascara) {
+    int ideal = tabproc__hash(self, self->hash[j]->pid);
+    // a entrada em j pode ir para 'livre' se a posição ideal dela não
+    //   estiver entre 'livre' (exclusive) e j (inclusive), circularmente
+    bool fica;
+    if (livre <= j) {
+      fica = ideal > livre && ideal <= j;
+    } else {
+      fica = ideal > livre || ideal <= j;
+    }
+    if (!fica) {
+      self->hash[livre] = self->hash[j];
+      self->hash[j] = NULL;
+      livre = j;
+    }
+  }
+}
+
+processo_t *tabproc_busca(tabproc_t *self, int pid)
+{
+  return self->hash[tabproc__posicao(self, pid)];
+}
+
+// descritores {{{1
+
+// aloca mais uma placa, colocando seus descritores na pilha de livres
+static void tabproc__nova_placa(tabproc_t *self)
+{
+  processo_t *placa = malloc(TABPROC_PLACA * sizeof(*placa));
+  self->placas = realloc(self->placas, (self->n_placas + 1) * sizeof(*self->placas));
+  int cap = (self->n_placas + 1) * TABPROC_PLACA;
+  self->livres = realloc(self->livres, cap * sizeof(*self->livres));
+  self->em_uso = realloc(self->em_uso, cap * sizeof(*self->em_uso));
+  assert(placa != NULL && self->placas != NULL);
+  assert(self->livres != NULL && self->em_uso != NULL);
+  self->placas[self->n_placas++] = placa;
+  // empilha ao contrário, para que os descritores sejam usados em ordem
+  for (int i = TABPROC_PLACA - 1; i >= 0; i--) {
+    self->livres[self->n_livres++] = &placa[i];
+  }
+}
+
+processo_t *tabproc_aloca(tabproc_t *self)
+{
+  if (self->n_livres == 0) {
+    tabproc__nova_placa(self);
+  }
+  processo_t *proc = self->livres[--self->n_livres];
+  memset(proc, 0, sizeof(*proc));
+  proc->indice_tabela = self->n_em_uso;
+  self->em_uso[self->n_em_uso++] = proc;
+  return proc;
+}
+
+void tabproc_libera(tabproc_t *self, processo_t *proc)
+{
+  int pos = tabproc__posicao(self, proc->pid);
+  if (self->hash[pos] == proc) {
+    tabproc__desindexa(self, pos);
+  }
+  // o último em uso vai para o lugar do liberado
+  processo_t *ultimo = self->em_uso[--self->n_em_uso];
+  self->em_uso[proc->indice_tabela] = ultimo;
+  ultimo->indice_tabela = proc->indice_tabela;
+  self->livres[self->n_livres++] = proc;
+}
+
+int tabproc_n_processos(tabproc_t *self)
+{
+  return self->n_em_uso;
+}
+
+processo_t *tabproc_processo(tabproc_t *self, int i)
+{
+  return self->em_uso[i];
+}
@@ -0,0 +1,57 @@
+// tabproc.h
+// tabela de processos do SO
+// simulador de computador
+// so24b
+
+#ifndef TABPROC_H
+#define TABPROC_H
+
+// guarda os descritores dos processos que existem no sistema
+// os descritores são alocados em placas de TABPROC_PLACA descritores; um
+//   descritor não muda de lugar enquanto o processo existe, então pode ser
+//   referenciado por ponteiro (filas, quadros, processo corrente)
+// quando não tem descritor livre, a tabela cresce com mais uma placa; o
+//   descritor de um processo que terminou volta para a lista de livres e é
+//   reaproveitado pelo próximo processo criado
+// mantém um índice pid -> descritor (hash com endereçamento aberto) e um
+//   vetor com os descritores em uso, para que seja possível percorrer só os
+//   processos que existem
+
+#include "processo.h"
+
+// número de descritores em cada placa
+#define TABPROC_PLACA 16
+
+// tipo opaco que representa a tabela de processos
+typedef struct tabproc_t tabproc_t;
+
+// cria uma tabela de processos vazia
+// mata o programa em caso de erro (malloc)
+tabproc_t *tabproc_cria(void);
+
+// destrói a tabela, liberando todos os descritores
+void tabproc_destroi(tabproc_t *self);
+
+// retorna um descritor livre, com todos os campos zerados
+// o descritor passa a estar em uso, mas só é encontrado por pid depois
+//   de tabproc_indexa
+processo_t *tabproc_aloca(tabproc_t *self);
+
+// coloca o descritor no índice por pid, com o pid que está em proc->pid
+void tabproc_indexa(tabproc_t *self, processo_t *proc);
+
+// devolve o descritor para a lista de livres, tirando-o do índice
+// o descritor não deve mais ser usado
+void tabproc_libera(tabproc_t *self, processo_t *proc);
+
+// retorna o descritor do processo com o pid dado, ou NULL se não existir
+processo_t *tabproc_busca(tabproc_t *self, int pid);
+
+// retorna o número de descritores em uso
+int tabproc_n_processos(tabproc_t *self);
+
+// retorna o i-ésimo descritor em uso (0 <= i < tabproc_n_processos)
+// a ordem muda quando um descritor é liberado
+processo_t *tabproc_processo(tabproc_t *self, int i);
+
+#endif // TABPROC_H
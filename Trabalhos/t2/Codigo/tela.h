@@ -6,6 +6,8 @@
 #ifndef TELA_H
 #define TELA_H
 
+#include <stdbool.h>
+
 // identificação da cor para cada parte
 // essa definição deveria ser da console, mas tou com preguiça de refatorar isso
 #define COR_TXT_PAR      1
@@ -23,8 +25,12 @@ void tela_init(void);
 // finaliza o uso da tela
 void tela_fim();
 
-// programa número de milisegundos a esperar a cada leitura do teclado
-void tela_espera(int ms);
+// espera até 'ms' milisegundos por uma tecla (sem limite se 'ms' for
+//   negativo), sem ocupar o processador
+// retorna true se tiver tecla para ler com tela_tecla, false se o tempo
+//   acabou ou se não vai mais ter tecla (fim da entrada da tela nula; aí
+//   espera os 'ms', mas não espera se for sem limite)
+bool tela_espera_tecla(int ms);
 
 // posiciona o cursor
 void tela_posiciona(int lin, int col);
@@ -35,10 +41,13 @@ void tela_puts(int cor, char *str);
 // limpa a linha do cursor até o final
 void tela_limpa_linha();
 
-// retorna a próxima tecla digitada, ou 0 se não houver
+// retorna a próxima tecla digitada, ou 0 se não houver; não espera
 char tela_tecla(void);
 
 // envia para a tela o que foi escrito
 void tela_atualiza();
 
+// retorna true se o que é escrito aparece para alguém (false na tela nula)
+bool tela_visivel(void);
+
 #endif // TELA_H
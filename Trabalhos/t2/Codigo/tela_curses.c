@@ -9,6 +9,8 @@
 
 #include <curses.h>
 #include <locale.h>
+#include <poll.h>
+#include <unistd.h>
 
 void tela_init(void)
 {
@@ -16,7 +18,8 @@ void tela_init(void)
   initscr();     // inicializa o curses
   cbreak();      // lê cada char, não espera enter
   noecho();      // não mostra o que é digitado
-  timeout(5);    // não espera digitar, retorna ERR se nada foi digitado
+  timeout(0);    // não espera digitar, retorna ERR se nada foi digitado
+                 //   (a espera é feita por tela_espera_tecla)
   // inicializa algumas cores
   start_color();
   init_pair(COR_TXT_PAR,      COLOR_GREEN,  COLOR_BLACK );
@@ -35,9 +38,14 @@ void tela_fim()
   endwin();
 }
 
-void tela_espera(int ms)
+bool tela_espera_tecla(int ms)
 {
-  timeout(ms);
+  // a curses lê o teclado da entrada padrão; o sistema acorda quem espera
+  //   assim que chega alguma coisa
+  // uma tecla que a curses já leu e guardou não é vista aqui, por isso quem
+  //   chama deve ler com tela_tecla até não ter mais nada
+  struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+  return poll(&pfd, 1, ms) > 0;
 }
 
 void tela_posiciona(int lin, int col)
@@ -67,3 +75,8 @@ void tela_atualiza()
 {
   refresh();
 }
+
+bool tela_visivel(void)
+{
+  return true;
+}
@@ -0,0 +1,74 @@
+// tela_nula.c
+// entrada e saída no terminal físico, sem curses
+// simulador de computador
+// so24b
+
+// implementação de tela.h que não desenha nada
+// serve para compilar o simulador sem a biblioteca curses (make TELA=nula),
+//   para ser usado na execução sem tela (ver opção -b em main.c)
+// o teclado é lido da entrada padrão; as linhas digitadas são entregues à
+//   console como se tivessem sido digitadas na tela
+
+#include "tela.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+// true depois do fim da entrada padrão; a partir daí, não tem mais tecla
+static bool fim_da_entrada = false;
+
+void tela_init(void)
+{
+}
+
+void tela_fim()
+{
+}
+
+bool tela_espera_tecla(int ms)
+{
+  // depois do fim, a entrada está sempre pronta para ler, não adianta
+  //   esperar por ela; só dorme, para quem espera em laço não ocupar a CPU
+  if (fim_da_entrada) {
+    if (ms > 0) poll(NULL, 0, ms);
+    return false;
+  }
+  struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+  return poll(&pfd, 1, ms) > 0;
+}
+
+void tela_posiciona(int lin, int col)
+{
+}
+
+void tela_puts(int cor, char *str)
+{
+}
+
+void tela_limpa_linha()
+{
+}
+
+char tela_tecla(void)
+{
+  if (fim_da_entrada) return 0;
+  struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+  if (poll(&pfd, 1, 0) <= 0) return 0;
+  char ch;
+  if (read(STDIN_FILENO, &ch, 1) != 1) {
+    // fim da entrada padrão: um enter termina a última linha, se ela não
+    //   terminou com um (uma linha vazia é ignorada)
+    fim_da_entrada = true;
+    return '\n';
+  }
+  return ch;
+}
+
+void tela_atualiza()
+{
+}
+
+bool tela_visivel(void)
+{
+  return false;
+}
@@ -4,11 +4,95 @@
 // so24b
 
 #include "terminal.h"
+#include "estado.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
+// FILA CIRCULAR DE CARACTERES
+
+// fila de capacidade fixa; o caractere i da fila está em
+//   buf[(inicio + i) % cap]
+typedef struct {
+  char *buf;
+  int cap;
+  int inicio;
+  int n;
+} anel_t;
+
+static void anel_inicializa(anel_t *self, int cap)
+{
+  self->buf = malloc(cap);
+  assert(self->buf != NULL);
+  self->cap = cap;
+  self->inicio = 0;
+  self->n = 0;
+}
+
+static void anel_libera(anel_t *self)
+{
+  free(self->buf);
+}
+
+// retorna false se a fila estiver cheia
+static bool anel_insere(anel_t *self, char ch)
+{
+  if (self->n >= self->cap) return false;
+  self->buf[(self->inicio + self->n) % self->cap] = ch;
+  self->n++;
+  return true;
+}
+
+// a fila não pode estar vazia
+static char anel_remove(anel_t *self)
+{
+  char ch = self->buf[self->inicio];
+  self->inicio = (self->inicio + 1) % self->cap;
+  self->n--;
+  return ch;
+}
+
+static char anel_char(anel_t *self, int i)
+{
+  return self->buf[(self->inicio + i) % self->cap];
+}
+
+static void anel_esvazia(anel_t *self)
+{
+  self->inicio = 0;
+  self->n = 0;
+}
+
+// grava o conteúdo da fila no arquivo, sem alterar a fila
+static void anel_grava(anel_t *self, FILE *arq)
+{
+  int n1 = self->cap - self->inicio;
+  if (n1 > self->n) n1 = self->n;
+  fwrite(&self->buf[self->inicio], 1, n1, arq);
+  fwrite(self->buf, 1, self->n - n1, arq);
+}
+
+// grava o número de caracteres e os caracteres da fila, em ordem
+static bool anel_grava_estado(anel_t *self, FILE *arq)
+{
+  if (!ESTADO_GRAVA(arq, self->n)) return false;
+  for (int i = 0; i < self->n; i++) {
+    if (fputc(anel_char(self, i), arq) == EOF) return false;
+  }
+  return true;
+}
+
+static bool anel_le_estado(anel_t *self, FILE *arq)
+{
+  int n;
+  if (!ESTADO_LE(arq, n) || n < 0 || n > self->cap) return false;
+  anel_esvazia(self);
+  if (!estado_le_bytes(arq, self->buf, n)) return false;
+  self->n = n;
+  return true;
+}
+
 // TERMINAL
 
 // dados para cada terminal
@@ -16,9 +100,9 @@ struct terminal_t {
   // número de caracteres que cabem em uma linha
   int tam_linha;
   // texto já digitado no terminal, esperando para ser lido
-  char *entrada;
-  // texto sendo mostrado na saída do terminal
-  char *saida;
+  anel_t entrada;
+  // texto sendo mostrado na saída do terminal (cabem tam_linha-1 caracteres)
+  anel_t saida;
   // normal: aceitando novos caracteres na saída
   // rolando: removendo um caractere no início para gerar espaço.
   //   move um caractere por vez para a esquerda, até chegar no final
@@ -30,58 +114,102 @@ struct terminal_t {
   //   entra nesse estado quando recebe um '\n'.
   //   não aceita novos caracteres
   enum { normal, rolando, limpando } estado_saida;
-  // posicao do caractere que está sendo movido durante uma rolagem
-  int pos_rolagem;
+  // quantos caracteres a rolagem ou a limpeza já andou, e quantos tem que
+  //   andar até terminar; a saída só é alterada no final, o andamento só
+  //   serve para desenhar a linha (ver terminal_txt_saida)
+  int progresso;
+  int total;
+  // quantos caracteres a rolagem ou a limpeza anda a cada tictac
+  int velocidade;
+  // linhas montadas para a console desenhar
+  char *txt_entrada;
+  char *txt_saida;
+  // true se as linhas mudaram desde a última chamada a terminal_mudou
+  bool mudou;
+  // se não for NULL, a saída vai direto para esse arquivo, sem rolagem
+  FILE *saida_direta;
+  // texto a colocar no início de cada linha na saída direta
+  char prefixo[10];
+  // true se a linha incompleta da saída direta foi gravada com o estado e
+  //   não mudou depois; nesse caso ela não vai para o arquivo no final, vai
+  //   sair na execução que continuar do estado gravado
+  bool saida_gravada;
+  // para onde vão os pedidos de interrupção (NULL se não tem)
+  controlador_int_t *ci;
 };
 
 
-terminal_t *terminal_cria(int tam_linha)
+terminal_t *terminal_cria(int tam_linha, int cap_entrada)
 {
   terminal_t *self = malloc(sizeof(*self));
   assert(self != NULL);
 
-  self->saida = malloc(tam_linha + 1);
-  self->entrada = malloc(tam_linha + 1);
-  assert(self->saida != NULL && self->entrada != NULL);
+  anel_inicializa(&self->entrada, cap_entrada);
+  anel_inicializa(&self->saida, tam_linha - 1);
+  self->txt_entrada = malloc(tam_linha + 1);
+  self->txt_saida = malloc(tam_linha + 1);
+  assert(self->txt_entrada != NULL && self->txt_saida != NULL);
 
   self->tam_linha = tam_linha;
-  strcpy(self->entrada, "");
-  strcpy(self->saida, "");
   self->estado_saida = normal;
+  self->velocidade = 1;
+  self->saida_direta = NULL;
+  self->saida_gravada = false;
+  self->mudou = true;
+  self->ci = NULL;
 
   return self;
 }
 
+static void terminal_descarrega_linha(terminal_t *self);
+
 void terminal_destroi(terminal_t *self)
 {
-  free(self->entrada);
-  free(self->saida);
+  // não perde o final da saída direta
+  if (self->saida_direta != NULL && self->saida.n > 0 && !self->saida_gravada) {
+    terminal_descarrega_linha(self);
+  }
+  anel_libera(&self->entrada);
+  anel_libera(&self->saida);
+  free(self->txt_entrada);
+  free(self->txt_saida);
   free(self);
 }
 
+void terminal_define_controlador_int(terminal_t *self, controlador_int_t *ci)
+{
+  self->ci = ci;
+}
+
+void terminal_define_velocidade(terminal_t *self, int velocidade)
+{
+  self->velocidade = velocidade > 0 ? velocidade : TERMINAL_VELOCIDADE_LINHA;
+}
+
+static void terminal_pede_interrupcao(terminal_t *self, irq_t irq)
+{
+  if (self->ci != NULL) controlador_int_pede(self->ci, irq);
+}
+
 static bool terminal_entrada_vazia(terminal_t *self)
 {
-  return self->entrada[0] == '\0';
+  return self->entrada.n == 0;
 }
 
 static char terminal_le_char(terminal_t *self)
 {
-  char *p = self->entrada;
-  char ch = p[0];
-  if (ch != '\0') {
-    memmove(&p[0], &p[1], strlen(p));
-  }
-  return ch;
+  if (terminal_entrada_vazia(self)) return '\0';
+  self->mudou = true;
+  return anel_remove(&self->entrada);
 }
 
 void terminal_insere_char(terminal_t *self, char ch)
 {
-  char *p = self->entrada;
-  int tam = strlen(p);
+  bool estava_vazia = terminal_entrada_vazia(self);
   // se não cabe, ignora silenciosamente
-  if (tam >= self->tam_linha-2) return;
-  p[tam] = ch;
-  p[tam+1] = '\0';
+  if (!anel_insere(&self->entrada, ch)) return;
+  self->mudou = true;
+  if (estava_vazia) terminal_pede_interrupcao(self, IRQ_TECLADO);
 }
 
 static bool terminal_pode_imprimir(terminal_t *self)
@@ -89,78 +217,181 @@ static bool terminal_pode_imprimir(terminal_t *self)
   return self->estado_saida == normal;
 }
 
+void terminal_define_saida_direta(terminal_t *self, FILE *arq, char *prefixo)
+{
+  self->saida_direta = arq;
+  snprintf(self->prefixo, sizeof(self->prefixo), "%s", prefixo);
+  self->estado_saida = normal;
+}
+
+// manda a linha de saída para o arquivo de saída direta, e limpa a linha
+static void terminal_descarrega_linha(terminal_t *self)
+{
+  fputs(self->prefixo, self->saida_direta);
+  anel_grava(&self->saida, self->saida_direta);
+  fputc('\n', self->saida_direta);
+  anel_esvazia(&self->saida);
+}
+
+// imprime na saída direta: não tem rolagem nem limpeza, a linha vai para o
+//   arquivo quando recebe '\n' ou quando enche
+static void terminal_imprime_direto(terminal_t *self, char ch)
+{
+  self->saida_gravada = false;
+  if (ch == '\n') {
+    terminal_descarrega_linha(self);
+    return;
+  }
+  anel_insere(&self->saida, ch);
+  if (self->saida.n >= self->saida.cap) {
+    terminal_descarrega_linha(self);
+  }
+}
+
+// inicia uma rolagem ou limpeza, que anda 'total' caracteres
+static void terminal_inicia_movimento(terminal_t *self, int estado, int total)
+{
+  self->estado_saida = estado;
+  self->progresso = 0;
+  self->total = total;
+}
+
 static void terminal_imprime(terminal_t *self, char ch)
 {
+  if (self->saida_direta != NULL) {
+    terminal_imprime_direto(self, ch);
+    return;
+  }
   if (terminal_pode_imprimir(self)) {
+    self->mudou = true;
     if (ch == '\n') {
-      self->estado_saida = limpando;
+      // a limpeza anda pelo menos um caractere, mesmo com a linha vazia
+      int n = self->saida.n;
+      terminal_inicia_movimento(self, limpando, n > 0 ? n : 1);
       return;
     }
-    int tam = strlen(self->saida);
-    self->saida[tam] = ch;
-    tam++;
-    self->saida[tam] = '\0';
-    if (tam >= self->tam_linha - 1) {
-      self->estado_saida = rolando;
-      self->pos_rolagem = 0;
+    anel_insere(&self->saida, ch);
+    if (self->saida.n >= self->saida.cap) {
+      terminal_inicia_movimento(self, rolando, self->saida.n);
     }
   }
 }
 
 void terminal_limpa_saida(terminal_t *self)
 {
-  self->saida[0] = '\0';
-  self->estado_saida = normal;
+  anel_esvazia(&self->saida);
+  self->mudou = true;
+  if (self->estado_saida != normal) {
+    self->estado_saida = normal;
+    terminal_pede_interrupcao(self, IRQ_TELA);
+  }
 }
 
-static void terminal_atualiza_rolagem(terminal_t *self)
+// termina a rolagem ou limpeza: altera a saída e volta a aceitar caracteres
+static void terminal_termina_movimento(terminal_t *self)
 {
-  // remove o caractere na posição de rolagem e avança
-  // se chegou no final da string, terminou a rolagem
-  char *p = self->saida;
-  p[self->pos_rolagem] = p[self->pos_rolagem + 1];
-  if (p[self->pos_rolagem] != '\0') {
-    self->pos_rolagem++;
-    p[self->pos_rolagem] = ' ';
+  if (self->estado_saida == rolando) {
+    anel_remove(&self->saida);
   } else {
-    self->estado_saida = normal;
+    anel_esvazia(&self->saida);
   }
+  self->estado_saida = normal;
+  terminal_pede_interrupcao(self, IRQ_TELA);
 }
 
-static void terminal_atualiza_limpeza(terminal_t *self)
+bool terminal_ocupado(terminal_t *self)
 {
-  // remove um caractere do início da string; volta ao estado normal se era o último
-  char *p = self->saida;
-  int tam = strlen(p);
-  memmove(p, p+1, tam);
-  if (tam <= 1) {
-    self->estado_saida = normal;
-  }
+  return self->estado_saida != normal;
 }
 
-// altera a string de saída em 1 caractere, se estiver rolando ou limpando
+// anda a rolagem ou a limpeza, se estiver rolando ou limpando
 void terminal_tictac(terminal_t *self)
 {
-  switch (self->estado_saida) {
-    case normal: 
-      break;
-    case rolando:
-      terminal_atualiza_rolagem(self);
-      break;
-    case limpando:
-      terminal_atualiza_limpeza(self);
-      break;
+  if (self->estado_saida == normal) return;
+  self->mudou = true;
+  if (self->velocidade == TERMINAL_VELOCIDADE_LINHA
+      || self->total - self->progresso <= self->velocidade) {
+    terminal_termina_movimento(self);
+  } else {
+    self->progresso += self->velocidade;
+  }
+}
+
+bool terminal_grava_estado(terminal_t *self, FILE *arq)
+{
+  int estado = self->estado_saida;
+  self->saida_gravada = anel_grava_estado(&self->entrada, arq)
+                     && anel_grava_estado(&self->saida, arq)
+                     && ESTADO_GRAVA(arq, estado)
+                     && ESTADO_GRAVA(arq, self->progresso)
+                     && ESTADO_GRAVA(arq, self->total);
+  return self->saida_gravada;
+}
+
+bool terminal_le_estado(terminal_t *self, FILE *arq)
+{
+  int estado;
+  if (!anel_le_estado(&self->entrada, arq)
+      || !anel_le_estado(&self->saida, arq)
+      || !ESTADO_LE(arq, estado)
+      || !ESTADO_LE(arq, self->progresso)
+      || !ESTADO_LE(arq, self->total)) {
+    return false;
   }
+  // na saída direta não tem rolagem nem limpeza
+  self->estado_saida = self->saida_direta != NULL ? normal : estado;
+  self->mudou = true;
+  return true;
+}
+
+bool terminal_mudou(terminal_t *self)
+{
+  bool mudou = self->mudou;
+  self->mudou = false;
+  return mudou;
 }
 
 char *terminal_txt_entrada(terminal_t *self)
 {
-  return self->entrada;
+  int n = self->entrada.n;
+  if (n > self->tam_linha - 1) n = self->tam_linha - 1;
+  for (int i = 0; i < n; i++) {
+    self->txt_entrada[i] = anel_char(&self->entrada, i);
+  }
+  self->txt_entrada[n] = '\0';
+  return self->txt_entrada;
 }
 
 char *terminal_txt_saida(terminal_t *self)
 {
-  return self->saida;
+  anel_t *s = &self->saida;
+  char *txt = self->txt_saida;
+  int k = self->progresso;
+  int n = 0;
+  switch (self->estado_saida) {
+    case normal:
+      for (int i = 0; i < s->n; i++) txt[n++] = anel_char(s, i);
+      break;
+    case rolando:
+      // os k primeiros já andaram uma posição para a esquerda, e a posição
+      //   de onde saiu o último ficou em branco
+      for (int i = 0; i < s->n; i++) {
+        if (k == 0 || i > k) {
+          txt[n++] = anel_char(s, i);
+        } else if (i < k) {
+          txt[n++] = anel_char(s, i + 1);
+        } else {
+          txt[n++] = ' ';
+        }
+      }
+      break;
+    case limpando:
+      // os k primeiros já foram removidos
+      for (int i = k; i < s->n; i++) txt[n++] = anel_char(s, i);
+      break;
+  }
+  txt[n] = '\0';
+  return txt;
 }
 
 // Operações de leitura e escrita no terminal, chamadas pelo controlador de E/S
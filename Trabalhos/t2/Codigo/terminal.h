@@ -18,13 +18,29 @@
 // - leitura do estado da saída (se um caractere pode ser escrito ou não)
 //
 // a leitura não é possível quando não existir caractere na entrada
-// existe um limite para caracteres digitados e não lidos; caracteres adicionais
-//   são ignorados
+// existe um limite para caracteres digitados e não lidos (a capacidade da
+//   entrada, que pode ser maior que uma linha); caracteres adicionais são
+//   ignorados
 // o número de caracteres na saída é limitado ao tamanho da linha. um caractere
 //   adicional causa a "rolagem", que remove o primeiro caractere da linha para
 //   gerar espaço para o novo. a impressão de um \n causa a "limpeza" da linha.
-// a escrita não é possível se a saída estiver rolando ou sendo limpa, o que é
-//   feito um caractere por vez (a cada chamada a tictac).
+// a escrita não é possível se a saída estiver rolando ou sendo limpa. a
+//   rolagem e a limpeza andam um certo número de caracteres a cada chamada a
+//   tictac (a velocidade, ver terminal_define_velocidade); na velocidade
+//   TERMINAL_VELOCIDADE_LINHA, terminam em uma chamada só.
+//
+// a entrada e a saída são mantidas em filas circulares, inserir ou remover
+//   um caractere não depende do tamanho da linha
+//
+// opcionalmente, a saída pode ser direta para um arquivo (ver
+//   terminal_define_saida_direta), para a execução sem tela. nesse caso, cada
+//   linha completa vai para o arquivo, não tem rolagem nem limpeza, e a escrita
+//   é sempre possível.
+//
+// se tiver um controlador de interrupções (ver terminal_define_controlador_int),
+//   o terminal pede IRQ_TECLADO quando chega um caractere com a entrada vazia
+//   (a leitura passa a ser possível) e IRQ_TELA quando a saída termina de
+//   rolar ou de ser limpa (a escrita passa a ser possível)
 //
 // a E/S efetiva é realizada pela console. ela obtém acesso às linhas de entrada e
 //   saída chamando terminal_txt_entrada ou terminal_txt_saida. a console insere
@@ -32,19 +48,33 @@
 //   linha de saída com terminal_limpa_saida.
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "es.h"
+#include "controlador_int.h"
 
 typedef struct terminal_t terminal_t;
 
-// aloca e inicializa um novo terminal
-terminal_t *terminal_cria(int tam_linha);
+// velocidade em que a linha inteira é rolada ou limpa em um tictac
+#define TERMINAL_VELOCIDADE_LINHA 0
+
+// aloca e inicializa um novo terminal, com linhas de 'tam_linha' caracteres
+//   e com espaço para 'cap_entrada' caracteres digitados e não lidos
+terminal_t *terminal_cria(int tam_linha, int cap_entrada);
 // libera a memória ocupada por um terminal
 void terminal_destroi(terminal_t *self);
 
+// retorna true se a linha de entrada ou a de saída (como aparece na tela)
+//   mudou desde a última chamada, para a console só desenhar o que mudou
+bool terminal_mudou(terminal_t *self);
+
 // retorna a linha de entrada do terminal (para uso pela console)
+// se tiver mais caracteres que cabem em uma linha, só o início aparece
+// a string pertence ao terminal, e muda na próxima chamada
 char *terminal_txt_entrada(terminal_t *self);
 
-// retorna a linha de saida do terminal (para uso pela console)
+// retorna a linha de saida do terminal (para uso pela console), como
+//   aparece na tela, no meio da rolagem ou da limpeza
+// a string pertence ao terminal, e muda na próxima chamada
 char *terminal_txt_saida(terminal_t *self);
 
 // insere um novo caractere na entrada do terminal
@@ -54,9 +84,33 @@ void terminal_insere_char(terminal_t *self, char ch);
 // limpa a linha de saída (para uso pela console)
 void terminal_limpa_saida(terminal_t *self);
 
+// faz a saída do terminal ir direto para o arquivo 'arq', uma linha por vez,
+//   cada uma precedida por 'prefixo' (para uso pela console, sem tela)
+// o arquivo não pertence ao terminal, não é fechado por ele
+void terminal_define_saida_direta(terminal_t *self, FILE *arq, char *prefixo);
+
+// altera quantos caracteres a rolagem ou a limpeza andam em cada tictac
+//   (TERMINAL_VELOCIDADE_LINHA para andar a linha inteira)
+void terminal_define_velocidade(terminal_t *self, int velocidade);
+
+// define o controlador de interrupções que recebe os pedidos do terminal
+void terminal_define_controlador_int(terminal_t *self, controlador_int_t *ci);
+
+// retorna true se a saída está rolando ou sendo limpa, ou seja, se vai
+//   mudar na próxima chamada a tictac
+bool terminal_ocupado(terminal_t *self);
+
 // esta função deve ser chamada periodicamente
 void terminal_tictac(terminal_t *self);
 
+// grava no arquivo o estado do terminal (texto na entrada e na saída e o
+//   andamento da rolagem ou limpeza), ou lê o estado gravado (ver estado.h)
+// na saída direta, a linha incompleta que foi gravada só vai para o arquivo
+//   no final se o terminal imprimir mais alguma coisa depois da gravação
+// retornam false em caso de erro
+bool terminal_grava_estado(terminal_t *self, FILE *arq);
+bool terminal_le_estado(terminal_t *self, FILE *arq);
+
 // Funções para implementar o protocolo de acesso a um dispositivo pelo
 //   controlador de E/S
 // Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
@@ -0,0 +1,522 @@
+// varredura.c
+// executa o simulador com várias combinações de parâmetros, em paralelo
+// simulador de computador
+// so24b
+
+// uso: ./varredura [-j n] [-o arquivo.csv] [-d diretório] [-x simulador]
+//                  opção=valores ... [-- opções comuns]
+// cada 'opção=valores' é uma opção do simulador (sem o '-', ver main.c) e os
+//   valores que ela deve assumir, separados por vírgula; um valor da forma
+//   'ini:fim' ou 'ini:fim:passo' é expandido nos números de ini até fim
+//   ex: ./varredura e=normal,rr,rrp q=1:20 i=50,100 -- -l 200000
+// é executada uma simulação em lote para cada combinação dos valores, com
+//   até n (padrão: o número de processadores) executando ao mesmo tempo; as
+//   opções depois de '--' são passadas para todas
+// os arquivos de cada execução ficam no diretório (padrão "varredura_resultados"):
+//   N.metricas, N.log, N.saida (saída padrão e de erro) e N_A, N_B etc
+//   (terminais), onde N é o número da execução
+// no final, grava o CSV (padrão "varredura.csv") com uma linha por execução:
+//   o número, o valor de cada opção, a situação ("ok" ou como terminou), o
+//   tempo de execução e os números do arquivo de métricas, um por coluna:
+//   as linhas "rótulo : valor" (coluna "seção/rótulo") e as células das
+//   tabelas por processo (coluna "tabela/pid N/coluna")
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define SIMULADOR  "./main"
+#define DIRETORIO  "varredura_resultados"
+#define ARQUIVO_CSV "varredura.csv"
+
+// vetor de strings que cresce conforme necessário
+typedef struct {
+  char **v;
+  int n;
+  int cap;
+} lista_t;
+
+static void lista_insere(lista_t *self, char *str)
+{
+  if (self->n == self->cap) {
+    self->cap = self->cap == 0 ? 16 : 2 * self->cap;
+    self->v = realloc(self->v, self->cap * sizeof(*self->v));
+    assert(self->v != NULL);
+  }
+  self->v[self->n++] = str;
+}
+
+static char *copia(char *str)
+{
+  char *c = strdup(str);
+  assert(c != NULL);
+  return c;
+}
+
+// PARÂMETROS {{{1
+
+// uma opção do simulador e os valores que ela assume
+typedef struct {
+  char *opcao;
+  lista_t valores;
+} param_t;
+
+typedef struct {
+  int max_paralelo;
+  char *arquivo_csv;
+  char *diretorio;
+  char *simulador;
+  param_t *params;
+  int n_params;
+  // opções passadas para todas as execuções
+  lista_t comuns;
+} opcoes_t;
+
+static void uso(char *nome)
+{
+  fprintf(stderr, "uso: %s [-j n] [-o arquivo.csv] [-d diretório] [-x simulador]\n"
+          "          opção=valores ... [-- opções comuns]\n"
+          "  -j n           executa até n simulações ao mesmo tempo (padrão: o\n"
+          "                 número de processadores)\n"
+          "  -o arquivo.csv onde gravar os resultados (%s)\n"
+          "  -d diretório   onde ficam os arquivos de cada execução (%s)\n"
+          "  -x simulador   o executável do simulador (%s)\n"
+          "  opção=valores  uma opção do simulador, sem o '-', e os valores, separados\n"
+          "                 por vírgula; 'ini:fim[:passo]' é uma sequência de números\n"
+          "                 ex: e=normal,rr,rrp q=1:20 i=50,100\n",
+          nome, ARQUIVO_CSV, DIRETORIO, SIMULADOR);
+  exit(1);
+}
+
+// insere em 'valores' os números de 'ini:fim[:passo]', ou 'str' se não tiver
+//   essa forma
+static void expande_valor(lista_t *valores, char *str)
+{
+  long ini, fim, passo = 1;
+  char resto;
+  int n = sscanf(str, "%ld:%ld:%ld%c", &ini, &fim, &passo, &resto);
+  if ((n != 2 && n != 3) || passo <= 0) {
+    lista_insere(valores, copia(str));
+    return;
+  }
+  for (long v = ini; v <= fim; v += passo) {
+    char num[30];
+    snprintf(num, sizeof(num), "%ld", v);
+    lista_insere(valores, copia(num));
+  }
+}
+
+// interpreta 'opção=v1,v2,...'
+static bool pega_param(char *arg, param_t *param)
+{
+  char *igual = strchr(arg, '=');
+  if (igual == NULL || igual == arg || igual[1] == '\0') return false;
+  *igual = '\0';
+  param->opcao = arg;
+  param->valores = (lista_t){ NULL, 0, 0 };
+  for (char *v = strtok(igual + 1, ","); v != NULL; v = strtok(NULL, ",")) {
+    expande_valor(&param->valores, v);
+  }
+  return param->valores.n > 0;
+}
+
+static void verifica_args(int argc, char *argv[argc], opcoes_t *op)
+{
+  op->max_paralelo = sysconf(_SC_NPROCESSORS_ONLN);
+  if (op->max_paralelo < 1) op->max_paralelo = 1;
+  op->arquivo_csv = ARQUIVO_CSV;
+  op->diretorio = DIRETORIO;
+  op->simulador = SIMULADOR;
+  op->params = malloc(argc * sizeof(*op->params));
+  assert(op->params != NULL);
+  op->n_params = 0;
+  op->comuns = (lista_t){ NULL, 0, 0 };
+  for (int argi = 1; argi < argc; argi++) {
+    char *arg = argv[argi];
+    if (strcmp(arg, "--") == 0) {
+      for (argi++; argi < argc; argi++) lista_insere(&op->comuns, argv[argi]);
+    } else if (arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0') {
+      if (argi + 1 >= argc) uso(argv[0]);
+      char *valor = argv[++argi];
+      switch (arg[1]) {
+        case 'j':
+          op->max_paralelo = atoi(valor);
+          if (op->max_paralelo < 1) uso(argv[0]);
+          break;
+        case 'o': op->arquivo_csv = valor; break;
+        case 'd': op->diretorio = valor; break;
+        case 'x': op->simulador = valor; break;
+        default: uso(argv[0]);
+      }
+    } else if (!pega_param(arg, &op->params[op->n_params++])) {
+      fprintf(stderr, "ERRO: parâmetro inválido: '%s'\n", arg);
+      uso(argv[0]);
+    }
+  }
+}
+
+// EXECUÇÕES {{{1
+
+// uma execução do simulador
+typedef struct {
+  // índice de cada parâmetro em params[p].valores
+  int *escolha;
+  pid_t pid;
+  // false se não foi possível criar o processo
+  bool disparou;
+  int situacao;
+  bool terminou;
+  long inicio_ms;
+  long tempo_ms;
+  // false se não tem o arquivo de métricas (o simulador não chegou ao fim,
+  //   ou não conseguiu gravar)
+  bool tem_metricas;
+  // valores das colunas de métricas (NULL se não tem), na ordem de 'colunas'
+  lista_t metricas;
+} execucao_t;
+
+static long agora_ms(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000L + t.tv_nsec / 1000000;
+}
+
+// escolhe os valores da execução 'num' entre todas as combinações (o
+//   último parâmetro é o que varia mais rápido)
+static void escolhe_valores(opcoes_t *op, int num, execucao_t *ex)
+{
+  ex->escolha = malloc(op->n_params * sizeof(*ex->escolha));
+  assert(ex->escolha != NULL);
+  for (int p = op->n_params - 1; p >= 0; p--) {
+    int n = op->params[p].valores.n;
+    ex->escolha[p] = num % n;
+    num /= n;
+  }
+}
+
+// nome do arquivo 'sufixo' da execução 'num'
+static char *nome_arquivo(opcoes_t *op, int num, char *sufixo)
+{
+  static char nome[1000];
+  snprintf(nome, sizeof(nome), "%s/%d%s", op->diretorio, num, sufixo);
+  return nome;
+}
+
+// cria o processo que executa o simulador; retorna false se não conseguir
+static bool dispara(opcoes_t *op, int num, execucao_t *ex)
+{
+  lista_t args = { NULL, 0, 0 };
+  lista_insere(&args, op->simulador);
+  lista_insere(&args, "-b");
+  lista_insere(&args, "-o");
+  lista_insere(&args, copia(nome_arquivo(op, num, "_")));
+  lista_insere(&args, "-m");
+  lista_insere(&args, copia(nome_arquivo(op, num, ".metricas")));
+  lista_insere(&args, "-L");
+  lista_insere(&args, copia(nome_arquivo(op, num, ".log")));
+  for (int p = 0; p < op->n_params; p++) {
+    char opcao[100];
+    snprintf(opcao, sizeof(opcao), "-%s", op->params[p].opcao);
+    lista_insere(&args, copia(opcao));
+    lista_insere(&args, op->params[p].valores.v[ex->escolha[p]]);
+  }
+  for (int i = 0; i < op->comuns.n; i++) lista_insere(&args, op->comuns.v[i]);
+  lista_insere(&args, NULL);
+
+  // as métricas de uma varredura anterior não podem passar por desta
+  unlink(nome_arquivo(op, num, ".metricas"));
+  ex->inicio_ms = agora_ms();
+  ex->pid = fork();
+  if (ex->pid < 0) return false;
+  ex->disparou = true;
+  if (ex->pid == 0) {
+    int fd = open(nome_arquivo(op, num, ".saida"), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd >= 0) {
+      dup2(fd, STDOUT_FILENO);
+      dup2(fd, STDERR_FILENO);
+      close(fd);
+    }
+    execv(op->simulador, args.v);
+    perror(op->simulador);
+    _exit(127);
+  }
+  // os args alocados só servem para o filho
+  return true;
+}
+
+// espera uma execução terminar e registra como terminou
+static void espera_uma(int n, execucao_t ex[n])
+{
+  int situacao;
+  pid_t pid = wait(&situacao);
+  if (pid < 0) return;
+  for (int i = 0; i < n; i++) {
+    if (ex[i].pid == pid && !ex[i].terminou) {
+      ex[i].terminou = true;
+      ex[i].situacao = situacao;
+      ex[i].tempo_ms = agora_ms() - ex[i].inicio_ms;
+      return;
+    }
+  }
+}
+
+// MÉTRICAS {{{1
+
+// nomes das colunas de métricas, na ordem em que apareceram
+static lista_t colunas;
+
+static int coluna(char *nome)
+{
+  for (int i = 0; i < colunas.n; i++) {
+    if (strcmp(colunas.v[i], nome) == 0) return i;
+  }
+  lista_insere(&colunas, copia(nome));
+  return colunas.n - 1;
+}
+
+static void poe_metrica(execucao_t *ex, char *nome, char *valor)
+{
+  int c = coluna(nome);
+  while (ex->metricas.n <= c) lista_insere(&ex->metricas, NULL);
+  ex->metricas.v[c] = copia(valor);
+}
+
+// tira os espaços (e os caracteres em 'extra') do início e do fim de str
+static char *apara(char *str, char *extra)
+{
+  while (isspace((unsigned char)*str) || (*str != '\0' && strchr(extra, *str))) str++;
+  char *fim = str + strlen(str);
+  while (fim > str && (isspace((unsigned char)fim[-1]) || strchr(extra, fim[-1]))) fim--;
+  *fim = '\0';
+  return str;
+}
+
+// separa as células de uma linha de tabela ("| a | b |")
+static int separa_celulas(char *linha, int max, char *celulas[max])
+{
+  int n = 0;
+  char *p = strchr(linha, '|');
+  while (p != NULL && n < max) {
+    char *prox = strchr(p + 1, '|');
+    if (prox == NULL) break;
+    *prox = '\0';
+    celulas[n++] = apara(p + 1, "");
+    p = prox;
+  }
+  return n;
+}
+
+#define MAX_CELULAS 20
+
+// lê o arquivo de métricas (ver so_imprime_metricas) da execução
+static void le_metricas(execucao_t *ex, char *nome_arq)
+{
+  FILE *arq = fopen(nome_arq, "r");
+  if (arq == NULL) return;
+  ex->tem_metricas = true;
+  char linha[500];
+  char secao[100] = "";
+  char *cabecalho[MAX_CELULAS];
+  char cab_linha[500];
+  int n_cab = 0;
+  while (fgets(linha, sizeof(linha), arq) != NULL) {
+    char *l = apara(linha, "");
+    int tam = strlen(l);
+    if (tam == 0 || l[0] == '=') continue;
+    if (l[0] == '-') {
+      // título de tabela: "---- TABELA DE XXX ----"
+      snprintf(secao, sizeof(secao), "%s", apara(l, "-"));
+      n_cab = 0;
+    } else if (l[0] == '|') {
+      if (strspn(l, "|- ") == tam) continue; // separador
+      char *celulas[MAX_CELULAS];
+      int n = separa_celulas(l, MAX_CELULAS, celulas);
+      if (n > 0 && strcmp(celulas[0], "PID") == 0) {
+        // o cabeçalho nomeia as colunas das linhas seguintes
+        char *p = cab_linha;
+        for (n_cab = 0; n_cab < n; n_cab++) {
+          strcpy(p, celulas[n_cab]);
+          cabecalho[n_cab] = p;
+          p += strlen(p) + 1;
+        }
+        continue;
+      }
+      for (int c = 1; c < n && c < n_cab; c++) {
+        char nome[300];
+        snprintf(nome, sizeof(nome), "%s/pid %s/%s", secao, celulas[0], cabecalho[c]);
+        poe_metrica(ex, nome, apara(celulas[c], "%"));
+      }
+    } else if (l[tam - 1] == ':') {
+      l[tam - 1] = '\0';
+      snprintf(secao, sizeof(secao), "%s", l);
+    } else {
+      char *dois_pontos = strchr(l, ':');
+      if (dois_pontos == NULL) continue;
+      *dois_pontos = '\0';
+      char nome[300];
+      char *rotulo = apara(l, "");
+      if (secao[0] == '\0') {
+        snprintf(nome, sizeof(nome), "%s", rotulo);
+      } else {
+        snprintf(nome, sizeof(nome), "%s/%s", secao, rotulo);
+      }
+      poe_metrica(ex, nome, apara(dois_pontos + 1, ""));
+    }
+  }
+  fclose(arq);
+}
+
+// CSV {{{1
+
+// grava um campo, entre aspas se precisar
+static void grava_campo(FILE *arq, char *campo, bool primeiro)
+{
+  if (!primeiro) fputc(',', arq);
+  if (campo == NULL) return;
+  if (strpbrk(campo, ",\"\n") == NULL) {
+    fputs(campo, arq);
+    return;
+  }
+  fputc('"', arq);
+  for (char *p = campo; *p != '\0'; p++) {
+    if (*p == '"') fputc('"', arq);
+    fputc(*p, arq);
+  }
+  fputc('"', arq);
+}
+
+// retorna true se a execução terminou normalmente
+static bool execucao_terminou_bem(execucao_t *ex)
+{
+  return ex->disparou && WIFEXITED(ex->situacao) && WEXITSTATUS(ex->situacao) == 0;
+}
+
+// retorna true se a execução terminou normalmente e gerou as métricas
+static bool execucao_ok(execucao_t *ex)
+{
+  return execucao_terminou_bem(ex) && ex->tem_metricas;
+}
+
+static void descreve_situacao(execucao_t *ex, char *txt, int tam)
+{
+  int situacao = ex->situacao;
+  if (!ex->disparou) {
+    snprintf(txt, tam, "nao executou");
+  } else if (execucao_ok(ex)) {
+    snprintf(txt, tam, "ok");
+  } else if (execucao_terminou_bem(ex)) {
+    snprintf(txt, tam, "sem metricas");
+  } else if (WIFEXITED(situacao)) {
+    snprintf(txt, tam, "saida %d", WEXITSTATUS(situacao));
+  } else if (WIFSIGNALED(situacao)) {
+    snprintf(txt, tam, "sinal %d", WTERMSIG(situacao));
+  } else {
+    snprintf(txt, tam, "?");
+  }
+}
+
+static bool grava_csv(opcoes_t *op, int n, execucao_t ex[n])
+{
+  FILE *arq = fopen(op->arquivo_csv, "w");
+  if (arq == NULL) return false;
+  grava_campo(arq, "execucao", true);
+  for (int p = 0; p < op->n_params; p++) grava_campo(arq, op->params[p].opcao, false);
+  grava_campo(arq, "situacao", false);
+  grava_campo(arq, "tempo_ms", false);
+  for (int c = 0; c < colunas.n; c++) grava_campo(arq, colunas.v[c], false);
+  fputc('\n', arq);
+  for (int i = 0; i < n; i++) {
+    char txt[30];
+    snprintf(txt, sizeof(txt), "%d", i);
+    grava_campo(arq, txt, true);
+    for (int p = 0; p < op->n_params; p++) {
+      grava_campo(arq, op->params[p].valores.v[ex[i].escolha[p]], false);
+    }
+    descreve_situacao(&ex[i], txt, sizeof(txt));
+    grava_campo(arq, txt, false);
+    snprintf(txt, sizeof(txt), "%ld", ex[i].tempo_ms);
+    grava_campo(arq, txt, false);
+    for (int c = 0; c < colunas.n; c++) {
+      grava_campo(arq, c < ex[i].metricas.n ? ex[i].metricas.v[c] : NULL, false);
+    }
+    fputc('\n', arq);
+  }
+  return fclose(arq) == 0;
+}
+
+// PRINCIPAL {{{1
+
+int main(int argc, char *argv[argc])
+{
+  opcoes_t op;
+  verifica_args(argc, argv, &op);
+
+  int n = 1;
+  for (int p = 0; p < op.n_params; p++) n *= op.params[p].valores.n;
+
+  // pode já existir, de uma varredura anterior; mas tem que ser um diretório
+  struct stat st;
+  if (mkdir(op.diretorio, 0777) != 0) {
+    if (errno != EEXIST || stat(op.diretorio, &st) != 0) {
+      perror(op.diretorio);
+      return 1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+      fprintf(stderr, "%s: não é um diretório\n", op.diretorio);
+      return 1;
+    }
+  }
+
+  execucao_t *ex = calloc(n, sizeof(*ex));
+  assert(ex != NULL);
+  long inicio = agora_ms();
+  int disparadas = 0;
+  int terminadas = 0;
+  for (int i = 0; i < n; i++) {
+    escolhe_valores(&op, i, &ex[i]);
+    while (disparadas - terminadas >= op.max_paralelo) {
+      espera_uma(n, ex);
+      terminadas++;
+    }
+    if (!dispara(&op, i, &ex[i])) {
+      perror("fork");
+      // fica registrada como erro; segue com as outras
+      ex[i].terminou = true;
+      continue;
+    }
+    disparadas++;
+  }
+  while (terminadas < disparadas) {
+    espera_uma(n, ex);
+    terminadas++;
+  }
+  long tempo_total = agora_ms() - inicio;
+
+  long maior = 0;
+  int falhas = 0;
+  for (int i = 0; i < n; i++) {
+    le_metricas(&ex[i], nome_arquivo(&op, i, ".metricas"));
+    if (ex[i].tempo_ms > maior) maior = ex[i].tempo_ms;
+    if (!execucao_ok(&ex[i])) falhas++;
+  }
+  if (!grava_csv(&op, n, ex)) {
+    perror(op.arquivo_csv);
+    return 1;
+  }
+  printf("%d execuções (%d com erro), até %d ao mesmo tempo, em %ld ms"
+         " (a mais demorada: %ld ms)\nresultados em '%s'\n",
+         n, falhas, op.max_paralelo, tempo_total, maior, op.arquivo_csv);
+  return falhas == 0 ? 0 : 1;
+}
+
+// vim: foldmethod=marker